@@ -352,6 +352,9 @@ static __inline__ int snd_ctl_abort(snd_ctl_t *ctl) { return snd_ctl_nonblock(ct
 int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl, 
 			      snd_async_callback_t callback, void *private_data);
 snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler);
+int snd_evloop_add_ctl(snd_evloop_source_t **source, snd_evloop_t *loop, snd_ctl_t *ctl,
+		       snd_evloop_callback_t callback, void *private_data);
+snd_ctl_t *snd_evloop_source_get_ctl(snd_evloop_source_t *source);
 int snd_ctl_poll_descriptors_count(snd_ctl_t *ctl);
 int snd_ctl_poll_descriptors(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int space);
 int snd_ctl_poll_descriptors_revents(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -128,6 +128,38 @@ int snd_async_handler_get_fd(snd_async_handler_t *handler);
 int snd_async_handler_get_signo(snd_async_handler_t *handler);
 void *snd_async_handler_get_callback_private(snd_async_handler_t *handler);
 
+/**
+ * \brief Internal structure for an event loop.
+ *
+ * The ALSA library uses a pointer to this structure as a handle to an event
+ * loop object. Applications don't access its contents directly.
+ */
+typedef struct _snd_evloop snd_evloop_t;
+
+/**
+ * \brief Internal structure for a handle registered in an event loop.
+ */
+typedef struct _snd_evloop_source snd_evloop_source_t;
+
+/**
+ * \brief Event loop callback.
+ *
+ * See the #snd_evloop_wait function for details.
+ */
+typedef void (*snd_evloop_callback_t)(snd_evloop_source_t *source,
+				      unsigned short revents);
+
+int snd_evloop_open(snd_evloop_t **loop);
+int snd_evloop_close(snd_evloop_t *loop);
+int snd_evloop_get_fd(snd_evloop_t *loop);
+int snd_evloop_wait(snd_evloop_t *loop, int timeout);
+int snd_evloop_add_handler(snd_evloop_source_t **source, snd_evloop_t *loop,
+			   int fd, short events, snd_evloop_callback_t callback,
+			   void *private_data);
+int snd_evloop_del_source(snd_evloop_source_t *source);
+int snd_evloop_update_source(snd_evloop_source_t *source);
+void *snd_evloop_source_get_callback_private(snd_evloop_source_t *source);
+
 struct snd_shm_area *snd_shm_area_create(int shmid, void *ptr);
 struct snd_shm_area *snd_shm_area_share(struct snd_shm_area *area);
 int snd_shm_area_destroy(struct snd_shm_area *area);
@@ -222,6 +222,34 @@ struct _snd_async_handler {
 	struct list_head hlist;
 };
 
+typedef enum _evloop_source_type {
+	EVLOOP_SOURCE_GENERIC,
+	EVLOOP_SOURCE_PCM,
+	EVLOOP_SOURCE_CTL,
+	EVLOOP_SOURCE_RAWMIDI,
+	EVLOOP_SOURCE_SEQ,
+	EVLOOP_SOURCE_TIMER,
+} evloop_source_type_t;
+
+/* the poll descriptor functions of a handle type for the event loop */
+typedef struct {
+	int (*descriptors_count)(void *handle, short events);
+	int (*descriptors)(void *handle, struct pollfd *pfds, unsigned int space,
+			   short events);
+	int (*revents)(void *handle, struct pollfd *pfds, unsigned int nfds,
+		       unsigned short *revents);
+} evloop_source_ops_t;
+
+#define snd_evloop_add_source		snd1_evloop_add_source
+#define snd_evloop_source_handle	snd1_evloop_source_handle
+
+int snd_evloop_add_source(snd_evloop_source_t **source, snd_evloop_t *loop,
+			  evloop_source_type_t type, void *handle,
+			  const evloop_source_ops_t *ops, short events,
+			  snd_evloop_callback_t callback, void *private_data);
+void *snd_evloop_source_handle(snd_evloop_source_t *source,
+			       evloop_source_type_t type);
+
 typedef enum _snd_set_mode {
 	SND_CHANGE,
 	SND_TRY,
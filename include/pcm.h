@@ -389,6 +389,8 @@ typedef long snd_pcm_sframes_t;
 #define SND_PCM_NO_AUTO_FORMAT		0x00040000
 /** Disable soft volume control */
 #define SND_PCM_NO_SOFTVOL		0x00080000
+/** The handle is used from a single thread only, no locking (flag for open mode) */
+#define SND_PCM_SINGLE_THREAD		0x00100000
 
 /** PCM handle */
 typedef struct _snd_pcm snd_pcm_t;
@@ -508,6 +510,9 @@ static __inline__ int snd_pcm_abort(snd_pcm_t *pcm) { return snd_pcm_nonblock(pc
 int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm, 
 			      snd_async_callback_t callback, void *private_data);
 snd_pcm_t *snd_async_handler_get_pcm(snd_async_handler_t *handler);
+int snd_evloop_add_pcm(snd_evloop_source_t **source, snd_evloop_t *loop, snd_pcm_t *pcm,
+		       snd_evloop_callback_t callback, void *private_data);
+snd_pcm_t *snd_evloop_source_get_pcm(snd_evloop_source_t *source);
 int snd_pcm_info(snd_pcm_t *pcm, snd_pcm_info_t *info);
 int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
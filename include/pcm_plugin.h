@@ -163,6 +163,8 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		       snd_config_t *root, snd_config_t *conf,
 		       snd_pcm_stream_t stream, int mode);
+int snd_pcm_rate_set_ratio_ppm(snd_pcm_t *pcm, int ppm);
+int snd_pcm_rate_get_ratio_ppm(snd_pcm_t *pcm, int *ppm);
 
 /*
  *  Hooks plugin
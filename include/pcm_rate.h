@@ -38,7 +38,18 @@ extern "C" {
 /**
  * Protocol version
  */
-#define SND_PCM_RATE_PLUGIN_VERSION	0x010002
+#define SND_PCM_RATE_PLUGIN_VERSION	0x010003
+
+/** the converter needs the same format on both sides */
+#define SND_PCM_RATE_FLAG_SYNC_FORMATS	(1U << 0)
+/**
+ * the converter accepts a slave side period of up to
+ * SND_PCM_RATE_VARIABLE_SLIP() frames more or less than the nominal
+ * period size (variable ratio mode)
+ */
+#define SND_PCM_RATE_FLAG_VARIABLE_FRAMES	(1U << 1)
+/** maximal deviation from the slave period size in variable ratio mode */
+#define SND_PCM_RATE_VARIABLE_SLIP(period_size)	((period_size) / 512 + 1)
 
 /** hw_params information for a single side */
 typedef struct snd_pcm_rate_side_info {
@@ -114,6 +125,34 @@ typedef struct snd_pcm_rate_ops {
 	 * new ops since version 0x010002
 	 */
 	void (*dump)(void *obj, snd_output_t *out);
+	/**
+	 * return the formats handled by convert as bit masks of
+	 * (1ULL << format) for the input and the output side, and
+	 * SND_PCM_RATE_FLAG_* flags; optional, linear formats are assumed
+	 * when missing.  A float format is passed only when both sides
+	 * use the same one.
+	 * new ops since version 0x010003
+	 */
+	int (*get_supported_formats)(void *obj, uint64_t *in_formats,
+				     uint64_t *out_formats,
+				     unsigned int *flags);
+	/**
+	 * return the size in bytes of the converter state carried from one
+	 * period to the next; optional, together with save_state and
+	 * restore_state it allows rewinding the converted periods.
+	 * new ops since version 0x010003
+	 */
+	size_t (*get_state_size)(void *obj);
+	/**
+	 * save the converter state before a period is converted;
+	 * new ops since version 0x010003
+	 */
+	void (*save_state)(void *obj, void *state);
+	/**
+	 * go back to a saved converter state;
+	 * new ops since version 0x010003
+	 */
+	void (*restore_state)(void *obj, const void *state);
 } snd_pcm_rate_ops_t;
 
 /** open function type */
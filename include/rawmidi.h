@@ -87,6 +87,9 @@ int snd_rawmidi_close(snd_rawmidi_t *rmidi);
 int snd_rawmidi_poll_descriptors_count(snd_rawmidi_t *rmidi);
 int snd_rawmidi_poll_descriptors(snd_rawmidi_t *rmidi, struct pollfd *pfds, unsigned int space);
 int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *pfds, unsigned int nfds, unsigned short *revent);
+int snd_evloop_add_rawmidi(snd_evloop_source_t **source, snd_evloop_t *loop, snd_rawmidi_t *rmidi,
+			   snd_evloop_callback_t callback, void *private_data);
+snd_rawmidi_t *snd_evloop_source_get_rawmidi(snd_evloop_source_t *source);
 int snd_rawmidi_nonblock(snd_rawmidi_t *rmidi, int nonblock);
 size_t snd_rawmidi_info_sizeof(void);
 /** \hideinitializer
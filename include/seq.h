@@ -83,6 +83,9 @@ int snd_seq_close(snd_seq_t *handle);
 int snd_seq_poll_descriptors_count(snd_seq_t *handle, short events);
 int snd_seq_poll_descriptors(snd_seq_t *handle, struct pollfd *pfds, unsigned int space, short events);
 int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_evloop_add_seq(snd_evloop_source_t **source, snd_evloop_t *loop, snd_seq_t *seq,
+		       short events, snd_evloop_callback_t callback, void *private_data);
+snd_seq_t *snd_evloop_source_get_seq(snd_evloop_source_t *source);
 int snd_seq_nonblock(snd_seq_t *handle, int nonblock);
 int snd_seq_client_id(snd_seq_t *handle);
 
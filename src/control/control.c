@@ -1337,6 +1337,60 @@ snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler)
 	return handler->u.ctl;
 }
 
+static int evloop_ctl_count(void *handle, short events ATTRIBUTE_UNUSED)
+{
+	return snd_ctl_poll_descriptors_count(handle);
+}
+
+static int evloop_ctl_descriptors(void *handle, struct pollfd *pfds,
+				  unsigned int space, short events ATTRIBUTE_UNUSED)
+{
+	return snd_ctl_poll_descriptors(handle, pfds, space);
+}
+
+static int evloop_ctl_revents(void *handle, struct pollfd *pfds,
+			      unsigned int nfds, unsigned short *revents)
+{
+	return snd_ctl_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const evloop_source_ops_t evloop_ctl_ops = {
+	.descriptors_count = evloop_ctl_count,
+	.descriptors = evloop_ctl_descriptors,
+	.revents = evloop_ctl_revents,
+};
+
+/**
+ * \brief Add a CTL to an event loop
+ * \param source Returned source handle
+ * \param loop Event loop
+ * \param ctl CTL handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback gets the revents demangled by
+ * #snd_ctl_poll_descriptors_revents().
+ */
+int snd_evloop_add_ctl(snd_evloop_source_t **source, snd_evloop_t *loop,
+		       snd_ctl_t *ctl, snd_evloop_callback_t callback,
+		       void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_CTL, ctl,
+				     &evloop_ctl_ops, 0,
+				     callback, private_data);
+}
+
+/**
+ * \brief Return the CTL handle of an event loop source
+ * \param source Source handle
+ * \return CTL handle
+ */
+snd_ctl_t *snd_evloop_source_get_ctl(snd_evloop_source_t *source)
+{
+	return snd_evloop_source_handle(source, EVLOOP_SOURCE_CTL);
+}
+
 static const char *const build_in_ctls[] = {
 	"hw", "shm", NULL
 };
@@ -0,0 +1,449 @@
+/**
+ * \file evloop.c
+ * \brief Event loop for ALSA handles
+ * \date 2026
+ */
+/*
+ *  Event loop for ALSA handles
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "local.h"
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#define SND_EVLOOP_MAX_EVENTS	32
+
+/* one registered file descriptor of a source */
+struct snd_evloop_fd {
+	snd_evloop_source_t *source;
+	unsigned int index;		/* in source->pfds */
+	int fd;				/* registered fd, a dup when shared */
+	int always;			/* not pollable, always ready */
+};
+
+struct _snd_evloop {
+	int epfd;
+	struct list_head sources;
+	struct list_head always;	/* sources with always ready fds */
+};
+
+struct _snd_evloop_source {
+	snd_evloop_t *loop;
+	evloop_source_type_t type;
+	void *handle;
+	const evloop_source_ops_t *ops;
+	short events;			/* for the seq descriptors */
+	snd_evloop_callback_t callback;
+	void *private_data;
+	unsigned int nfds;
+	struct pollfd *pfds;
+	struct snd_evloop_fd *fds;
+	int always;			/* has always ready fds */
+	int ready;			/* on the ready list of snd_evloop_wait() */
+	struct list_head list;
+	struct list_head always_list;
+	struct list_head ready_list;
+};
+
+/**
+ * \brief Creates an event loop.
+ * \param loop The function puts the pointer to the new event loop object
+ *             at the address specified by \p loop.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The event loop waits for many PCM, control, rawmidi, sequencer and timer
+ * handles at once.  The handles are registered once with
+ * #snd_evloop_add_pcm, #snd_evloop_add_ctl, #snd_evloop_add_rawmidi,
+ * #snd_evloop_add_seq, #snd_evloop_add_timer or, for other file
+ * descriptors, #snd_evloop_add_handler.  #snd_evloop_wait then waits with
+ * a single epoll_wait() call, without building a poll array per wakeup,
+ * and calls the callbacks of the ready handles with the events already
+ * demangled by the poll_descriptors_revents function of the handle.
+ *
+ * The loop is not thread-safe, it should be used from one thread.
+ */
+int snd_evloop_open(snd_evloop_t **loop)
+{
+	snd_evloop_t *l;
+	int err;
+
+	assert(loop);
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		return -ENOMEM;
+	l->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (l->epfd < 0) {
+		err = -errno;
+		SYSERR("epoll_create1 failed");
+		free(l);
+		return err;
+	}
+	INIT_LIST_HEAD(&l->sources);
+	INIT_LIST_HEAD(&l->always);
+	*loop = l;
+	return 0;
+}
+
+/**
+ * \brief Closes an event loop.
+ * \param loop The event loop.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * All sources still registered are deleted, the handles themselves are
+ * not closed.  The function must not be called from a callback.
+ */
+int snd_evloop_close(snd_evloop_t *loop)
+{
+	assert(loop);
+	while (!list_empty(&loop->sources))
+		snd_evloop_del_source(list_entry(loop->sources.next,
+						 snd_evloop_source_t, list));
+	close(loop->epfd);
+	free(loop);
+	return 0;
+}
+
+/**
+ * \brief Returns the file descriptor of an event loop.
+ * \param loop The event loop.
+ * \result The epoll file descriptor.
+ *
+ * The descriptor becomes readable when any registered handle has events,
+ * so the loop can be nested in another main loop, which then calls
+ * #snd_evloop_wait with a zero timeout.  File descriptors which cannot be
+ * polled (e.g. /dev/null of the null PCM) are not signalled this way.
+ */
+int snd_evloop_get_fd(snd_evloop_t *loop)
+{
+	assert(loop);
+	return loop->epfd;
+}
+
+static void evloop_unregister(snd_evloop_source_t *source)
+{
+	unsigned int i;
+
+	for (i = 0; i < source->nfds; i++) {
+		struct snd_evloop_fd *f = &source->fds[i];
+
+		if (f->always)
+			continue;
+		epoll_ctl(source->loop->epfd, EPOLL_CTL_DEL, f->fd, NULL);
+		if (f->fd != source->pfds[i].fd)
+			close(f->fd);
+	}
+	if (source->always)
+		list_del(&source->always_list);
+	source->always = 0;
+	free(source->pfds);
+	free(source->fds);
+	source->pfds = NULL;
+	source->fds = NULL;
+	source->nfds = 0;
+}
+
+static int evloop_register_fd(snd_evloop_source_t *source, unsigned int i)
+{
+	struct snd_evloop_fd *f = &source->fds[i];
+	struct epoll_event ev;
+	int err;
+
+	f->source = source;
+	f->index = i;
+	f->fd = source->pfds[i].fd;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (unsigned short)source->pfds[i].events;
+	ev.data.ptr = f;
+	if (epoll_ctl(source->loop->epfd, EPOLL_CTL_ADD, f->fd, &ev) == 0)
+		return 0;
+	switch (errno) {
+	case EPERM:
+		/* a regular file or a device without poll, poll() says ready */
+		f->always = 1;
+		return 0;
+	case EEXIST:
+		/* the fd is registered by another source, use a duplicate */
+		f->fd = fcntl(source->pfds[i].fd, F_DUPFD_CLOEXEC, 0);
+		if (f->fd < 0)
+			break;
+		if (epoll_ctl(source->loop->epfd, EPOLL_CTL_ADD, f->fd, &ev) == 0)
+			return 0;
+		err = -errno;
+		close(f->fd);
+		f->fd = source->pfds[i].fd;
+		return err;
+	}
+	return -errno;
+}
+
+static int evloop_register(snd_evloop_source_t *source)
+{
+	unsigned int i;
+	int count, err;
+
+	if (source->ops) {
+		count = source->ops->descriptors_count(source->handle, source->events);
+		if (count < 0)
+			return count;
+	} else {
+		count = 1;
+	}
+	source->pfds = calloc(count ? count : 1, sizeof(*source->pfds));
+	source->fds = calloc(count ? count : 1, sizeof(*source->fds));
+	if (!source->pfds || !source->fds) {
+		err = -ENOMEM;
+		goto error;
+	}
+	if (source->ops) {
+		err = source->ops->descriptors(source->handle, source->pfds,
+					       count, source->events);
+		if (err < 0)
+			goto error;
+		count = err;
+	} else {
+		source->pfds[0].fd = (int)(long)source->handle;
+		source->pfds[0].events = source->events;
+	}
+	for (i = 0; i < (unsigned int)count; i++) {
+		err = evloop_register_fd(source, i);
+		if (err < 0)
+			goto error;
+		source->nfds++;
+		if (source->fds[i].always && !source->always) {
+			source->always = 1;
+			list_add_tail(&source->always_list, &source->loop->always);
+		}
+	}
+	return 0;
+
+ error:
+	SNDERR("cannot register the descriptors (%i)", err);
+	evloop_unregister(source);
+	return err;
+}
+
+/**
+ * \brief Registers a handle in an event loop (internal).
+ * \param source The function puts the pointer to the new source object at
+ *               the address specified by \p source.
+ * \param loop The event loop.
+ * \param type The type of the handle.
+ * \param handle The handle, or the file descriptor for the generic type.
+ * \param ops The descriptor callbacks of the handle type, NULL for the
+ *            generic type.
+ * \param events The events passed to the descriptor callbacks.
+ * \param callback The callback function.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ */
+int snd_evloop_add_source(snd_evloop_source_t **source, snd_evloop_t *loop,
+			  evloop_source_type_t type, void *handle,
+			  const evloop_source_ops_t *ops, short events,
+			  snd_evloop_callback_t callback, void *private_data)
+{
+	snd_evloop_source_t *s;
+	int err;
+
+	assert(source && loop && callback);
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->loop = loop;
+	s->type = type;
+	s->handle = handle;
+	s->ops = ops;
+	s->events = events;
+	s->callback = callback;
+	s->private_data = private_data;
+	err = evloop_register(s);
+	if (err < 0) {
+		free(s);
+		return err;
+	}
+	list_add_tail(&s->list, &loop->sources);
+	*source = s;
+	return 0;
+}
+
+/**
+ * \brief Returns the handle of a source (internal).
+ * \param source The source.
+ * \param type The expected type of the handle.
+ * \result The handle.
+ */
+void *snd_evloop_source_handle(snd_evloop_source_t *source,
+			       evloop_source_type_t type)
+{
+	assert(source && source->type == type);
+	return source->handle;
+}
+
+/**
+ * \brief Registers a file descriptor in an event loop.
+ * \param source The function puts the pointer to the new source object at
+ *               the address specified by \p source.
+ * \param loop The event loop.
+ * \param fd The file descriptor.
+ * \param events The poll events to wait for.
+ * \param callback The callback function.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The callback gets the poll revents of the file descriptor unchanged.
+ *
+ * \see snd_evloop_add_pcm, snd_evloop_add_ctl, snd_evloop_add_rawmidi,
+ *      snd_evloop_add_seq, snd_evloop_add_timer
+ */
+int snd_evloop_add_handler(snd_evloop_source_t **source, snd_evloop_t *loop,
+			   int fd, short events, snd_evloop_callback_t callback,
+			   void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_GENERIC,
+				     (void *)(long)fd, NULL, events,
+				     callback, private_data);
+}
+
+/**
+ * \brief Deletes a source from its event loop.
+ * \param source The source.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The handle itself is not closed.  A callback may delete any source,
+ * including its own.
+ */
+int snd_evloop_del_source(snd_evloop_source_t *source)
+{
+	assert(source);
+	evloop_unregister(source);
+	list_del(&source->list);
+	if (source->ready)
+		list_del(&source->ready_list);
+	free(source);
+	return 0;
+}
+
+/**
+ * \brief Reads the poll descriptors of a source again.
+ * \param source The source.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The descriptors are read at the registration.  When they change later,
+ * e.g. for an external plugin which creates them at hw_params, the source
+ * must be updated.  The source is deleted when this fails.
+ */
+int snd_evloop_update_source(snd_evloop_source_t *source)
+{
+	int err;
+
+	assert(source);
+	evloop_unregister(source);
+	err = evloop_register(source);
+	if (err < 0)
+		snd_evloop_del_source(source);
+	return err;
+}
+
+/**
+ * \brief Returns the private data of the callback of a source.
+ * \param source The source.
+ * \result The private data passed at the registration.
+ */
+void *snd_evloop_source_get_callback_private(snd_evloop_source_t *source)
+{
+	assert(source);
+	return source->private_data;
+}
+
+static void evloop_set_ready(struct list_head *ready, snd_evloop_source_t *s)
+{
+	if (!s->ready) {
+		s->ready = 1;
+		list_add_tail(&s->ready_list, ready);
+	}
+}
+
+/**
+ * \brief Waits for events and calls the callbacks of the ready sources.
+ * \param loop The event loop.
+ * \param timeout The maximum time to wait in milliseconds, -1 for infinite.
+ * \result The number of the called callbacks, zero on timeout, otherwise
+ *         a negative error code (-EINTR when interrupted by a signal).
+ *
+ * The callback of a source is called once per wait with the revents
+ * demangled by the handle, e.g. #snd_pcm_poll_descriptors_revents.  The
+ * sources whose demangled revents are zero (e.g. a dmix timer wakeup
+ * before a period is available) are skipped.
+ */
+int snd_evloop_wait(snd_evloop_t *loop, int timeout)
+{
+	struct epoll_event ev[SND_EVLOOP_MAX_EVENTS];
+	struct list_head ready, *pos;
+	unsigned short revents;
+	unsigned int i;
+	int n, err, count = 0;
+
+	assert(loop);
+	if (!list_empty(&loop->always))
+		timeout = 0;
+	n = epoll_wait(loop->epfd, ev, SND_EVLOOP_MAX_EVENTS, timeout);
+	if (n < 0)
+		return -errno;
+
+	INIT_LIST_HEAD(&ready);
+	for (i = 0; i < (unsigned int)n; i++) {
+		struct snd_evloop_fd *f = ev[i].data.ptr;
+
+		f->source->pfds[f->index].revents = ev[i].events;
+		evloop_set_ready(&ready, f->source);
+	}
+	list_for_each(pos, &loop->always) {
+		snd_evloop_source_t *s = list_entry(pos, snd_evloop_source_t,
+						    always_list);
+
+		for (i = 0; i < s->nfds; i++)
+			if (s->fds[i].always)
+				s->pfds[i].revents = s->pfds[i].events &
+						     (POLLIN | POLLOUT);
+		evloop_set_ready(&ready, s);
+	}
+
+	/* a callback may delete any source, which takes it off the list */
+	while (!list_empty(&ready)) {
+		snd_evloop_source_t *s = list_entry(ready.next,
+						    snd_evloop_source_t,
+						    ready_list);
+
+		list_del(&s->ready_list);
+		s->ready = 0;
+		if (s->ops) {
+			err = s->ops->revents(s->handle, s->pfds, s->nfds,
+					      &revents);
+			if (err < 0)
+				revents = POLLERR;
+		} else {
+			revents = s->pfds[0].revents;
+		}
+		for (i = 0; i < s->nfds; i++)
+			s->pfds[i].revents = 0;
+		if (revents) {
+			s->callback(s, revents);
+			count++;
+		}
+	}
+	return count;
+}
@@ -515,6 +515,14 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+An application which calls the functions of a PCM handle from one thread
+only can pass #SND_PCM_SINGLE_THREAD to #snd_pcm_open().  The flag is
+passed down to the slave PCMs, and the whole plugin chain then skips the
+mutex around every call, e.g. #snd_pcm_avail_update(),
+#snd_pcm_mmap_begin() or #snd_pcm_writei(), like with
+LIBASOUND_THREAD_SAFE=0 but only for this handle.  The handle must not be
+used from other threads, including the async handlers.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -966,6 +974,7 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 		err = pcm->ops->hw_free(pcm->op_arg);
 	else
 		err = -ENOSYS;
+	snd_pcm_scratch_release(pcm);
 	pcm->setup = 0;
 	if (err < 0)
 		return err;
@@ -2490,6 +2499,62 @@ snd_pcm_t *snd_async_handler_get_pcm(snd_async_handler_t *handler)
 	return handler->u.pcm;
 }
 
+static int evloop_pcm_count(void *handle, short events ATTRIBUTE_UNUSED)
+{
+	return snd_pcm_poll_descriptors_count(handle);
+}
+
+static int evloop_pcm_descriptors(void *handle, struct pollfd *pfds,
+				  unsigned int space, short events ATTRIBUTE_UNUSED)
+{
+	return snd_pcm_poll_descriptors(handle, pfds, space);
+}
+
+static int evloop_pcm_revents(void *handle, struct pollfd *pfds,
+			      unsigned int nfds, unsigned short *revents)
+{
+	return snd_pcm_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const evloop_source_ops_t evloop_pcm_ops = {
+	.descriptors_count = evloop_pcm_count,
+	.descriptors = evloop_pcm_descriptors,
+	.revents = evloop_pcm_revents,
+};
+
+/**
+ * \brief Add a PCM to an event loop
+ * \param source Returned source handle
+ * \param loop Event loop
+ * \param pcm PCM handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback gets the revents demangled by
+ * #snd_pcm_poll_descriptors_revents().
+ * Call #snd_evloop_update_source() when the descriptors change,
+ * e.g. after #snd_pcm_hw_params() for some external plugins.
+ */
+int snd_evloop_add_pcm(snd_evloop_source_t **source, snd_evloop_t *loop,
+		       snd_pcm_t *pcm, snd_evloop_callback_t callback,
+		       void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_PCM, pcm,
+				     &evloop_pcm_ops, 0,
+				     callback, private_data);
+}
+
+/**
+ * \brief Return the PCM handle of an event loop source
+ * \param source Source handle
+ * \return PCM handle
+ */
+snd_pcm_t *snd_evloop_source_get_pcm(snd_evloop_source_t *source)
+{
+	return snd_evloop_source_handle(source, EVLOOP_SOURCE_PCM);
+}
+
 static const char *const build_in_pcms[] = {
 	"adpcm", "alaw", "copy", "dmix", "file", "hooks", "hw", "ladspa", "lfloat",
 	"linear", "meter", "mulaw", "multi", "null", "empty", "plug", "rate", "route", "share",
@@ -2771,6 +2836,9 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 	if (mode & SND_PCM_ASYNC) {
 		/* async handler may lead to a deadlock; suppose no MT */
 		pcm->lock_enabled = 0;
+	} else if (mode & SND_PCM_SINGLE_THREAD) {
+		/* the application promised not to share the handle */
+		pcm->lock_enabled = 0;
 	} else {
 		/* set lock_enabled field depending on $LIBASOUND_THREAD_SAFE */
 		static int do_lock_enable = -1; /* uninitialized */
@@ -2797,10 +2865,59 @@ int snd_pcm_free(snd_pcm_t *pcm)
 #ifdef THREAD_SAFE_API
 	pthread_mutex_destroy(&pcm->lock);
 #endif
+	snd_pcm_scratch_release(pcm);
 	free(pcm);
 	return 0;
 }
 
+/* uses the scratch buffers of the slave, called when the slave is set up */
+void snd_pcm_scratch_share(snd_pcm_t *pcm, snd_pcm_t *slave)
+{
+	if (pcm->scratch || !slave->scratch)
+		return;
+	pcm->scratch = slave->scratch;
+	pcm->scratch->refs++;
+}
+
+/* makes the buffer of the given slot at least size bytes long */
+int snd_pcm_scratch_reserve(snd_pcm_t *pcm, unsigned int slot, size_t size)
+{
+	snd_pcm_scratch_t *scratch = pcm->scratch;
+	void *buf;
+
+	assert(slot < SND_PCM_SCRATCH_SLOTS);
+	if (!scratch) {
+		scratch = calloc(1, sizeof(*scratch));
+		if (!scratch)
+			return -ENOMEM;
+		scratch->refs = 1;
+		pcm->scratch = scratch;
+	}
+	if (size <= scratch->size[slot])
+		return 0;
+	buf = realloc(scratch->buf[slot], size);
+	if (!buf)
+		return -ENOMEM;
+	scratch->buf[slot] = buf;
+	scratch->size[slot] = size;
+	return 0;
+}
+
+void snd_pcm_scratch_release(snd_pcm_t *pcm)
+{
+	snd_pcm_scratch_t *scratch = pcm->scratch;
+	unsigned int slot;
+
+	if (!scratch)
+		return;
+	pcm->scratch = NULL;
+	if (--scratch->refs)
+		return;
+	for (slot = 0; slot < SND_PCM_SCRATCH_SLOTS; slot++)
+		free(scratch->buf[slot]);
+	free(scratch);
+}
+
 int snd_pcm_open_named_slave(snd_pcm_t **pcmp, const char *name,
 			     snd_config_t *root,
 			     snd_config_t *conf, snd_pcm_stream_t stream,
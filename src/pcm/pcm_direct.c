@@ -52,8 +52,9 @@ union semun {
 };
  
 /*
- * FIXME:
- *  add possibility to use futexes here
+ * The semaphore serializes open and close of the clients.  The mixing
+ * itself may use a robust mutex in the shared memory area instead
+ * (ipc_lock), see snd_pcm_direct_lock().
  */
 
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
@@ -90,6 +91,26 @@ static unsigned int snd_pcm_direct_magic(snd_pcm_direct_t *dmix)
 		return 0xb15ad300 + sizeof(snd_pcm_direct_share_t);
 }
 
+/* the first client decides the lock type, fall back to the semaphore
+ * when the robust mutex cannot be set up
+ */
+static unsigned int snd_pcm_direct_ipc_lock_type(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	if (dmix->ipc_lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX) {
+		if (snd_pcm_direct_robust_init(&dmix->shmptr->lock) >= 0) {
+			dmix->shmptr->lock_abi = sizeof(long);
+			return SND_PCM_DIRECT_IPC_LOCK_FUTEX;
+		}
+		SNDERR("futex is not available, using semaphore");
+	}
+#else
+	if (dmix->ipc_lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX)
+		SNDERR("futex is not supported, using semaphore");
+#endif
+	return SND_PCM_DIRECT_IPC_LOCK_SEM;
+}
+
 /*
  *  global shared memory area 
  */
@@ -138,6 +159,7 @@ retryget:
 			buf.shm_perm.gid = dmix->ipc_gid;
 			shmctl(dmix->shmid, IPC_SET, &buf);
 		}
+		dmix->shmptr->ipc_lock = snd_pcm_direct_ipc_lock_type(dmix);
 		dmix->shmptr->magic = snd_pcm_direct_magic(dmix);
 		return 1;
 	} else {
@@ -145,6 +167,13 @@ retryget:
 			snd_pcm_direct_shm_discard(dmix);
 			return -EINVAL;
 		}
+		/* the mutex layout differs between 32 and 64 bit clients */
+		if (dmix->shmptr->ipc_lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX &&
+		    dmix->shmptr->lock_abi != sizeof(long)) {
+			SNDERR("futex ipc_lock is shared with clients of another ABI");
+			snd_pcm_direct_shm_discard(dmix);
+			return -EINVAL;
+		}
 	}
 	return 0;
 }
@@ -572,8 +601,7 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	int ret;
 	int semerr;
 
-	semerr = snd_pcm_direct_semaphore_down(direct,
-						   DIRECT_IPC_SEM_CLIENT);
+	semerr = snd_pcm_direct_lock(direct);
 	if (semerr < 0) {
 		SNDERR("SEMDOWN FAILED with err %d", semerr);
 		return semerr;
@@ -581,8 +609,7 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 
 	if (snd_pcm_state(direct->spcm) != SND_PCM_STATE_XRUN) {
 		/* ignore... someone else already did recovery */
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
+		semerr = snd_pcm_direct_unlock(direct);
 		if (semerr < 0) {
 			SNDERR("SEMUP FAILED with err %d", semerr);
 			return semerr;
@@ -593,8 +620,7 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	ret = snd_pcm_prepare(direct->spcm);
 	if (ret < 0) {
 		SNDERR("recover: unable to prepare slave");
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
+		semerr = snd_pcm_direct_unlock(direct);
 		if (semerr < 0) {
 			SNDERR("SEMUP FAILED with err %d", semerr);
 			return semerr;
@@ -613,8 +639,7 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	ret = snd_pcm_start(direct->spcm);
 	if (ret < 0) {
 		SNDERR("recover: unable to start slave");
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
+		semerr = snd_pcm_direct_unlock(direct);
 		if (semerr < 0) {
 			SNDERR("SEMUP FAILED with err %d", semerr);
 			return semerr;
@@ -622,8 +647,7 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 		return ret;
 	}
 	direct->shmptr->s.recoveries++;
-	semerr = snd_pcm_direct_semaphore_up(direct,
-						 DIRECT_IPC_SEM_CLIENT);
+	semerr = snd_pcm_direct_unlock(direct);
 	if (semerr < 0) {
 		SNDERR("SEMUP FAILED with err %d", semerr);
 		return semerr;
@@ -650,11 +674,66 @@ int snd_pcm_direct_client_chk_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm)
 		 * snd_pcm_direct_clear_timer_queue(direct);
 		 */
 		direct->state = SND_PCM_STATE_XRUN;
+		if (direct->stats)
+			direct->stats->xruns++;
 		return 1;
 	}
 	return 0;
 }
 
+/*
+ * claim a statistics slot in the shared memory area, slots of crashed
+ * clients are reused; called with the client semaphore held
+ */
+void snd_pcm_direct_stats_attach(snd_pcm_direct_t *direct)
+{
+	snd_pcm_direct_stats_t *stats;
+	unsigned int i;
+
+	for (i = 0; i < DIRECT_STATS_CLIENTS; i++) {
+		stats = &direct->shmptr->stats[i];
+		if (stats->pid && (kill(stats->pid, 0) == 0 || errno != ESRCH))
+			continue;
+		memset(stats, 0, sizeof(*stats));
+		stats->pid = getpid();
+		direct->stats = stats;
+		return;
+	}
+	SNDERR("no free statistics slot, disabled");
+}
+
+void snd_pcm_direct_stats_detach(snd_pcm_direct_t *direct)
+{
+	if (direct->stats) {
+		direct->stats->pid = 0;
+		direct->stats = NULL;
+	}
+}
+
+/* print the statistics of all clients sharing the slave */
+void snd_pcm_direct_stats_dump(snd_pcm_direct_t *direct, snd_output_t *out)
+{
+	snd_pcm_direct_stats_t *stats;
+	unsigned int i, j;
+
+	snd_output_printf(out, "Client statistics:\n");
+	for (i = 0; i < DIRECT_STATS_CLIENTS; i++) {
+		stats = &direct->shmptr->stats[i];
+		if (!stats->pid)
+			continue;
+		snd_output_printf(out, "  %cpid %d: commits %llu, frames %llu, "
+				  "mix %llu us, lock wait %llu us, xruns %u\n",
+				  stats == direct->stats ? '*' : ' ',
+				  (int)stats->pid, stats->commits, stats->frames,
+				  stats->mix_ns / 1000, stats->lock_wait_ns / 1000,
+				  stats->xruns);
+		snd_output_printf(out, "    mix time histogram (< 2^n us):");
+		for (j = 0; j < DIRECT_STATS_BUCKETS; j++)
+			snd_output_printf(out, " %llu", stats->mix_hist[j]);
+		snd_output_printf(out, "\n");
+	}
+}
+
 /*
  * This is the only operation guaranteed to be called before entering poll().
  * Direct plugins use fd of snd_timer to poll on, these timers do NOT check
@@ -857,6 +936,13 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 					(1<<SNDRV_PCM_ACCESS_RW_INTERLEAVED) |
 					(1<<SNDRV_PCM_ACCESS_RW_NONINTERLEAVED),
 					0, 0, 0 } };
+	/* the client areas are a subset of the slave ones (zero_copy) */
+	static const snd_mask_t access_shadow = { .bits = {
+					(1<<SNDRV_PCM_ACCESS_MMAP_COMPLEX) |
+					(1<<SNDRV_PCM_ACCESS_RW_INTERLEAVED) |
+					(1<<SNDRV_PCM_ACCESS_RW_NONINTERLEAVED),
+					0, 0, 0 } };
+	snd_mask_t format;
 	int err;
 
 #ifdef REFINE_DEBUG
@@ -870,7 +956,8 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			SNDERR("dshare access mask empty?");
 			return -EINVAL;
 		}
-		if (snd_mask_refine(hw_param_mask(params, SND_PCM_HW_PARAM_ACCESS), &access))
+		if (snd_mask_refine(hw_param_mask(params, SND_PCM_HW_PARAM_ACCESS),
+				    pcm->mmap_shadow ? &access_shadow : &access))
 			params->cmask |= 1<<SND_PCM_HW_PARAM_ACCESS;
 	}
 	if (params->rmask & (1<<SND_PCM_HW_PARAM_FORMAT)) {
@@ -878,8 +965,14 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			SNDERR("dshare format mask empty?");
 			return -EINVAL;
 		}
-		if (snd_mask_refine_set(hw_param_mask(params, SND_PCM_HW_PARAM_FORMAT),
-					dshare->shmptr->hw.format))
+		snd_mask_none(&format);
+		snd_mask_set(&format, dshare->shmptr->hw.format);
+		/* dmix with the float sum buffer mixes float clients directly */
+		if (dshare->type == SND_PCM_TYPE_DMIX &&
+		    dshare->shmptr->u.dmix.float_sum)
+			snd_mask_set(&format, SND_PCM_FORMAT_FLOAT);
+		if (snd_mask_refine(hw_param_mask(params, SND_PCM_HW_PARAM_FORMAT),
+				    &format))
 			params->cmask |= 1<<SND_PCM_HW_PARAM_FORMAT;
 	}
 	//snd_mask_none(hw_param_mask(params, SND_PCM_HW_PARAM_SUBFORMAT));
@@ -1001,12 +1094,53 @@ int snd_pcm_direct_hw_free(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
 	return 0;
 }
 
+/*
+ * adaptive wakeup: the slave timer fires every timer_ticks periods.
+ * A client may become ready just after an event, so the next one comes
+ * when up to avail_min + timer_ticks periods are available; keep that
+ * within the buffer.
+ */
+static unsigned int snd_pcm_direct_wakeup_ticks(snd_pcm_t *pcm,
+						snd_pcm_direct_t *dmix,
+						snd_pcm_uframes_t avail_min)
+{
+	snd_pcm_uframes_t frames;
+
+	if (!dmix->slave_period_size || avail_min >= pcm->buffer_size)
+		return 1;
+	frames = avail_min;
+	if (frames > pcm->buffer_size - avail_min)
+		frames = pcm->buffer_size - avail_min;
+	frames /= dmix->slave_period_size;
+	return frames ? frames : 1;
+}
+
 int snd_pcm_direct_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 {
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	unsigned int ticks;
+	int err;
+
 	if (params->tstamp_type != pcm->tstamp_type)
 		return -EINVAL;
 
 	/* values are cached in the pcm structure */
+	if (!dmix->adaptive_wakeup)
+		return 0;
+	ticks = snd_pcm_direct_wakeup_ticks(pcm, dmix, params->avail_min);
+	if (ticks != dmix->timer_ticks) {
+		dmix->timer_ticks = ticks;
+		/* otherwise applied at prepare */
+		if (dmix->state == SND_PCM_STATE_RUNNING ||
+		    dmix->state == SND_PCM_STATE_DRAINING) {
+			err = snd_pcm_direct_set_timer_params(dmix);
+			if (err < 0)
+				return err;
+			err = snd_timer_start(dmix->timer);
+			if (err < 0)
+				return err;
+		}
+	}
 	return 0;
 }
 
@@ -1015,16 +1149,62 @@ int snd_pcm_direct_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * info)
         return snd_pcm_channel_info_shm(pcm, info, -1);
 }
 
-int snd_pcm_direct_mmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+int snd_pcm_direct_munmap(snd_pcm_t *pcm)
 {
+	if (!pcm->mmap_shadow)
+		return 0;
+	free(pcm->mmap_channels);
+	free(pcm->running_areas);
+	pcm->mmap_channels = NULL;
+	pcm->running_areas = NULL;
 	return 0;
 }
-        
-int snd_pcm_direct_munmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+
+/* zero_copy maps the bound slave channels, the client has no own buffer */
+int snd_pcm_direct_mmap(snd_pcm_t *pcm)
 {
+	snd_pcm_direct_t *direct = pcm->private_data;
+	snd_pcm_t *spcm = direct->spcm;
+	unsigned int chn, schn;
+
+	if (!pcm->mmap_shadow)
+		return 0;
+	pcm->mmap_channels = calloc(pcm->channels,
+				    sizeof(pcm->mmap_channels[0]));
+	pcm->running_areas = calloc(pcm->channels,
+				    sizeof(pcm->running_areas[0]));
+	if (!pcm->mmap_channels || !pcm->running_areas) {
+		snd_pcm_direct_munmap(pcm);
+		return -ENOMEM;
+	}
+	for (chn = 0; chn < pcm->channels; chn++) {
+		schn = direct->bindings ? direct->bindings[chn] : chn;
+		pcm->mmap_channels[chn] = spcm->mmap_channels[schn];
+		pcm->mmap_channels[chn].channel = chn;
+		pcm->running_areas[chn] = spcm->running_areas[schn];
+	}
 	return 0;
 }
 
+/*
+ * enable the zero_copy mode: the client ring is the slave ring, so its
+ * geometry is forced; all client channels must be bound
+ */
+void snd_pcm_direct_setup_zero_copy(snd_pcm_t *pcm, snd_pcm_direct_t *direct)
+{
+	unsigned int chn;
+
+	for (chn = 0; direct->bindings && chn < direct->channels; chn++) {
+		if (direct->bindings[chn] == UINT_MAX) {
+			SNDERR("zero_copy requires all channels to be bound, disabled");
+			return;
+		}
+	}
+	direct->max_periods = -1;
+	direct->zero_copy = 1;
+	pcm->mmap_shadow = 1;
+}
+
 snd_pcm_chmap_query_t **snd_pcm_direct_query_chmaps(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
@@ -1075,7 +1255,7 @@ int snd_pcm_direct_resume(snd_pcm_t *pcm)
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_t *spcm = dmix->spcm;
 
-	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+	snd_pcm_direct_lock(dmix);
 	/* some buggy drivers require the device resumed before prepared;
 	 * when a device has RESUME flag and is in SUSPENDED state, resume
 	 * here but immediately drop to bring it to a sane active state.
@@ -1092,7 +1272,7 @@ int snd_pcm_direct_resume(snd_pcm_t *pcm)
 		snd_pcm_prepare(spcm);
 		snd_pcm_start(spcm);
 	}
-	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+	snd_pcm_direct_unlock(dmix);
 	return -ENOSYS;
 }
 
@@ -1887,6 +2067,7 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 {
 	snd_config_iterator_t i, next;
 	int ipc_key_add_uid = 0;
+	unsigned int staging_clients = 0;
 	snd_config_t *n;
 	int err;
 
@@ -1905,6 +2086,13 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 #endif
 	rec->hw_ptr_alignment = SND_PCM_HW_PTR_ALIGNMENT_AUTO;
 	rec->tstamp_type = -1;
+	rec->staging_clients = 0;
+	rec->float_sum = 0;
+	rec->mix_batch = 0;
+	rec->zero_copy = 0;
+	rec->adaptive_wakeup = 0;
+	rec->stats = 0;
+	rec->ipc_lock = SND_PCM_DIRECT_IPC_LOCK_SEM;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -1946,6 +2134,23 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->ipc_perm = perm;
 			continue;
 		}
+		if (strcmp(id, "ipc_lock") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "sem") == 0)
+				rec->ipc_lock = SND_PCM_DIRECT_IPC_LOCK_SEM;
+			else if (strcmp(str, "futex") == 0)
+				rec->ipc_lock = SND_PCM_DIRECT_IPC_LOCK_FUTEX;
+			else {
+				SNDERR("The field ipc_lock is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "hw_ptr_alignment") == 0) {
 			const char *str;
 			err = snd_config_get_string(n, &str);
@@ -2068,6 +2273,86 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->direct_memory_access = err;
 			continue;
 		}
+		if (strcmp(id, "mix_mode") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "sum") == 0)
+				rec->staging_clients = 0;
+			else if (strcmp(str, "staging") == 0) {
+				if (!rec->staging_clients)
+					rec->staging_clients = 16;
+			} else {
+				SNDERR("The field mix_mode is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "sum_format") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "int") == 0)
+				rec->float_sum = 0;
+			else if (strcmp(str, "float") == 0)
+				rec->float_sum = 1;
+			else {
+				SNDERR("The field sum_format is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "mix_batch") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0) {
+				SNDERR("The field mix_batch is invalid : %ld", val);
+				return -EINVAL;
+			}
+			rec->mix_batch = val;
+			continue;
+		}
+		if (strcmp(id, "zero_copy") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->zero_copy = err;
+			continue;
+		}
+		if (strcmp(id, "adaptive_wakeup") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->adaptive_wakeup = err;
+			continue;
+		}
+		if (strcmp(id, "stats") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->stats = err;
+			continue;
+		}
+		if (strcmp(id, "staging_clients") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 1 || val > 1024) {
+				SNDERR("The field staging_clients is invalid : %ld", val);
+				return -EINVAL;
+			}
+			staging_clients = val;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -2079,6 +2364,12 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 		SNDERR("Unique IPC key is not defined");
 		return -EINVAL;
 	}
+	if (rec->staging_clients && rec->float_sum) {
+		SNDERR("float sum_format cannot be used in the staging mix_mode");
+		return -EINVAL;
+	}
+	if (rec->staging_clients && staging_clients)
+		rec->staging_clients = staging_clients;
 	if (ipc_key_add_uid)
 		rec->ipc_key += getuid();
 	err = snd_pcm_direct_get_slave_ipc_offset(root, conf, stream);
@@ -21,6 +21,10 @@
 
 #include "pcm_local.h"  
 #include "../timer/timer_local.h"
+#if defined(__linux__) && defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define DIRECT_HAVE_ROBUST_LOCK	1
+#endif
 
 #define DIRECT_IPC_SEMS         1
 #define DIRECT_IPC_SEM_CLIENT   0
@@ -28,6 +32,9 @@
 #define SEC_TO_MS               1000
 /* slave_period time for low latency requirements in ms */
 #define LOW_LATENCY_PERIOD_TIME 10
+/* client statistics - slots and mix time histogram buckets (< 2^n us) */
+#define DIRECT_STATS_CLIENTS	16
+#define DIRECT_STATS_BUCKETS	12
 
 
 typedef void (mix_areas_t)(unsigned int size,
@@ -62,6 +69,11 @@ typedef enum snd_pcm_direct_hw_ptr_alignment {
 	SND_PCM_HW_PTR_ALIGNMENT_AUTO = 3	/* automatic selection */
 } snd_pcm_direct_hw_ptr_alignment_t;
 
+typedef enum snd_pcm_direct_ipc_lock {
+	SND_PCM_DIRECT_IPC_LOCK_SEM = 0,	/* SysV semaphore */
+	SND_PCM_DIRECT_IPC_LOCK_FUTEX = 1	/* robust mutex in the shared memory area */
+} snd_pcm_direct_ipc_lock_t;
+
 struct slave_params {
 	snd_pcm_format_t format;
 	int rate;
@@ -73,12 +85,38 @@ struct slave_params {
 	unsigned int periods;
 };
 
+/*
+ * process shared robust mutex, in a shared memory area; the size is fixed
+ * but the content depends on the ABI (see lock_abi)
+ */
+typedef union {
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	pthread_mutex_t mutex;
+#endif
+	char pad[64];
+} __attribute__((aligned(8))) snd_pcm_direct_robust_t;
+
+/* per-client statistics, in the shared memory area */
+typedef struct {
+	pid_t pid;				/* owner, 0 = free slot */
+	unsigned int xruns;			/* xruns seen by the client */
+	unsigned long long commits;		/* mixed commits */
+	unsigned long long frames;		/* mixed frames */
+	unsigned long long mix_ns;		/* time spent mixing */
+	unsigned long long lock_wait_ns;	/* time spent waiting for the lock */
+	unsigned long long mix_hist[DIRECT_STATS_BUCKETS]; /* mix time histogram */
+} snd_pcm_direct_stats_t;
+
 /* shared among direct plugin clients - be careful to be 32/64bit compatible! */
 typedef struct {
 	unsigned int magic;			/* magic number */
 	char socket_name[256];			/* name of communication socket */
 	snd_pcm_type_t type;			/* PCM type (currently only hw) */
 	int use_server;
+	unsigned int ipc_lock;			/* lock type used by all clients */
+	unsigned int lock_abi;			/* sizeof(long) of the lock creator */
+	unsigned int lock_pad;
+	snd_pcm_direct_robust_t lock;		/* SND_PCM_DIRECT_IPC_LOCK_FUTEX */
 	struct {
 		unsigned int format;
 		snd_interval_t rate;
@@ -124,9 +162,33 @@ typedef struct {
 		struct {
 			unsigned long long chn_mask;
 		} dshare;
+		struct {
+			unsigned int staging_clients;	/* 0 = shared sum buffer */
+			unsigned int float_sum;		/* sum buffer holds floats */
+		} dmix;
 	} u;
+	snd_pcm_direct_stats_t stats[DIRECT_STATS_CLIENTS];
 } snd_pcm_direct_share_t;
 
+/* dmix staging mode - per-client ring state, shared among clients */
+typedef struct {
+	unsigned int pad[2];
+	unsigned long long written;		/* end of the staged frames (slave ptr) */
+	unsigned long long reduced;		/* written value at the last reduction */
+} snd_pcm_dmix_stage_slot_t;
+
+/* dmix staging mode - shared area, followed by the per-client rings */
+typedef struct {
+	snd_pcm_direct_robust_t reducer;	/* held by the reducing client */
+	unsigned int pending;			/* staged data waits for the reduction */
+	unsigned int clients;			/* number of slots */
+	unsigned int frames;			/* ring size in frames (slave buffer size) */
+	unsigned int channels;			/* slave channels */
+	unsigned int lock_abi;			/* sizeof(long) of the reducer lock creator */
+	unsigned int pad;
+	snd_pcm_dmix_stage_slot_t slot[0];
+} snd_pcm_dmix_stage_t;
+
 typedef struct snd_pcm_direct snd_pcm_direct_t;
 
 struct snd_pcm_direct {
@@ -136,6 +198,7 @@ struct snd_pcm_direct {
 	int ipc_gid;			/* IPC socket gid */
 	int semid;			/* IPC global semaphore identification */
 	int locked[DIRECT_IPC_SEMS];	/* local lock counter */
+	snd_pcm_direct_ipc_lock_t ipc_lock; /* requested lock type */
 	int shmid;			/* IPC global shared memory identification */
 	snd_pcm_direct_share_t *shmptr;	/* pointer to shared memory area */
 	snd_pcm_t *spcm; 		/* slave PCM handle */
@@ -166,6 +229,9 @@ struct snd_pcm_direct {
 	snd_timer_t *timer; 		/* timer used as poll_fd */
 	int interleaved;	 	/* we have interleaved buffer */
 	int slowptr;			/* use slow but more precise ptr updates */
+	int zero_copy;			/* client areas point to the slave buffer */
+	int adaptive_wakeup;		/* timer ticks follow avail_min */
+	snd_pcm_direct_stats_t *stats;	/* own statistics slot, NULL = off */
 	int max_periods;		/* max periods (-1 = fixed periods, 0 = max buffer size) */
 	int var_periodsize;		/* allow variable period size if max_periods is != -1*/
 	unsigned int channels;		/* client's channels */
@@ -187,6 +253,16 @@ struct snd_pcm_direct {
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
 			unsigned int use_sem;
+			int shmid_stage;		/* IPC staging area memory identification */
+			int semid_stage;		/* IPC staging slot owners, one semaphore per slot */
+			snd_pcm_dmix_stage_t *stage;	/* shared staging area, NULL = sum buffer mode */
+			int stage_slot;			/* own slot in the staging area */
+			signed int *stage_acc;		/* local reduction buffer */
+			unsigned long long *stage_written; /* local copy of the written positions */
+			mix_areas_t *float_mix;		/* float sum buffer callbacks for */
+			mix_areas_t *float_remix;	/* the client format */
+			unsigned int float_src_size;	/* client sample size in bytes */
+			unsigned int mix_batch;		/* min. frames to mix at once, 0 = off */
 		} dmix;
 		struct {
 			unsigned long long chn_mask;
@@ -244,6 +320,8 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_munmap
 #define snd_pcm_direct_prepare \
 	snd1_pcm_direct_prepare
+#define snd_pcm_direct_setup_zero_copy \
+	snd1_pcm_direct_setup_zero_copy
 #define snd_pcm_direct_resume \
 	snd1_pcm_direct_resume
 #define snd_pcm_direct_timer_stop \
@@ -264,6 +342,12 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_set_chmap
 #define snd_pcm_direct_reset_slave_ptr \
 	snd1_pcm_direct_reset_slave_ptr
+#define snd_pcm_direct_stats_attach \
+	snd1_pcm_direct_stats_attach
+#define snd_pcm_direct_stats_detach \
+	snd1_pcm_direct_stats_detach
+#define snd_pcm_direct_stats_dump \
+	snd1_pcm_direct_stats_dump
 
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix);
 
@@ -308,6 +392,77 @@ static inline int snd_pcm_direct_semaphore_final(snd_pcm_direct_t *dmix, int sem
 	return snd_pcm_direct_semaphore_up(dmix, sem_num);
 }
 
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+static inline int snd_pcm_direct_robust_init(snd_pcm_direct_robust_t *lock)
+{
+	pthread_mutexattr_t attr;
+	int err;
+
+	err = pthread_mutexattr_init(&attr);
+	if (err)
+		return -err;
+	err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if (!err)
+		err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!err)
+		err = pthread_mutex_init(&lock->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return -err;
+}
+
+/*
+ * the lock word holds the tid of the holder and the kernel marks it when
+ * the holder dies (robust futex list), so the next locker takes it over
+ * with EOWNERDEAD; at worst, the data is left partially updated
+ */
+static inline int snd_pcm_direct_robust_lock(snd_pcm_direct_robust_t *lock)
+{
+	int err = pthread_mutex_lock(&lock->mutex);
+
+	if (err == EOWNERDEAD)
+		err = pthread_mutex_consistent(&lock->mutex);
+	return -err;
+}
+
+/* returns -EBUSY when the lock is held by a live thread */
+static inline int snd_pcm_direct_robust_trylock(snd_pcm_direct_robust_t *lock)
+{
+	int err = pthread_mutex_trylock(&lock->mutex);
+
+	if (err == EOWNERDEAD)
+		err = pthread_mutex_consistent(&lock->mutex);
+	return -err;
+}
+
+static inline int snd_pcm_direct_robust_unlock(snd_pcm_direct_robust_t *lock)
+{
+	return -pthread_mutex_unlock(&lock->mutex);
+}
+#endif
+
+/*
+ * serialize the access to the shared slave buffer among the clients;
+ * the open and close paths keep using the semaphore directly,
+ * since the shared memory doesn't exist yet or anymore there
+ */
+static inline int snd_pcm_direct_lock(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	if (dmix->shmptr->ipc_lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX)
+		return snd_pcm_direct_robust_lock(&dmix->shmptr->lock);
+#endif
+	return snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
+static inline int snd_pcm_direct_unlock(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	if (dmix->shmptr->ipc_lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX)
+		return snd_pcm_direct_robust_unlock(&dmix->shmptr->lock);
+#endif
+	return snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
 int snd_pcm_direct_shm_create_or_connect(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix);
@@ -335,6 +490,7 @@ int snd_pcm_direct_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * info);
 int snd_pcm_direct_mmap(snd_pcm_t *pcm);
 int snd_pcm_direct_munmap(snd_pcm_t *pcm);
 int snd_pcm_direct_prepare(snd_pcm_t *pcm);
+void snd_pcm_direct_setup_zero_copy(snd_pcm_t *pcm, snd_pcm_direct_t *direct);
 int snd_pcm_direct_resume(snd_pcm_t *pcm);
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix);
@@ -349,6 +505,36 @@ int snd_pcm_direct_client_chk_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm);
 int snd_timer_async(snd_timer_t *timer, int sig, pid_t pid);
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm);
 void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix);
+void snd_pcm_direct_stats_attach(snd_pcm_direct_t *direct);
+void snd_pcm_direct_stats_detach(snd_pcm_direct_t *direct);
+void snd_pcm_direct_stats_dump(snd_pcm_direct_t *direct, snd_output_t *out);
+
+static inline unsigned long long snd_pcm_direct_stats_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* account one mix operation of the given duration */
+static inline void snd_pcm_direct_stats_mix(snd_pcm_direct_t *direct,
+					    snd_pcm_uframes_t frames,
+					    unsigned long long ns)
+{
+	snd_pcm_direct_stats_t *stats = direct->stats;
+	unsigned long long us = ns / 1000;
+	unsigned int bucket = 0;
+
+	while (us && bucket < DIRECT_STATS_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	stats->commits++;
+	stats->frames += frames;
+	stats->mix_ns += ns;
+	stats->mix_hist[bucket]++;
+}
 
 struct snd_pcm_direct_open_conf {
 	key_t ipc_key;
@@ -360,6 +546,13 @@ struct snd_pcm_direct_open_conf {
 	int direct_memory_access;
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;
+	unsigned int staging_clients;
+	int float_sum;
+	unsigned int mix_batch;
+	int zero_copy;
+	int adaptive_wakeup;
+	int stats;
+	snd_pcm_direct_ipc_lock_t ipc_lock;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
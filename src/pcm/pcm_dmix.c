@@ -127,9 +127,211 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 	return ret;
 }
 
+/*
+ *  staging mode: each client converts its samples to a private ring in
+ *  a shared segment and one client at a time sums all rings to the slave
+ *  buffer; no semaphore nor atomic per-sample operations are required
+ *
+ *  The reduction is idempotent (the slave samples are always recomputed
+ *  from all rings), so a region may be reduced again at any time.
+ *  Each client holds the semaphore of its slot with SEM_UNDO, and the
+ *  reducer holds a robust mutex; the kernel releases both when the client
+ *  dies, so neither pids nor heartbeats decide whether a client is alive.
+ *  A ring sample contributes only when it is before the written position
+ *  of its client, hence stale data from the previous buffer cycle is
+ *  never summed.
+ */
+
+#define STAGE_CHUNK	256	/* frames reduced at once */
+
+static int shm_stage_discard(snd_pcm_direct_t *dmix);
+
+static inline signed int *stage_ring(snd_pcm_dmix_stage_t *stage, int idx)
+{
+	return (signed int *)&stage->slot[stage->clients] +
+		(size_t)idx * stage->frames * stage->channels;
+}
+
+/* takes the slot when its semaphore is zero, i.e. no live owner */
+static int stage_slot_claim(snd_pcm_direct_t *dmix, int idx)
+{
+	struct sembuf op[2] = { { idx, 0, IPC_NOWAIT }, { idx, 1, SEM_UNDO } };
+
+	if (semop(dmix->u.dmix.semid_stage, op, 2) < 0)
+		return -errno;
+	return 0;
+}
+
+static void stage_slot_release(snd_pcm_direct_t *dmix, int idx)
+{
+	struct sembuf op = { idx, -1, SEM_UNDO | IPC_NOWAIT };
+
+	semop(dmix->u.dmix.semid_stage, &op, 1);
+}
+
+static int stage_sem_create_or_connect(snd_pcm_direct_t *dmix,
+				       unsigned int clients)
+{
+	struct semid_ds buf;
+	union {
+		int val;
+		struct semid_ds *buf;
+	} s;
+
+	dmix->u.dmix.semid_stage = semget(dmix->ipc_key + 2, clients,
+					  IPC_CREAT | dmix->ipc_perm);
+	if (dmix->u.dmix.semid_stage < 0)
+		return -errno;
+	if (dmix->ipc_gid >= 0) {
+		s.buf = &buf;
+		if (semctl(dmix->u.dmix.semid_stage, 0, IPC_STAT, s) == 0) {
+			buf.sem_perm.gid = dmix->ipc_gid;
+			semctl(dmix->u.dmix.semid_stage, 0, IPC_SET, s);
+		}
+	}
+	return 0;
+}
+
+static int shm_stage_create_or_connect(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage;
+	struct shmid_ds buf;
+	unsigned int clients = dmix->shmptr->u.dmix.staging_clients;
+	unsigned int frames = dmix->shmptr->s.buffer_size;
+	unsigned int channels = dmix->shmptr->s.channels;
+	size_t size, ring_size;
+	int tmpid, idx, err;
+
+#ifndef DIRECT_HAVE_ROBUST_LOCK
+	SNDERR("dmix staging mode is not supported on this system");
+	return -ENOSYS;
+#endif
+	err = stage_sem_create_or_connect(dmix, clients);
+	if (err < 0) {
+		SNDERR("unable to get the dmix staging semaphores");
+		return err;
+	}
+
+	ring_size = (size_t)frames * channels * sizeof(signed int);
+	size = sizeof(*stage) + clients * sizeof(stage->slot[0]) +
+	       clients * ring_size;
+retryshm:
+	dmix->u.dmix.shmid_stage = shmget(dmix->ipc_key + 2, size,
+					  IPC_CREAT | dmix->ipc_perm);
+	err = -errno;
+	if (dmix->u.dmix.shmid_stage < 0) {
+		if (errno == EINVAL)
+		if ((tmpid = shmget(dmix->ipc_key + 2, 0, dmix->ipc_perm)) != -1)
+		if (!shmctl(tmpid, IPC_STAT, &buf))
+		if (!buf.shm_nattch)
+		/* no users so destroy the segment */
+		if (!shmctl(tmpid, IPC_RMID, NULL))
+			goto retryshm;
+		return err;
+	}
+	if (shmctl(dmix->u.dmix.shmid_stage, IPC_STAT, &buf) < 0) {
+		err = -errno;
+		shm_stage_discard(dmix);
+		return err;
+	}
+	if (dmix->ipc_gid >= 0) {
+		buf.shm_perm.gid = dmix->ipc_gid;
+		shmctl(dmix->u.dmix.shmid_stage, IPC_SET, &buf);
+	}
+	stage = shmat(dmix->u.dmix.shmid_stage, 0, 0);
+	if (stage == (void *) -1) {
+		err = -errno;
+		shm_stage_discard(dmix);
+		return err;
+	}
+	dmix->u.dmix.stage = stage;
+	mlock(stage, size);
+	/* we are called with the client semaphore held */
+	if (buf.shm_nattch == 0 || stage->frames != frames ||
+	    stage->channels != channels || stage->clients != clients) {
+		memset(stage, 0, size);
+		stage->clients = clients;
+		stage->frames = frames;
+		stage->channels = channels;
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+		err = snd_pcm_direct_robust_init(&stage->reducer);
+		if (err < 0) {
+			shm_stage_discard(dmix);
+			return err;
+		}
+#endif
+		stage->lock_abi = sizeof(long);
+	}
+	if (stage->lock_abi != sizeof(long)) {
+		SNDERR("dmix staging area is shared with clients of another ABI");
+		shm_stage_discard(dmix);
+		return -EINVAL;
+	}
+	for (idx = 0; idx < (int)clients; idx++) {
+		err = stage_slot_claim(dmix, idx);
+		if (err != -EAGAIN)
+			break;
+	}
+	if (err < 0) {
+		if (err == -EAGAIN)
+			SNDERR("no free dmix staging slot (staging_clients %u)", clients);
+		shm_stage_discard(dmix);
+		return err == -EAGAIN ? -EBUSY : err;
+	}
+	memset(stage_ring(stage, idx), 0, ring_size);
+	dmix->u.dmix.stage_slot = idx;
+	dmix->u.dmix.stage_acc = malloc(STAGE_CHUNK * channels * sizeof(signed int));
+	dmix->u.dmix.stage_written = malloc(clients * sizeof(unsigned long long));
+	if (!dmix->u.dmix.stage_acc || !dmix->u.dmix.stage_written) {
+		shm_stage_discard(dmix);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int shm_stage_discard(snd_pcm_direct_t *dmix)
+{
+	struct shmid_ds buf;
+	int ret = 0;
+
+	free(dmix->u.dmix.stage_acc);
+	dmix->u.dmix.stage_acc = NULL;
+	free(dmix->u.dmix.stage_written);
+	dmix->u.dmix.stage_written = NULL;
+	if (dmix->u.dmix.stage_slot >= 0)
+		stage_slot_release(dmix, dmix->u.dmix.stage_slot);
+	dmix->u.dmix.stage_slot = -1;
+	if (dmix->u.dmix.shmid_stage < 0)
+		goto _sem;
+	if (dmix->u.dmix.stage) {
+		if (shmdt(dmix->u.dmix.stage) < 0)
+			return -errno;
+	}
+	dmix->u.dmix.stage = NULL;
+	if (shmctl(dmix->u.dmix.shmid_stage, IPC_STAT, &buf) < 0)
+		return -errno;
+	if (buf.shm_nattch == 0) {	/* we're the last user, destroy the segment */
+		if (shmctl(dmix->u.dmix.shmid_stage, IPC_RMID, NULL) < 0)
+			return -errno;
+		if (dmix->u.dmix.semid_stage >= 0)
+			semctl(dmix->u.dmix.semid_stage, 0, IPC_RMID);
+		dmix->u.dmix.semid_stage = -1;
+		ret = 1;
+	}
+	dmix->u.dmix.shmid_stage = -1;
+ _sem:
+	dmix->u.dmix.semid_stage = -1;
+	return ret;
+}
+
 static void dmix_server_free(snd_pcm_direct_t *dmix)
 {
 	/* remove the memory region */
+	if (dmix->shmptr->u.dmix.staging_clients) {
+		if (shm_stage_create_or_connect(dmix) >= 0)
+			shm_stage_discard(dmix);
+		return;
+	}
 	shm_sum_create_or_connect(dmix);
 	shm_sum_discard(dmix);
 }
@@ -140,6 +342,8 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
  */
 
 #include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
+#include "pcm_dmix_float.c"
 #if defined(__i386__)
 #include "pcm_dmix_i386.c"
 #elif defined(__x86_64__)
@@ -159,7 +363,7 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		      snd_pcm_uframes_t size)
 {
 	unsigned int src_step, dst_step;
-	unsigned int chn, dchn, channels, sample_size;
+	unsigned int chn, dchn, channels, sample_size, src_size;
 	mix_areas_t *do_mix_areas;
 	
 	channels = dmix->channels;
@@ -189,6 +393,11 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 	default:
 		return;
 	}
+	src_size = sample_size;
+	if (dmix->u.dmix.float_mix) {
+		do_mix_areas = dmix->u.dmix.float_mix;
+		src_size = dmix->u.dmix.float_src_size;
+	}
 	if (dmix->interleaved) {
 		/*
 		 * process all areas in one loop
@@ -196,10 +405,10 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		 */
 		do_mix_areas(size * channels,
 			     (unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
-			     (unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
+			     (unsigned char *)src_areas[0].addr + src_size * src_ofs * channels,
 			     dmix->u.dmix.sum_buffer + dst_ofs * channels,
 			     sample_size,
-			     sample_size,
+			     src_size,
 			     sizeof(signed int));
 		return;
 	}
@@ -227,7 +436,7 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 			snd_pcm_uframes_t size)
 {
 	unsigned int src_step, dst_step;
-	unsigned int chn, dchn, channels, sample_size;
+	unsigned int chn, dchn, channels, sample_size, src_size;
 	mix_areas_t *do_remix_areas;
 	
 	channels = dmix->channels;
@@ -257,6 +466,11 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 	default:
 		return;
 	}
+	src_size = sample_size;
+	if (dmix->u.dmix.float_remix) {
+		do_remix_areas = dmix->u.dmix.float_remix;
+		src_size = dmix->u.dmix.float_src_size;
+	}
 	if (dmix->interleaved) {
 		/*
 		 * process all areas in one loop
@@ -264,10 +478,10 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 		 */
 		do_remix_areas(size * channels,
 			       (unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
-			       (unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
+			       (unsigned char *)src_areas[0].addr + src_size * src_ofs * channels,
 			       dmix->u.dmix.sum_buffer + dst_ofs * channels,
 			       sample_size,
-			       sample_size,
+			       src_size,
 			       sizeof(signed int));
 		return;
 	}
@@ -287,6 +501,258 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 	}
 }
 
+/*
+ *  staging mode: convert the client samples to the sum representation
+ */
+static void stage_areas(snd_pcm_direct_t *dmix,
+			const snd_pcm_channel_area_t *src_areas,
+			snd_pcm_uframes_t src_ofs,
+			snd_pcm_uframes_t dst_ofs,
+			snd_pcm_uframes_t size)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	unsigned int chn, dchn, channels = stage->channels;
+	snd_pcm_format_t format = dmix->shmptr->s.format;
+	int swap = !snd_pcm_format_cpu_endian(format);
+	signed int *ring = stage_ring(stage, dmix->u.dmix.stage_slot);
+	snd_pcm_uframes_t i;
+
+	for (chn = 0; chn < dmix->channels; chn++) {
+		const unsigned char *src;
+		unsigned int src_step;
+		signed int *dst;
+
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= channels)
+			continue;
+		src_step = src_areas[chn].step / 8;
+		src = (const unsigned char *)src_areas[chn].addr +
+			src_areas[chn].first / 8 + src_ofs * src_step;
+		dst = ring + dst_ofs * channels + dchn;
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S16_BE:
+			for (i = 0; i < size; i++, src += src_step, dst += channels)
+				*dst = swap ? (signed short)bswap_16(*(const signed short *)src) :
+					      *(const signed short *)src;
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+		case SND_PCM_FORMAT_S32_BE:
+			for (i = 0; i < size; i++, src += src_step, dst += channels)
+				*dst = (swap ? (signed int)bswap_32(*(const signed int *)src) :
+					       *(const signed int *)src) >> 8;
+			break;
+		case SND_PCM_FORMAT_S24_LE:
+		case SND_PCM_FORMAT_S24_3LE:
+			for (i = 0; i < size; i++, src += src_step, dst += channels)
+				*dst = src[0] | (src[1] << 8) |
+				       (((const signed char *)src)[2] << 16);
+			break;
+		case SND_PCM_FORMAT_U8:
+			for (i = 0; i < size; i++, src += src_step, dst += channels)
+				*dst = *src - 0x80;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/*
+ *  staging mode: write the saturated sums to the slave buffer
+ */
+static void stage_store(snd_pcm_direct_t *dmix, const signed int *acc,
+			snd_pcm_uframes_t dst_ofs, snd_pcm_uframes_t size)
+{
+	const snd_pcm_channel_area_t *dst_areas = snd_pcm_mmap_areas(dmix->spcm);
+	unsigned int chn, channels = dmix->shmptr->s.channels;
+	snd_pcm_format_t format = dmix->shmptr->s.format;
+	int swap = !snd_pcm_format_cpu_endian(format);
+	snd_pcm_uframes_t i;
+
+	for (chn = 0; chn < channels; chn++) {
+		unsigned int dst_step = dst_areas[chn].step / 8;
+		unsigned char *dst = (unsigned char *)dst_areas[chn].addr +
+			dst_areas[chn].first / 8 + dst_ofs * dst_step;
+		const signed int *sum = acc + chn;
+		signed int sample;
+
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S16_BE:
+			for (i = 0; i < size; i++, dst += dst_step, sum += channels) {
+				sample = *sum;
+				if (sample > 0x7fff)
+					sample = 0x7fff;
+				else if (sample < -0x8000)
+					sample = -0x8000;
+				*(signed short *)dst = swap ? (signed short)bswap_16(sample) : sample;
+			}
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+		case SND_PCM_FORMAT_S32_BE:
+			for (i = 0; i < size; i++, dst += dst_step, sum += channels) {
+				sample = *sum;
+				if (sample > 0x7fffff)
+					sample = 0x7fffffff;
+				else if (sample < -0x800000)
+					sample = -0x80000000;
+				else
+					sample *= 256;
+				*(signed int *)dst = swap ? (signed int)bswap_32(sample) : sample;
+			}
+			break;
+		case SND_PCM_FORMAT_S24_LE:
+		case SND_PCM_FORMAT_S24_3LE:
+			for (i = 0; i < size; i++, dst += dst_step, sum += channels) {
+				sample = *sum;
+				if (sample > 0x7fffff)
+					sample = 0x7fffff;
+				else if (sample < -0x800000)
+					sample = -0x800000;
+				dst[0] = sample;
+				dst[1] = sample >> 8;
+				dst[2] = sample >> 16;
+			}
+			break;
+		case SND_PCM_FORMAT_U8:
+			for (i = 0; i < size; i++, dst += dst_step, sum += channels) {
+				sample = *sum;
+				if (sample > 0x7f)
+					sample = 0x7f;
+				else if (sample < -0x80)
+					sample = -0x80;
+				*dst = sample + 0x80;
+			}
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/* distance of the slave position from hw, the positions behind are negative */
+static snd_pcm_sframes_t stage_dist(snd_pcm_direct_t *dmix,
+				    snd_pcm_uframes_t pos,
+				    snd_pcm_uframes_t hw)
+{
+	snd_pcm_uframes_t diff = pcm_frame_diff(pos, hw, dmix->slave_boundary);
+
+	if (diff > dmix->slave_boundary / 2)
+		return (snd_pcm_sframes_t)diff - (snd_pcm_sframes_t)dmix->slave_boundary;
+	return diff;
+}
+
+/*
+ *  staging mode: recompute the slave samples changed since the last
+ *  reduction, only the reducer calls this
+ */
+static void stage_reduce(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	unsigned long long *written = dmix->u.dmix.stage_written;
+	signed int *acc = dmix->u.dmix.stage_acc;
+	unsigned int idx, channels = stage->channels;
+	snd_pcm_uframes_t hw, buffer_size = dmix->slave_buffer_size;
+	snd_pcm_sframes_t limit, lo, hi, a, b, ofs, wdist;
+	snd_pcm_uframes_t pos, size, k, n;
+
+	hw = *dmix->spcm->hw.ptr;
+	/* don't touch the active period, like snd_pcm_dmix_sync_area() */
+	limit = buffer_size - hw % dmix->slave_period_size;
+	lo = limit;
+	hi = 0;
+	for (idx = 0; idx < stage->clients; idx++) {
+		written[idx] = __atomic_load_n(&stage->slot[idx].written, __ATOMIC_ACQUIRE);
+		if (written[idx] == stage->slot[idx].reduced)
+			continue;
+		a = stage_dist(dmix, written[idx], hw);
+		b = stage_dist(dmix, stage->slot[idx].reduced, hw);
+		if (a > b) {
+			ofs = a; a = b; b = ofs;
+		}
+		if (a < lo)
+			lo = a;
+		if (b > hi)
+			hi = b;
+	}
+	if (lo < 0)
+		lo = 0;
+	if (hi > limit)
+		hi = limit;
+	for (ofs = lo; ofs < hi; ofs += size) {
+		pos = (hw + ofs) % buffer_size;
+		size = hi - ofs;
+		if (size > STAGE_CHUNK)
+			size = STAGE_CHUNK;
+		if (pos + size > buffer_size)
+			size = buffer_size - pos;
+		memset(acc, 0, size * channels * sizeof(*acc));
+		for (idx = 0; idx < stage->clients; idx++) {
+			const signed int *ring;
+
+			wdist = stage_dist(dmix, written[idx], hw);
+			if (wdist <= ofs)
+				continue;
+			n = wdist - ofs;
+			if (n > size)
+				n = size;
+			n *= channels;
+			ring = stage_ring(stage, idx) + pos * channels;
+			for (k = 0; k < n; k++)
+				acc[k] += ring[k];
+		}
+		stage_store(dmix, acc, pos, size);
+	}
+	for (idx = 0; idx < stage->clients; idx++)
+		stage->slot[idx].reduced = written[idx];
+}
+
+/*
+ *  staging mode: publish the staged data and reduce it, unless another
+ *  client is just reducing - it will pick our data, too
+ */
+static void stage_commit(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+
+	__atomic_store_n(&stage->slot[dmix->u.dmix.stage_slot].written,
+			 (unsigned long long)dmix->slave_appl_ptr, __ATOMIC_RELEASE);
+	__atomic_store_n(&stage->pending, 1, __ATOMIC_SEQ_CST);
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	while (__atomic_load_n(&stage->pending, __ATOMIC_SEQ_CST)) {
+		/* a dead reducer is taken over, the reduction is idempotent */
+		if (snd_pcm_direct_robust_trylock(&stage->reducer) < 0)
+			break;
+		while (__atomic_exchange_n(&stage->pending, 0, __ATOMIC_SEQ_CST))
+			stage_reduce(dmix);
+		snd_pcm_direct_robust_unlock(&stage->reducer);
+	}
+#endif
+}
+
+/*
+ *  staging mode: drop the staged frames after the current slave_appl_ptr
+ */
+static void stage_rewind(snd_pcm_direct_t *dmix, snd_pcm_uframes_t size)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	signed int *ring = stage_ring(stage, dmix->u.dmix.stage_slot);
+	snd_pcm_uframes_t pos, transfer;
+
+	pos = dmix->slave_appl_ptr % dmix->slave_buffer_size;
+	while (size > 0) {
+		transfer = size;
+		if (pos + transfer > dmix->slave_buffer_size)
+			transfer = dmix->slave_buffer_size - pos;
+		memset(ring + pos * stage->channels, 0,
+		       transfer * stage->channels * sizeof(*ring));
+		size -= transfer;
+		pos = 0;
+	}
+	stage_commit(dmix);
+}
+
 /*
  * if no concurrent access is allowed in the mixing routines, we need to protect
  * the area via semaphore
@@ -295,13 +761,13 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 static void dmix_down_sem(snd_pcm_direct_t *dmix)
 {
 	if (dmix->u.dmix.use_sem)
-		snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+		snd_pcm_direct_lock(dmix);
 }
 
 static void dmix_up_sem(snd_pcm_direct_t *dmix)
 {
 	if (dmix->u.dmix.use_sem)
-		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+		snd_pcm_direct_unlock(dmix);
 }
 #endif
 
@@ -312,8 +778,9 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
-	snd_pcm_uframes_t appl_ptr, size, transfer;
+	snd_pcm_uframes_t appl_ptr, size, transfer, mixed;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
+	unsigned long long t0 = 0, t1 = 0;
 	
 	/* calculate the size to transfer */
 	/* check the available size in the local buffer
@@ -363,14 +830,22 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix->slave_appl_ptr += size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
+	mixed = size;
+	if (dmix->stats)
+		t0 = snd_pcm_direct_stats_ns();
 	dmix_down_sem(dmix);
+	if (dmix->stats)
+		t1 = snd_pcm_direct_stats_ns();
 	for (;;) {
 		transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.stage)
+			stage_areas(dmix, src_areas, appl_ptr, slave_appl_ptr, transfer);
+		else
+			mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
@@ -379,7 +854,35 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 		appl_ptr += transfer;
 		appl_ptr %= pcm->buffer_size;
 	}
+	if (dmix->stats) {
+		dmix->stats->lock_wait_ns += t1 - t0;
+		snd_pcm_direct_stats_mix(dmix, mixed,
+					 snd_pcm_direct_stats_ns() - t1);
+	}
 	dmix_up_sem(dmix);
+	if (dmix->u.dmix.stage)
+		stage_commit(dmix);
+}
+
+/*
+ *  batch mode: leave small commits unmixed until enough frames are
+ *  pending, unless the already mixed frames are about to run out
+ */
+static int snd_pcm_dmix_defer_mix(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_uframes_t pending, queued;
+
+	if (!dmix->u.dmix.mix_batch || dmix->state != SND_PCM_STATE_RUNNING)
+		return 0;
+	pending = pcm_frame_diff2(dmix->appl_ptr, dmix->last_appl_ptr, pcm->boundary);
+	if (pending >= dmix->u.dmix.mix_batch || pending >= pcm->period_size)
+		return 0;
+	/* the active period is not writable, keep one more period ahead
+	 * to survive until the next wakeup
+	 */
+	queued = pcm_frame_diff(dmix->slave_appl_ptr, dmix->slave_hw_ptr, dmix->slave_boundary);
+	return queued >= 2 * dmix->slave_period_size + pending;
 }
 
 /*
@@ -558,6 +1061,8 @@ static int snd_pcm_dmix_reset(snd_pcm_t *pcm)
 	dmix->appl_ptr = dmix->last_appl_ptr = dmix->hw_ptr;
 	dmix->slave_appl_ptr = dmix->slave_hw_ptr = *dmix->spcm->hw.ptr;
 	snd_pcm_direct_reset_slave_ptr(pcm, dmix);
+	if (dmix->u.dmix.stage)
+		stage_commit(dmix);
 	return 0;
 }
 
@@ -568,6 +1073,8 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 	snd_pcm_hwsync(dmix->spcm);
 	dmix->slave_appl_ptr = dmix->slave_hw_ptr = *dmix->spcm->hw.ptr;
 	snd_pcm_direct_reset_slave_ptr(pcm, dmix);
+	if (dmix->u.dmix.stage)
+		stage_commit(dmix);
 	err = snd_timer_start(dmix->timer);
 	if (err < 0)
 		return err;
@@ -749,6 +1256,10 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	dmix->slave_appl_ptr -= size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
+	if (dmix->u.dmix.stage) {
+		stage_rewind(dmix, size);
+		goto remixed;
+	}
 	dmix_down_sem(dmix);
 	for (;;) {
 		transfer = size;
@@ -767,6 +1278,7 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	}
 	dmix_up_sem(dmix);
 
+ remixed:
 	snd_pcm_mmap_appl_backward(pcm, frames_to_remix);
 	result += frames_to_remix;
 	/* At this point last_appl_ptr and appl_ptr has to indicate the
@@ -809,12 +1321,21 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
 	if (dmix->timer)
 		snd_timer_close(dmix->timer);
 	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+	if (dmix->u.dmix.stage) {
+		/* remove our not yet played contribution */
+		dmix->slave_appl_ptr = *dmix->spcm->hw.ptr;
+		stage_commit(dmix);
+	}
 	snd_pcm_close(dmix->spcm);
+	snd_pcm_direct_stats_detach(dmix);
  	if (dmix->server)
  		snd_pcm_direct_server_discard(dmix);
  	if (dmix->client)
  		snd_pcm_direct_client_discard(dmix);
- 	shm_sum_discard(dmix);
+	if (dmix->u.dmix.stage)
+		shm_stage_discard(dmix);
+	else
+		shm_sum_discard(dmix);
 	if (snd_pcm_direct_shm_discard(dmix)) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
@@ -860,7 +1381,8 @@ static snd_pcm_sframes_t snd_pcm_dmix_mmap_commit(snd_pcm_t *pcm,
 	    dmix->state == SND_PCM_STATE_DRAINING) {
 		/* ok, we commit the changes after the validation of area */
 		/* it's intended, although the result might be crappy */
-		snd_pcm_dmix_sync_area(pcm);
+		if (!snd_pcm_dmix_defer_mix(pcm))
+			snd_pcm_dmix_sync_area(pcm);
 		/* clear timer queue to avoid a bogus return from poll */
 		if (snd_pcm_mmap_playback_avail(pcm) < pcm->avail_min)
 			snd_pcm_direct_clear_timer_queue(dmix);
@@ -909,6 +1431,7 @@ static int snd_pcm_dmix_htimestamp(snd_pcm_t *pcm,
 static int snd_pcm_dmix_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
+	/* always mix the deferred frames, the client may sleep after this */
 	if (dmix->state == SND_PCM_STATE_RUNNING)
 		snd_pcm_dmix_sync_area(pcm);
 	return snd_pcm_direct_poll_revents(pcm, pfds, nfds, revents);
@@ -920,6 +1443,17 @@ static void snd_pcm_dmix_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_direct_t *dmix = pcm->private_data;
 
 	snd_output_printf(out, "Direct Stream Mixing PCM\n");
+	if (dmix->u.dmix.stage)
+		snd_output_printf(out, "Staging mode, slot %d of %u\n",
+				  dmix->u.dmix.stage_slot,
+				  dmix->u.dmix.stage->clients);
+	if (dmix->shmptr->u.dmix.float_sum)
+		snd_output_printf(out, "Float sum buffer\n");
+	if (dmix->u.dmix.mix_batch)
+		snd_output_printf(out, "Mix batch: %u frames\n",
+				  dmix->u.dmix.mix_batch);
+	if (dmix->stats)
+		snd_pcm_direct_stats_dump(dmix, out);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -928,11 +1462,28 @@ static void snd_pcm_dmix_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_pcm_dump(dmix->spcm, out);
 }
 
+static int snd_pcm_dmix_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_format_t format;
+	int err;
+
+	if (dmix->shmptr->u.dmix.float_sum) {
+		err = INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
+		if (err < 0)
+			return err;
+		dmix->u.dmix.float_mix = float_mix_select(dmix, format, 0);
+		dmix->u.dmix.float_remix = float_mix_select(dmix, format, 1);
+		dmix->u.dmix.float_src_size = snd_pcm_format_physical_width(format) / 8;
+	}
+	return snd_pcm_direct_hw_params(pcm, params);
+}
+
 static const snd_pcm_ops_t snd_pcm_dmix_ops = {
 	.close = snd_pcm_dmix_close,
 	.info = snd_pcm_direct_info,
 	.hw_refine = snd_pcm_direct_hw_refine,
-	.hw_params = snd_pcm_direct_hw_params,
+	.hw_params = snd_pcm_dmix_hw_params,
 	.hw_free = snd_pcm_direct_hw_free,
 	.sw_params = snd_pcm_direct_sw_params,
 	.channel_info = snd_pcm_direct_channel_info,
@@ -1024,8 +1575,14 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	dmix->ipc_perm = opts->ipc_perm;
 	dmix->ipc_gid = opts->ipc_gid;
 	dmix->tstamp_type = opts->tstamp_type;
+	dmix->ipc_lock = opts->ipc_lock;
+	dmix->u.dmix.mix_batch = opts->mix_batch;
 	dmix->semid = -1;
 	dmix->shmid = -1;
+	dmix->u.dmix.shmid_sum = -1;
+	dmix->u.dmix.shmid_stage = -1;
+	dmix->u.dmix.semid_stage = -1;
+	dmix->u.dmix.stage_slot = -1;
 
 	ret = snd_pcm_new(&pcm, dmix->type = SND_PCM_TYPE_DMIX, name, stream, mode);
 	if (ret < 0)
@@ -1059,6 +1616,7 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	pcm->private_data = dmix;
 	dmix->state = SND_PCM_STATE_OPEN;
 	dmix->slowptr = opts->slowptr;
+	dmix->adaptive_wakeup = opts->adaptive_wakeup;
 	dmix->max_periods = opts->max_periods;
 	dmix->var_periodsize = opts->var_periodsize;
 	dmix->hw_ptr_alignment = opts->hw_ptr_alignment;
@@ -1101,6 +1659,13 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		}
 
 		dmix->shmptr->type = spcm->type;
+		dmix->shmptr->u.dmix.staging_clients = opts->staging_clients;
+		if (opts->float_sum &&
+		    !(float_dmix_supported_format & (1ULL << dmix->shmptr->s.format)))
+			SNDERR("float sum buffer is not supported for slave format %s",
+			       snd_pcm_format_name(dmix->shmptr->s.format));
+		else
+			dmix->shmptr->u.dmix.float_sum = opts->float_sum;
 	} else {
 		if (dmix->shmptr->use_server) {
 			/* up semaphore to avoid deadlock */
@@ -1148,10 +1713,18 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		dmix->spcm = spcm;
 	}
 
-	ret = shm_sum_create_or_connect(dmix);
-	if (ret < 0) {
-		SNDERR("unable to initialize sum ring buffer");
-		goto _err;
+	if (dmix->shmptr->u.dmix.staging_clients) {
+		ret = shm_stage_create_or_connect(dmix);
+		if (ret < 0) {
+			SNDERR("unable to initialize staging area");
+			goto _err;
+		}
+	} else {
+		ret = shm_sum_create_or_connect(dmix);
+		if (ret < 0) {
+			SNDERR("unable to initialize sum ring buffer");
+			goto _err;
+		}
 	}
 
 	ret = snd_pcm_direct_initialize_poll_fd(dmix);
@@ -1161,6 +1734,10 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	}
 
 	mix_select_callbacks(dmix);
+	if (dmix->u.dmix.stage)
+		dmix->u.dmix.use_sem = 0;
+	else if (dmix->shmptr->u.dmix.float_sum)
+		dmix->u.dmix.use_sem = 1;	/* no lock-free float code */
 		
 	pcm->poll_fd = dmix->poll_fd;
 	pcm->poll_events = POLLIN;	/* it's different than other plugins */
@@ -1172,6 +1749,9 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	if (dmix->channels == UINT_MAX)
 		dmix->channels = dmix->shmptr->s.channels;
 
+	if (opts->stats)
+		snd_pcm_direct_stats_attach(dmix);
+
 	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 
 	*pcmp = pcm;
@@ -1188,6 +1768,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_close(spcm);
 	if (dmix->u.dmix.shmid_sum >= 0)
 		shm_sum_discard(dmix);
+	if (dmix->u.dmix.shmid_stage >= 0)
+		shm_stage_discard(dmix);
 	if ((dmix->shmid >= 0) && (snd_pcm_direct_shm_discard(dmix))) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
@@ -1217,6 +1799,10 @@ pcm.name {
 	ipc_key INT		# unique IPC key
 	ipc_key_add_uid BOOL	# add current uid to unique IPC key
 	ipc_perm INT		# IPC permissions (octal, default 0600)
+	ipc_lock STR		# lock serializing the clients
+				# STR can be one of the below strings :
+				# sem (default)
+				# futex
 	hw_ptr_alignment STR	# Slave application and hw pointer alignment type
 				# STR can be one of the below strings :
 				# no
@@ -1247,6 +1833,19 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	adaptive_wakeup BOOL	# timer wakeups follow avail_min
+	mix_mode STR		# mixing mode
+				# STR can be one of the below strings :
+				# sum (default)
+				# staging
+	staging_clients INT	# max. number of clients in the staging mode
+				# (default 16)
+	sum_format STR		# sum buffer format
+				# STR can be one of the below strings :
+				# int (default)
+				# float
+	mix_batch INT		# min. frames to mix at once (default 0 = off)
+	stats BOOL		# record the client statistics
 }
 \endcode
 
@@ -1258,6 +1857,23 @@ added to the value set in <code>ipc_key</code>.  This will
 avoid the confliction of the same IPC key with different users
 concurrently.
 
+<code>ipc_lock</code> selects the lock which serializes the mixing of
+the clients in the semaphore protected code.  The default "sem" uses a
+SysV semaphore, so every commit costs two semop() system calls.
+With "futex", the lock is a robust process shared mutex in the shared
+memory area and the kernel is entered only when two clients really
+collide.  If a client dies while holding the lock, the kernel marks it
+and the next client takes it over.  The lock type is taken from the
+first client which opens the device and falls back to the semaphore when
+the mutex cannot be set up; all the clients must then be built for the
+same ABI (32 or 64 bit).
+
+<code>adaptive_wakeup</code> lets the slave timer wake the client every
+N slave periods instead of every period, N being derived from the
+avail_min software parameter (and limited so that the buffer cannot
+run out between two wakeups).  This saves context switches for clients
+with a large avail_min.
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
@@ -1339,6 +1955,53 @@ Also, note that ICE1712 have the limited buffer size, 5513 frames
 (corresponding to 640 kB).  In this case, reduce the buffer_size
 to 4096.
 
+<code>mix_mode</code> selects how the clients share the slave buffer.
+In the default "sum" mode, every client adds its samples to a shared
+sum buffer and writes the saturated result to the slave buffer, either
+under a semaphore or with atomic operations per sample.
+In the "staging" mode, every client converts its samples to a private
+ring in shared memory and one client at a time (whichever commits
+while no other reduction is running) sums all rings to the slave buffer.
+The clients don't wait for each other and no semaphore operation is
+done while streaming, which scales better with many clients.
+The number of clients is limited by <code>staging_clients</code>; the
+slot of a client which died is freed by the kernel (SEM_UNDO).
+The mode is taken from the first client which opens the device and all
+the clients must be built for the same ABI (32 or 64 bit).
+
+<code>sum_format</code> "float" keeps the sums as floats (full scale
+is 1.0) instead of integers.  Besides the slave format, the clients may
+then use the native endian FLOAT format directly, without the plug and
+lfloat conversion.  Their samples are clipped to full scale and NaNs are
+muted, like for the integer clients, but the sums are not clipped and no
+precision is lost until the final conversion to the slave format.
+It is supported for the native endian S16 and S32 slave formats in the
+"sum" mix_mode and it is always semaphore protected.  Like the mix mode,
+it is taken from the first client which opens the device.
+
+<code>mix_batch</code> lets a client which commits many small chunks
+mix them in larger blocks: the committed frames are left unmixed until
+at least <code>mix_batch</code> frames (or one client period) are
+pending, which saves the lock operations and the ring wrap handling per
+chunk.  The frames are mixed anyway as soon as less than two slave
+periods of already mixed data remain, on drain and on the poll wakeups.
+A quarter of the period size is a good start; the value only delays
+the mixing, the reported delay and avail are not affected.  It is a
+per-client setting.
+
+<code>stats</code> makes the client record its commit and frame counts,
+the time spent mixing (total and a histogram), the time spent waiting
+for the mixing lock and the number of xruns in a slot of the shared
+memory area (at most 16 clients).  snd_pcm_dump() on any client with
+statistics enabled prints the slots of all clients of the device, so
+a glitch can be attributed to a specific process.
+
+The semaphore protected mixing code (used on all architectures without
+the lock-free assembler routines, or when <code>direct_memory_access</code>
+is set to false) runs the native endian 16-bit and 32-bit formats through
+SSE2/AVX2 or NEON kernels when the CPU supports them. The environment
+variable LIBASOUND_NO_SIMD forces the scalar code.
+
 \subsection pcm_plugins_dmix_funcref Function reference
 
 <UL>
@@ -0,0 +1,128 @@
+/*
+ * float sum buffer: the sum ring holds floats (full scale = 1.0) instead
+ * of integers, the clients may use either the slave format or native
+ * float; only native endian S16 and S32 slaves are supported
+ */
+
+#define float_dmix_supported_format \
+	((1ULL << SND_PCM_FORMAT_S16) | (1ULL << SND_PCM_FORMAT_S32))
+
+static inline float float_mix_from_16(signed short sample)
+{
+	return sample * (1.0f / 0x8000);
+}
+
+static inline float float_mix_from_32(signed int sample)
+{
+	return sample * (1.0f / 0x80000000U);
+}
+
+static inline float float_mix_from_float(float sample)
+{
+	/*
+	 * a NaN or an infinity would stay in the sum until the slave clears
+	 * the area (and the remix of an infinity gives a NaN), so the
+	 * samples are clipped to full scale like the integer ones and NaNs
+	 * are muted
+	 */
+	if (sample >= 1.0f)
+		return 1.0f;
+	if (sample <= -1.0f)
+		return -1.0f;
+	return sample == sample ? sample : 0.0f;
+}
+
+/*
+ * a NaN in the sum ring (not yet cleared by the slave) gives a zero
+ * sample, the next mix then restarts the sum from zero
+ */
+
+static inline signed short float_mix_to_16(float sum)
+{
+	sum *= 0x8000;
+	if (sum >= 0x7fff)
+		return 0x7fff;
+	if (sum <= -0x8000)
+		return -0x8000;
+	if (sum != sum)
+		return 0;
+	return sum + (sum < 0 ? -0.5f : 0.5f);
+}
+
+static inline signed int float_mix_to_32(float sum)
+{
+	sum *= 0x80000000U;
+	if (sum >= 0x7fffffff)
+		return 0x7fffffff;
+	if (sum <= -0x80000000LL)
+		return -0x7fffffff - 1;
+	if (sum != sum)
+		return 0;
+	return sum + (sum < 0 ? -0.5f : 0.5f);
+}
+
+/*
+ * like in the integer code, a zero sample in the slave buffer means
+ * the area was cleared by the driver and the sum restarts from zero
+ */
+#define FLOAT_MIX_AREAS(name, dst_type, src_type, conv_dst, conv_src, op) \
+static void name(unsigned int size, volatile void *_dst, void *_src,	\
+		 volatile signed int *_sum, size_t dst_step,		\
+		 size_t src_step, size_t sum_step)			\
+{									\
+	volatile dst_type *dst = _dst;					\
+	src_type *src = _src;						\
+	volatile float *sum = (volatile float *)_sum;			\
+	float acc;							\
+									\
+	for (;;) {							\
+		acc = *dst ? *sum : 0.0f;				\
+		acc = acc op conv_src(*src);				\
+		*sum = acc;						\
+		*dst = conv_dst(acc);					\
+		if (!--size)						\
+			return;						\
+		src = (src_type *) ((char *)src + src_step);		\
+		dst = (volatile dst_type *) ((char *)dst + dst_step);	\
+		sum = (volatile float *) ((char *)sum + sum_step);	\
+	}								\
+}
+
+FLOAT_MIX_AREAS(float_mix_areas_16, signed short, signed short,
+		float_mix_to_16, float_mix_from_16, +)
+FLOAT_MIX_AREAS(float_remix_areas_16, signed short, signed short,
+		float_mix_to_16, float_mix_from_16, -)
+FLOAT_MIX_AREAS(float_mix_areas_16_float, signed short, float,
+		float_mix_to_16, float_mix_from_float, +)
+FLOAT_MIX_AREAS(float_remix_areas_16_float, signed short, float,
+		float_mix_to_16, float_mix_from_float, -)
+FLOAT_MIX_AREAS(float_mix_areas_32, signed int, signed int,
+		float_mix_to_32, float_mix_from_32, +)
+FLOAT_MIX_AREAS(float_remix_areas_32, signed int, signed int,
+		float_mix_to_32, float_mix_from_32, -)
+FLOAT_MIX_AREAS(float_mix_areas_32_float, signed int, float,
+		float_mix_to_32, float_mix_from_float, +)
+FLOAT_MIX_AREAS(float_remix_areas_32_float, signed int, float,
+		float_mix_to_32, float_mix_from_float, -)
+
+/* returns the callback for the given client format, NULL if unsupported */
+static mix_areas_t *float_mix_select(snd_pcm_direct_t *dmix,
+				     snd_pcm_format_t format, int remix)
+{
+	int client_float = format == SND_PCM_FORMAT_FLOAT;
+
+	switch (dmix->shmptr->s.format) {
+	case SND_PCM_FORMAT_S16:
+		if (client_float)
+			return remix ? float_remix_areas_16_float :
+				       float_mix_areas_16_float;
+		return remix ? float_remix_areas_16 : float_mix_areas_16;
+	case SND_PCM_FORMAT_S32:
+		if (client_float)
+			return remix ? float_remix_areas_32_float :
+				       float_mix_areas_32_float;
+		return remix ? float_remix_areas_32 : float_mix_areas_32;
+	default:
+		return NULL;
+	}
+}
@@ -511,6 +511,8 @@ static void generic_remix_areas_u8(unsigned int size,
 	}
 }
 
+/* vectorized variants of the native callbacks, see pcm_dmix_simd.c */
+static int simd_mix_select_callbacks(snd_pcm_direct_t *dmix);
 
 static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
@@ -530,6 +532,7 @@ static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 	dmix->u.dmix.remix_areas_24 = generic_remix_areas_24;
 	dmix->u.dmix.remix_areas_u8 = generic_remix_areas_u8;
 	dmix->u.dmix.use_sem = 1;
+	simd_mix_select_callbacks(dmix);
 }
 
 #endif
@@ -0,0 +1,416 @@
+/*
+ * vectorized mixing code (SSE2, AVX2, NEON)
+ *
+ * The kernels give bit-exact results to the generic_*_native() code,
+ * they run under the client semaphore like the generic code. Only
+ * contiguous areas (interleaved buffers) are vectorized, the strided
+ * access and the tail are passed to the generic code.
+ */
+
+#include "pcm_simd.h"
+
+#define simd_contiguous(dst, src, sum, dst_step, src_step, sum_step) \
+	((dst_step) == sizeof(*(dst)) && (src_step) == sizeof(*(src)) && \
+	 (sum_step) == sizeof(*(sum)))
+
+#define SIMD_MIX_TAIL(generic, size, dst, src, sum, dst_step, src_step, sum_step) \
+	do { \
+		if (size) \
+			generic(size, dst, src, sum, dst_step, src_step, sum_step); \
+	} while (0)
+
+#if defined(SND_PCM_SIMD_X86)
+
+/*
+ *  SSE2
+ */
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128i sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_mix_16(volatile signed short *dst, signed short *src,
+		 volatile signed int *sum, int remix)
+{
+	__m128i d = _mm_loadu_si128((__m128i *)dst);
+	__m128i s = _mm_loadu_si128((__m128i *)src);
+	__m128i sum_lo = _mm_loadu_si128((__m128i *)sum);
+	__m128i sum_hi = _mm_loadu_si128((__m128i *)(sum + 4));
+	__m128i zero = _mm_setzero_si128();
+	__m128i z = _mm_cmpeq_epi16(d, zero);
+	__m128i z_lo = _mm_unpacklo_epi16(z, z);
+	__m128i z_hi = _mm_unpackhi_epi16(z, z);
+	__m128i s_lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+	__m128i s_hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+	__m128i out;
+
+	if (remix) {
+		s_lo = _mm_sub_epi32(zero, s_lo);
+		s_hi = _mm_sub_epi32(zero, s_hi);
+	}
+	sum_lo = sse2_select(z_lo, s_lo, _mm_add_epi32(sum_lo, s_lo));
+	sum_hi = sse2_select(z_hi, s_hi, _mm_add_epi32(sum_hi, s_hi));
+	_mm_storeu_si128((__m128i *)sum, sum_lo);
+	_mm_storeu_si128((__m128i *)(sum + 4), sum_hi);
+	out = _mm_packs_epi32(sum_lo, sum_hi);
+	/* the negated -0x8000 wraps in the generic code */
+	if (remix)
+		out = sse2_select(z, _mm_sub_epi16(zero, s), out);
+	_mm_storeu_si128((__m128i *)dst, out);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_mix_32(volatile signed int *dst, signed int *src,
+		 volatile signed int *sum, int remix)
+{
+	__m128i d = _mm_loadu_si128((__m128i *)dst);
+	__m128i s = _mm_loadu_si128((__m128i *)src);
+	__m128i v = _mm_loadu_si128((__m128i *)sum);
+	__m128i zero = _mm_setzero_si128();
+	__m128i z = _mm_cmpeq_epi32(d, zero);
+	__m128i sample = _mm_srai_epi32(s, 8);
+	__m128i out;
+
+	if (remix) {
+		sample = _mm_sub_epi32(zero, sample);
+		s = _mm_sub_epi32(zero, s);
+	}
+	v = sse2_select(z, sample, _mm_add_epi32(v, sample));
+	_mm_storeu_si128((__m128i *)sum, v);
+	out = _mm_slli_epi32(v, 8);
+	out = sse2_select(_mm_cmpgt_epi32(v, _mm_set1_epi32(0x7fffff)),
+			  _mm_set1_epi32(0x7fffffff), out);
+	out = sse2_select(_mm_cmplt_epi32(v, _mm_set1_epi32(-0x800000)),
+			  _mm_set1_epi32(-0x7fffffff - 1), out);
+	out = sse2_select(z, s, out);
+	_mm_storeu_si128((__m128i *)dst, out);
+}
+
+static SND_PCM_SIMD_TARGET_SSE2
+void sse2_mix_areas_16(unsigned int size,
+		       volatile signed short *dst, signed short *src,
+		       volatile signed int *sum, size_t dst_step,
+		       size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			sse2_mix_16(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_SSE2
+void sse2_remix_areas_16(unsigned int size,
+			 volatile signed short *dst, signed short *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			sse2_mix_16(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_SSE2
+void sse2_mix_areas_32(unsigned int size,
+		       volatile signed int *dst, signed int *src,
+		       volatile signed int *sum, size_t dst_step,
+		       size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 4; size -= 4, dst += 4, src += 4, sum += 4)
+			sse2_mix_32(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_SSE2
+void sse2_remix_areas_32(unsigned int size,
+			 volatile signed int *dst, signed int *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 4; size -= 4, dst += 4, src += 4, sum += 4)
+			sse2_mix_32(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+/*
+ *  AVX2
+ */
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_AVX2
+void avx2_mix_16(volatile signed short *dst, signed short *src,
+		 volatile signed int *sum, int remix)
+{
+	__m256i d = _mm256_loadu_si256((__m256i *)dst);
+	__m256i s = _mm256_loadu_si256((__m256i *)src);
+	__m256i sum_lo = _mm256_loadu_si256((__m256i *)sum);
+	__m256i sum_hi = _mm256_loadu_si256((__m256i *)(sum + 8));
+	__m256i zero = _mm256_setzero_si256();
+	__m256i z = _mm256_cmpeq_epi16(d, zero);
+	__m256i z_lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(z));
+	__m256i z_hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(z, 1));
+	__m256i s_lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+	__m256i s_hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+	__m256i out;
+
+	if (remix) {
+		s_lo = _mm256_sub_epi32(zero, s_lo);
+		s_hi = _mm256_sub_epi32(zero, s_hi);
+	}
+	sum_lo = _mm256_blendv_epi8(_mm256_add_epi32(sum_lo, s_lo), s_lo, z_lo);
+	sum_hi = _mm256_blendv_epi8(_mm256_add_epi32(sum_hi, s_hi), s_hi, z_hi);
+	_mm256_storeu_si256((__m256i *)sum, sum_lo);
+	_mm256_storeu_si256((__m256i *)(sum + 8), sum_hi);
+	/* packs works per 128-bit lane, restore the sample order */
+	out = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum_lo, sum_hi), 0xd8);
+	if (remix)
+		out = _mm256_blendv_epi8(out, _mm256_sub_epi16(zero, s), z);
+	_mm256_storeu_si256((__m256i *)dst, out);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_AVX2
+void avx2_mix_32(volatile signed int *dst, signed int *src,
+		 volatile signed int *sum, int remix)
+{
+	__m256i d = _mm256_loadu_si256((__m256i *)dst);
+	__m256i s = _mm256_loadu_si256((__m256i *)src);
+	__m256i v = _mm256_loadu_si256((__m256i *)sum);
+	__m256i zero = _mm256_setzero_si256();
+	__m256i z = _mm256_cmpeq_epi32(d, zero);
+	__m256i sample = _mm256_srai_epi32(s, 8);
+	__m256i out;
+
+	if (remix) {
+		sample = _mm256_sub_epi32(zero, sample);
+		s = _mm256_sub_epi32(zero, s);
+	}
+	v = _mm256_blendv_epi8(_mm256_add_epi32(v, sample), sample, z);
+	_mm256_storeu_si256((__m256i *)sum, v);
+	out = _mm256_slli_epi32(v, 8);
+	out = _mm256_blendv_epi8(out, _mm256_set1_epi32(0x7fffffff),
+				 _mm256_cmpgt_epi32(v, _mm256_set1_epi32(0x7fffff)));
+	out = _mm256_blendv_epi8(out, _mm256_set1_epi32(-0x7fffffff - 1),
+				 _mm256_cmpgt_epi32(_mm256_set1_epi32(-0x800000), v));
+	out = _mm256_blendv_epi8(out, s, z);
+	_mm256_storeu_si256((__m256i *)dst, out);
+}
+
+static SND_PCM_SIMD_TARGET_AVX2
+void avx2_mix_areas_16(unsigned int size,
+		       volatile signed short *dst, signed short *src,
+		       volatile signed int *sum, size_t dst_step,
+		       size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 16; size -= 16, dst += 16, src += 16, sum += 16)
+			avx2_mix_16(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_AVX2
+void avx2_remix_areas_16(unsigned int size,
+			 volatile signed short *dst, signed short *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 16; size -= 16, dst += 16, src += 16, sum += 16)
+			avx2_mix_16(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_AVX2
+void avx2_mix_areas_32(unsigned int size,
+		       volatile signed int *dst, signed int *src,
+		       volatile signed int *sum, size_t dst_step,
+		       size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			avx2_mix_32(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SND_PCM_SIMD_TARGET_AVX2
+void avx2_remix_areas_32(unsigned int size,
+			 volatile signed int *dst, signed int *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			avx2_mix_32(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+/*
+ *  NEON
+ */
+
+static inline void neon_mix_16(volatile signed short *dst, signed short *src,
+			       volatile signed int *sum, int remix)
+{
+	int16x8_t d = vld1q_s16((const int16_t *)dst);
+	int16x8_t s = vld1q_s16(src);
+	int32x4_t sum_lo = vld1q_s32((const int32_t *)sum);
+	int32x4_t sum_hi = vld1q_s32((const int32_t *)sum + 4);
+	uint16x8_t z = vceqq_s16(d, vdupq_n_s16(0));
+	uint32x4_t z_lo = vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_low_u16(z))));
+	uint32x4_t z_hi = vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_high_u16(z))));
+	int32x4_t s_lo = vmovl_s16(vget_low_s16(s));
+	int32x4_t s_hi = vmovl_s16(vget_high_s16(s));
+	int16x8_t out;
+
+	if (remix) {
+		s_lo = vnegq_s32(s_lo);
+		s_hi = vnegq_s32(s_hi);
+	}
+	sum_lo = vbslq_s32(z_lo, s_lo, vaddq_s32(sum_lo, s_lo));
+	sum_hi = vbslq_s32(z_hi, s_hi, vaddq_s32(sum_hi, s_hi));
+	vst1q_s32((int32_t *)sum, sum_lo);
+	vst1q_s32((int32_t *)sum + 4, sum_hi);
+	out = vcombine_s16(vqmovn_s32(sum_lo), vqmovn_s32(sum_hi));
+	/* the negated -0x8000 wraps in the generic code */
+	if (remix)
+		out = vbslq_s16(z, vnegq_s16(s), out);
+	vst1q_s16((int16_t *)dst, out);
+}
+
+static inline void neon_mix_32(volatile signed int *dst, signed int *src,
+			       volatile signed int *sum, int remix)
+{
+	int32x4_t d = vld1q_s32((const int32_t *)dst);
+	int32x4_t s = vld1q_s32(src);
+	int32x4_t v = vld1q_s32((const int32_t *)sum);
+	uint32x4_t z = vceqq_s32(d, vdupq_n_s32(0));
+	int32x4_t sample = vshrq_n_s32(s, 8);
+	int32x4_t out;
+
+	if (remix) {
+		sample = vnegq_s32(sample);
+		s = vnegq_s32(s);
+	}
+	v = vbslq_s32(z, sample, vaddq_s32(v, sample));
+	vst1q_s32((int32_t *)sum, v);
+	out = vshlq_n_s32(v, 8);
+	out = vbslq_s32(vcgtq_s32(v, vdupq_n_s32(0x7fffff)),
+			vdupq_n_s32(0x7fffffff), out);
+	out = vbslq_s32(vcltq_s32(v, vdupq_n_s32(-0x800000)),
+			vdupq_n_s32(-0x7fffffff - 1), out);
+	out = vbslq_s32(z, s, out);
+	vst1q_s32((int32_t *)dst, out);
+}
+
+static void neon_mix_areas_16(unsigned int size,
+			      volatile signed short *dst, signed short *src,
+			      volatile signed int *sum, size_t dst_step,
+			      size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			neon_mix_16(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static void neon_remix_areas_16(unsigned int size,
+				volatile signed short *dst, signed short *src,
+				volatile signed int *sum, size_t dst_step,
+				size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 8; size -= 8, dst += 8, src += 8, sum += 8)
+			neon_mix_16(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_16_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static void neon_mix_areas_32(unsigned int size,
+			      volatile signed int *dst, signed int *src,
+			      volatile signed int *sum, size_t dst_step,
+			      size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 4; size -= 4, dst += 4, src += 4, sum += 4)
+			neon_mix_32(dst, src, sum, 0);
+	}
+	SIMD_MIX_TAIL(generic_mix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static void neon_remix_areas_32(unsigned int size,
+				volatile signed int *dst, signed int *src,
+				volatile signed int *sum, size_t dst_step,
+				size_t src_step, size_t sum_step)
+{
+	if (simd_contiguous(dst, src, sum, dst_step, src_step, sum_step)) {
+		for (; size >= 4; size -= 4, dst += 4, src += 4, sum += 4)
+			neon_mix_32(dst, src, sum, 1);
+	}
+	SIMD_MIX_TAIL(generic_remix_areas_32_native,
+		      size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+#endif
+
+/*
+ * replace the native-endian generic 16/32-bit callbacks with the best
+ * vectorized variant; returns non-zero if anything was selected
+ */
+static int simd_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (!snd_pcm_format_cpu_endian(dmix->shmptr->s.format))
+		return 0;
+#if defined(SND_PCM_SIMD_X86)
+	if (caps & SND_PCM_SIMD_AVX2) {
+		dmix->u.dmix.mix_areas_16 = avx2_mix_areas_16;
+		dmix->u.dmix.mix_areas_32 = avx2_mix_areas_32;
+		dmix->u.dmix.remix_areas_16 = avx2_remix_areas_16;
+		dmix->u.dmix.remix_areas_32 = avx2_remix_areas_32;
+		return 1;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		dmix->u.dmix.mix_areas_16 = sse2_mix_areas_16;
+		dmix->u.dmix.mix_areas_32 = sse2_mix_areas_32;
+		dmix->u.dmix.remix_areas_16 = sse2_remix_areas_16;
+		dmix->u.dmix.remix_areas_32 = sse2_remix_areas_32;
+		return 1;
+	}
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON) {
+		dmix->u.dmix.mix_areas_16 = neon_mix_areas_16;
+		dmix->u.dmix.mix_areas_32 = neon_mix_areas_32;
+		dmix->u.dmix.remix_areas_16 = neon_remix_areas_16;
+		dmix->u.dmix.remix_areas_32 = neon_remix_areas_32;
+		return 1;
+	}
+#endif
+	(void)caps;
+	return 0;
+}
@@ -111,6 +111,12 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 	snd_pcm_uframes_t appl_ptr, size;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 	
+	/* the client wrote to the slave buffer directly */
+	if (dshare->zero_copy) {
+		dshare->last_appl_ptr = dshare->appl_ptr;
+		return;
+	}
+
 	/* calculate the size to transfer */
 	size = pcm_frame_diff(dshare->appl_ptr, dshare->last_appl_ptr, pcm->boundary);
 	if (! size)
@@ -170,9 +176,20 @@ static int snd_pcm_dshare_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_p
 	if (diff == 0)		/* fast path */
 		return 0;
 	if (dshare->state != SND_PCM_STATE_RUNNING &&
-	    dshare->state != SND_PCM_STATE_DRAINING)
-		/* not really started yet - don't update hw_ptr */
+	    dshare->state != SND_PCM_STATE_DRAINING) {
+		if (dshare->state != SND_PCM_STATE_PREPARED ||
+		    !dshare->zero_copy)
+			/* not really started yet - don't update hw_ptr */
+			return 0;
+		/* zero-copy: the slave plays the client ring since prepare,
+		 * drop the frames which were written too late
+		 */
+		dshare->hw_ptr += diff;
+		dshare->hw_ptr %= pcm->boundary;
+		if (snd_pcm_mmap_playback_hw_avail(pcm) < 0)
+			dshare->appl_ptr = dshare->last_appl_ptr = dshare->hw_ptr;
 		return 0;
+	}
 	dshare->hw_ptr += diff;
 	dshare->hw_ptr %= pcm->boundary;
 	// printf("sync ptr diff = %li\n", diff);
@@ -324,6 +341,12 @@ static int snd_pcm_dshare_hwsync(snd_pcm_t *pcm)
 static int snd_pcm_dshare_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
+
+	if (dshare->zero_copy) {
+		/* the pointers must stay in sync with the slave ring */
+		dshare->appl_ptr = dshare->last_appl_ptr = dshare->hw_ptr;
+		return 0;
+	}
 	dshare->hw_ptr %= pcm->period_size;
 	dshare->appl_ptr = dshare->last_appl_ptr = dshare->hw_ptr;
 	dshare->slave_appl_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
@@ -336,8 +359,12 @@ static int snd_pcm_dshare_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dshare)
 	int err;
 
 	snd_pcm_hwsync(dshare->spcm);
-	dshare->slave_appl_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
-	snd_pcm_direct_reset_slave_ptr(pcm, dshare);
+	if (dshare->zero_copy) {
+		snd_pcm_dshare_sync_ptr0(pcm, *dshare->spcm->hw.ptr);
+	} else {
+		dshare->slave_appl_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
+		snd_pcm_direct_reset_slave_ptr(pcm, dshare);
+	}
 	err = snd_timer_start(dshare->timer);
 	if (err < 0)
 		return err;
@@ -353,6 +380,10 @@ static int snd_pcm_dshare_start(snd_pcm_t *pcm)
 	
 	if (dshare->state != SND_PCM_STATE_PREPARED)
 		return -EBADFD;
+	if (dshare->zero_copy) {
+		snd_pcm_hwsync(dshare->spcm);
+		snd_pcm_dshare_sync_ptr0(pcm, *dshare->spcm->hw.ptr);
+	}
 	avail = snd_pcm_mmap_playback_hw_avail(pcm);
 	if (avail == 0)
 		dshare->state = STATE_RUN_PENDING;
@@ -368,6 +399,24 @@ static int snd_pcm_dshare_start(snd_pcm_t *pcm)
 	return 0;
 }
 
+static int snd_pcm_dshare_prepare(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dshare = pcm->private_data;
+	int err;
+
+	err = snd_pcm_direct_prepare(pcm);
+	if (err < 0 || !dshare->zero_copy)
+		return err;
+	/* align the client ring with the slave one, the client data
+	 * is played from the current slave position on
+	 */
+	snd_pcm_hwsync(dshare->spcm);
+	dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
+	dshare->hw_ptr = dshare->slave_hw_ptr % pcm->buffer_size;
+	dshare->appl_ptr = dshare->last_appl_ptr = dshare->hw_ptr;
+	return 0;
+}
+
 static int snd_pcm_dshare_drop(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
@@ -607,6 +656,8 @@ static void snd_pcm_dshare_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_direct_t *dshare = pcm->private_data;
 
 	snd_output_printf(out, "Direct Share PCM\n");
+	if (dshare->zero_copy)
+		snd_output_printf(out, "Zero-copy, mapped to the slave buffer\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -643,7 +694,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dshare_fast_ops = {
 	.state = snd_pcm_dshare_state,
 	.hwsync = snd_pcm_dshare_hwsync,
 	.delay = snd_pcm_dshare_delay,
-	.prepare = snd_pcm_direct_prepare,
+	.prepare = snd_pcm_dshare_prepare,
 	.reset = snd_pcm_dshare_reset,
 	.start = snd_pcm_dshare_start,
 	.drop = snd_pcm_dshare_drop,
@@ -717,6 +768,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 	dshare->ipc_perm = opts->ipc_perm;
 	dshare->ipc_gid = opts->ipc_gid;
 	dshare->tstamp_type = opts->tstamp_type;
+	dshare->ipc_lock = opts->ipc_lock;
 	dshare->semid = -1;
 	dshare->shmid = -1;
 
@@ -757,6 +809,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 	pcm->private_data = dshare;
 	dshare->state = SND_PCM_STATE_OPEN;
 	dshare->slowptr = opts->slowptr;
+	dshare->adaptive_wakeup = opts->adaptive_wakeup;
 	dshare->max_periods = opts->max_periods;
 	dshare->var_periodsize = opts->var_periodsize;
 	dshare->hw_ptr_alignment = opts->hw_ptr_alignment;
@@ -855,6 +908,9 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 		goto _err;
 	}
 	dshare->shmptr->u.dshare.chn_mask |= dshare->u.dshare.chn_mask;
+
+	if (opts->zero_copy)
+		snd_pcm_direct_setup_zero_copy(pcm, dshare);
 		
 	ret = snd_pcm_direct_initialize_poll_fd(dshare);
 	if (ret < 0) {
@@ -917,6 +973,10 @@ pcm.name {
 	ipc_key INT		# unique IPC key
 	ipc_key_add_uid BOOL	# add current uid to unique IPC key
 	ipc_perm INT		# IPC permissions (octal, default 0600)
+	ipc_lock STR		# lock serializing the clients
+				# STR can be one of the below strings :
+				# sem (default)
+				# futex
 	hw_ptr_alignment STR	# Slave application and hw pointer alignment type
 		# STR can be one of the below strings :
 		# no
@@ -947,9 +1007,30 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	adaptive_wakeup BOOL	# timer wakeups follow avail_min
+	zero_copy BOOL		# map the bound slave channels directly
 }
 \endcode
 
+<code>ipc_lock</code> selects the lock used for the slave recovery
+among the clients: "sem" (SysV semaphore, default) or "futex" (a robust
+mutex in the shared memory area, recovered when its holder dies).  The
+first client decides.
+
+<code>zero_copy</code> lets the client write into the bound channels
+of the slave buffer directly instead of copying its own ring on each
+commit.  Only the MMAP_COMPLEX and RW access types are offered, the
+buffer and period sizes are those of the slave, and the stream is
+effectively playing from the prepare call on (frames written too late
+are skipped).  All client channels must be bound, otherwise the option
+is ignored.
+
+<code>adaptive_wakeup</code> lets the slave timer wake the client every
+N slave periods instead of every period, N being derived from the
+avail_min software parameter (and limited so that the buffer cannot
+run out between two wakeups).  This saves context switches for clients
+with a large avail_min.
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
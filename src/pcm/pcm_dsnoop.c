@@ -106,6 +106,10 @@ static void snd_pcm_dsnoop_sync_area(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_
 	snd_pcm_uframes_t transfer;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 	
+	/* the clients read the slave buffer directly */
+	if (dsnoop->zero_copy)
+		return;
+
 	/* add sample areas here */
 	dst_areas = snd_pcm_mmap_areas(pcm);
 	src_areas = snd_pcm_mmap_areas(dsnoop->spcm);
@@ -159,9 +163,15 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 	dsnoop->hw_ptr += diff;
 	dsnoop->hw_ptr %= pcm->boundary;
 	// printf("sync ptr diff = %li\n", diff);
+	avail = snd_pcm_mmap_capture_avail(pcm);
+	/* the period being captured by the slave overwrites the oldest frames */
+	if (dsnoop->zero_copy &&
+	    avail > pcm->buffer_size - dsnoop->slave_period_size)
+		goto xrun;
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
-	if ((avail = snd_pcm_mmap_capture_avail(pcm)) >= pcm->stop_threshold) {
+	if (avail >= pcm->stop_threshold) {
+ xrun:
 		gettimestamp(&dsnoop->trigger_tstamp, pcm->tstamp_type);
 		dsnoop->state = SND_PCM_STATE_XRUN;
 		dsnoop->avail_max = avail;
@@ -271,6 +281,11 @@ static int snd_pcm_dsnoop_hwsync(snd_pcm_t *pcm)
 static int snd_pcm_dsnoop_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	if (dsnoop->zero_copy) {
+		/* the pointers must stay in sync with the slave ring */
+		dsnoop->appl_ptr = dsnoop->hw_ptr;
+		return 0;
+	}
 	dsnoop->hw_ptr %= pcm->period_size;
 	dsnoop->appl_ptr = dsnoop->hw_ptr;
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
@@ -288,7 +303,13 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
-	snd_pcm_direct_reset_slave_ptr(pcm, dsnoop);
+	if (dsnoop->zero_copy) {
+		/* the client cursor starts at the current slave position */
+		dsnoop->hw_ptr = dsnoop->slave_hw_ptr % pcm->buffer_size;
+		dsnoop->appl_ptr = dsnoop->hw_ptr;
+	} else {
+		snd_pcm_direct_reset_slave_ptr(pcm, dsnoop);
+	}
 	err = snd_timer_start(dsnoop->timer);
 	if (err < 0)
 		return err;
@@ -348,7 +369,16 @@ static int snd_pcm_dsnoop_pause(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int enable ATTR
 
 static snd_pcm_sframes_t snd_pcm_dsnoop_rewindable(snd_pcm_t *pcm)
 {
-	return snd_pcm_mmap_capture_hw_rewindable(pcm);
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_sframes_t avail = snd_pcm_mmap_capture_hw_rewindable(pcm);
+
+	/* the slave period being captured is overwritten */
+	if (dsnoop->zero_copy) {
+		avail -= dsnoop->slave_period_size;
+		if (avail < 0)
+			avail = 0;
+	}
+	return avail;
 }
 
 static snd_pcm_sframes_t snd_pcm_dsnoop_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
@@ -485,6 +515,8 @@ static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 
 	snd_output_printf(out, "Direct Snoop PCM\n");
+	if (dsnoop->zero_copy)
+		snd_output_printf(out, "Zero-copy, mapped to the slave buffer\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -588,6 +620,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	dsnoop->ipc_perm = opts->ipc_perm;
 	dsnoop->ipc_gid = opts->ipc_gid;
 	dsnoop->tstamp_type = opts->tstamp_type;
+	dsnoop->ipc_lock = opts->ipc_lock;
 	dsnoop->semid = -1;
 	dsnoop->shmid = -1;
 
@@ -623,6 +656,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	pcm->private_data = dsnoop;
 	dsnoop->state = SND_PCM_STATE_OPEN;
 	dsnoop->slowptr = opts->slowptr;
+	dsnoop->adaptive_wakeup = opts->adaptive_wakeup;
 	dsnoop->max_periods = opts->max_periods;
 	dsnoop->var_periodsize = opts->var_periodsize;
 	dsnoop->sync_ptr = snd_pcm_dsnoop_sync_ptr;
@@ -724,6 +758,9 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	
 	if (dsnoop->channels == UINT_MAX)
 		dsnoop->channels = dsnoop->shmptr->s.channels;
+
+	if (opts->zero_copy)
+		snd_pcm_direct_setup_zero_copy(pcm, dsnoop);
 	
 	snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
 
@@ -771,6 +808,10 @@ pcm.name {
 	ipc_key INT		# unique IPC key
 	ipc_key_add_uid BOOL	# add current uid to unique IPC key
 	ipc_perm INT		# IPC permissions (octal, default 0600)
+	ipc_lock STR		# lock serializing the clients
+				# STR can be one of the below strings :
+				# sem (default)
+				# futex
 	hw_ptr_alignment STR	# Slave application and hw pointer alignment type
 		# STR can be one of the below strings :
 		# no
@@ -801,9 +842,32 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	adaptive_wakeup BOOL	# timer wakeups follow avail_min
+	zero_copy BOOL		# read the slave buffer directly
 }
 \endcode
 
+<code>ipc_lock</code> selects the lock used for the slave recovery
+among the clients: "sem" (SysV semaphore, default) or "futex" (a robust
+mutex in the shared memory area, recovered when its holder dies).  The
+first client decides.
+
+<code>zero_copy</code> makes the client areas point to the bound
+channels of the slave buffer, which the hardware fills once for all
+the clients; each client only keeps its own read position, and no
+data is copied when the pointers are updated.  Only the MMAP_COMPLEX
+and RW access types are offered and the buffer and period sizes are
+those of the slave.  A client which falls behind by more than the
+slave buffer minus one period gets an xrun, whatever its stop
+threshold, since the oldest frames are being overwritten.  All client
+channels must be bound, otherwise the option is ignored.
+
+<code>adaptive_wakeup</code> lets the slave timer wake the client every
+N slave periods instead of every period, N being derived from the
+avail_min software parameter (and limited so that the buffer cannot
+run out between two wakeups).  This saves context switches for clients
+with a large avail_min.
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
@@ -97,6 +97,15 @@ typedef struct {
 	bool mmap_status_fallbacked;
 	bool mmap_control_fallbacked;
 	struct snd_pcm_sync_ptr *sync_ptr;
+	/* SYNC_PTR coalescing for the fallbacked status/control */
+	unsigned long long sync_ptr_budget;	/* status staleness budget (ns) */
+	unsigned long long sync_ptr_stamp;	/* time of the last sync (ns) */
+	bool sync_ptr_valid;			/* the fields below match the kernel */
+	bool sync_ptr_hwsync;			/* the last sync was a HWSYNC */
+	snd_pcm_uframes_t sync_ptr_appl;	/* appl_ptr and avail_min as synced */
+	snd_pcm_uframes_t sync_ptr_avail_min;
+	unsigned long long sync_ptr_ioctls;
+	unsigned long long sync_ptr_open;	/* time of the open (ns) */
 
 	int period_event;
 	snd_timer_t *period_timer;
@@ -132,22 +141,63 @@ struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 }
 #endif /* DOC_HIDDEN */
 
+static unsigned long long sync_ptr_now(void)
+{
+	snd_htimestamp_t ts;
+
+	gettimestamp(&ts, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Every SYNC_PTR returns the status, and the control data as the kernel
+ * has it afterwards.  Remember both, so that the writes of unchanged
+ * values can be skipped and, with a staleness budget, the status queries
+ * following shortly after are served from the last sync.
+ */
 static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
 {
 	int err;
 	hw->sync_ptr->flags = flags;
+	hw->sync_ptr_ioctls++;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_SYNC_PTR, hw->sync_ptr) < 0) {
 		err = -errno;
+		hw->sync_ptr_valid = false;
 		SYSMSG("SNDRV_PCM_IOCTL_SYNC_PTR failed (%i)", err);
 		return err;
 	}
+	hw->sync_ptr_valid = true;
+	hw->sync_ptr_hwsync = !!(flags & SNDRV_PCM_SYNC_PTR_HWSYNC);
+	hw->sync_ptr_appl = hw->sync_ptr->c.control.appl_ptr;
+	hw->sync_ptr_avail_min = hw->sync_ptr->c.control.avail_min;
+	if (hw->sync_ptr_budget)
+		hw->sync_ptr_stamp = sync_ptr_now();
 	return 0;
 }
 
+/* the state may have changed in the kernel without a sync */
+static inline void sync_ptr_invalidate(snd_pcm_hw_t *hw)
+{
+	hw->sync_ptr_valid = false;
+}
+
+/* the status of the last sync is still within the staleness budget */
+static bool sync_ptr_fresh(snd_pcm_hw_t *hw, bool hwsync)
+{
+	if (!hw->sync_ptr_budget || !hw->sync_ptr_valid)
+		return false;
+	if (hwsync && !hw->sync_ptr_hwsync)
+		return false;
+	return sync_ptr_now() - hw->sync_ptr_stamp < hw->sync_ptr_budget;
+}
+
 static int issue_avail_min(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_control_fallbacked)
 		return 0;
+	if (hw->sync_ptr_valid &&
+	    hw->mmap_control->avail_min == hw->sync_ptr_avail_min)
+		return 0;
 
 	/* Avoid unexpected change of applptr in kernel space. */
 	return sync_ptr1(hw, SNDRV_PCM_SYNC_PTR_APPL);
@@ -157,6 +207,9 @@ static int issue_applptr(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_control_fallbacked)
 		return 0;
+	if (hw->sync_ptr_valid &&
+	    hw->mmap_control->appl_ptr == hw->sync_ptr_appl)
+		return 0;
 
 	/* Avoid unexpected change of avail_min in kernel space. */
 	return sync_ptr1(hw, SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
@@ -166,6 +219,8 @@ static int request_hwsync(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_status_fallbacked)
 		return 0;
+	if (sync_ptr_fresh(hw, true))
+		return 0;
 
 	/*
 	 * Query both of control/status data to avoid unexpected change of
@@ -195,6 +250,8 @@ static int query_status_data(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_status_fallbacked)
 		return 0;
+	if (sync_ptr_fresh(hw, false))
+		return 0;
 
 	/*
 	 * Query both of control/status data to avoid unexpected change of
@@ -381,6 +438,7 @@ static int snd_pcm_hw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	sync_ptr_invalidate(hw);
 	if (hw_params_call(hw, params) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_PARAMS failed (%i)", err);
@@ -485,6 +543,7 @@ static int snd_pcm_hw_hw_free(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
 	snd_pcm_hw_change_timer(pcm, 0);
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_HW_FREE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_FREE failed (%i)", err);
@@ -511,6 +570,8 @@ static int snd_pcm_hw_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 		err = issue_avail_min(hw);
 		goto out;
 	}
+	/* SW_PARAMS sets avail_min in the kernel */
+	sync_ptr_invalidate(hw);
 	if (params->tstamp_type == SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW &&
 	    hw->version < SNDRV_PROTOCOL_VERSION(2, 0, 12)) {
 		SYSMSG("Kernel doesn't support SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW");
@@ -654,6 +715,7 @@ static int snd_pcm_hw_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_PREPARE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PREPARE failed (%i)", err);
@@ -666,6 +728,7 @@ static int snd_pcm_hw_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_RESET) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_RESET failed (%i)", err);
@@ -683,6 +746,7 @@ static int snd_pcm_hw_start(snd_pcm_t *pcm)
 	       snd_pcm_mmap_playback_hw_avail(pcm) > 0);
 #endif
 	issue_applptr(hw);
+	sync_ptr_invalidate(hw);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_START) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_START failed (%i)", err);
@@ -699,6 +763,7 @@ static int snd_pcm_hw_drop(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DROP) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DROP failed (%i)", err);
@@ -712,6 +777,7 @@ static int snd_pcm_hw_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DRAIN) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DRAIN failed (%i)", err);
@@ -724,6 +790,7 @@ static int snd_pcm_hw_pause(snd_pcm_t *pcm, int enable)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_PAUSE, enable) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PAUSE failed (%i)", err);
@@ -741,6 +808,7 @@ static snd_pcm_sframes_t snd_pcm_hw_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t fra
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_REWIND, &frames) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_REWIND failed (%i)", err);
@@ -762,6 +830,7 @@ static snd_pcm_sframes_t snd_pcm_hw_forward(snd_pcm_t *pcm, snd_pcm_uframes_t fr
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 4) <= hw->version) {
+		sync_ptr_invalidate(hw);
 		if (ioctl(hw->fd, SNDRV_PCM_IOCTL_FORWARD, &frames) < 0) {
 			err = -errno;
 			SYSMSG("SNDRV_PCM_IOCTL_FORWARD failed (%i)", err);
@@ -799,6 +868,7 @@ static int snd_pcm_hw_resume(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_RESUME) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_RESUME failed (%i)", err);
@@ -857,6 +927,7 @@ static snd_pcm_sframes_t snd_pcm_hw_writei(snd_pcm_t *pcm, const void *buffer, s
 	xferi.buf = (char*) buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &xferi) < 0)
 		err = -errno;
 	else
@@ -878,6 +949,7 @@ static snd_pcm_sframes_t snd_pcm_hw_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &xfern) < 0)
 		err = -errno;
 	else
@@ -899,6 +971,7 @@ static snd_pcm_sframes_t snd_pcm_hw_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_
 	xferi.buf = buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_READI_FRAMES, &xferi) < 0)
 		err = -errno;
 	else
@@ -920,6 +993,7 @@ static snd_pcm_sframes_t snd_pcm_hw_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_u
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	sync_ptr_invalidate(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_READN_FRAMES, &xfern) < 0)
 		err = -errno;
 	else
@@ -1121,6 +1195,7 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 		if (avail >= pcm->stop_threshold) {
 			/* SNDRV_PCM_IOCTL_XRUN ioctl has been implemented since PCM kernel API 2.0.1 */
 			if (SNDRV_PROTOCOL_VERSION(2, 0, 1) <= hw->version) {
+				sync_ptr_invalidate(hw);
 				if (ioctl(hw->fd, SNDRV_PCM_IOCTL_XRUN) < 0)
 					return -errno;
 			}
@@ -1432,6 +1507,14 @@ static void snd_pcm_hw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "  appl_ptr     : %li\n", hw->mmap_control->appl_ptr);
 		snd_output_printf(out, "  hw_ptr       : %li\n", hw->mmap_status->hw_ptr);
 	}
+	if (hw->sync_ptr) {
+		double secs = (sync_ptr_now() - hw->sync_ptr_open) / 1e9;
+
+		snd_output_printf(out, "SYNC_PTR ioctls: %llu (%.1f/s), status budget %llu us\n",
+				  hw->sync_ptr_ioctls,
+				  secs > 0 ? hw->sync_ptr_ioctls / secs : 0.0,
+				  hw->sync_ptr_budget / 1000);
+	}
 }
 
 static const snd_pcm_ops_t snd_pcm_hw_ops = {
@@ -1617,6 +1700,7 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	hw->format = SND_PCM_FORMAT_UNKNOWN;
 	hw->rate = 0;
 	hw->channels = 0;
+	hw->sync_ptr_open = sync_ptr_now();
 
 	ret = snd_pcm_new(&pcm, SND_PCM_TYPE_HW, name, info.stream, mode);
 	if (ret < 0) {
@@ -1758,6 +1842,7 @@ pcm.name {
 	[device INT]		# Device number (default 0)
 	[subdevice INT]		# Subdevice number (default -1: first available)
 	[sync_ptr_ioctl BOOL]	# Use SYNC_PTR ioctl rather than the direct mmap access for control structures
+	[sync_ptr_budget INT]	# Reuse the status of a SYNC_PTR ioctl for up to INT us (default 0)
 	[nonblock BOOL]		# Force non-blocking open mode
 	[format STR]		# Restrict only to the given format
 	[channels INT]		# Restrict only to the given channels
@@ -1766,6 +1851,16 @@ pcm.name {
 }
 \endcode
 
+When the kernel cannot mmap the status and control structures, or when
+sync_ptr_ioctl is set, every status query and every update of appl_ptr or
+avail_min issues a SYNC_PTR ioctl.  The updates of unchanged values are
+skipped.  With sync_ptr_budget, the state, hwsync and avail_update calls
+reuse the status of the last SYNC_PTR ioctl as long as it is younger than
+the given time, so a commit followed by an avail_update costs one ioctl.
+The state and position changes made by the kernel itself (period
+interrupts, xruns, linked streams) are then seen with up to this delay.
+The dump of the PCM shows the number of SYNC_PTR ioctls and their rate.
+
 \subsection pcm_plugins_hw_funcref Function reference
 
 <UL>
@@ -1795,6 +1890,7 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	long card = -1, device = 0, subdevice = -1;
 	const char *str;
 	int err, sync_ptr_ioctl = 0;
+	long sync_ptr_budget = 0;
 	int rate = 0, channels = 0;
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
@@ -1856,6 +1952,19 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "sync_ptr_budget") == 0) {
+			err = snd_config_get_integer(n, &sync_ptr_budget);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto fail;
+			}
+			if (sync_ptr_budget < 0) {
+				SNDERR("Invalid value for %s", id);
+				err = -EINVAL;
+				goto fail;
+			}
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -1926,7 +2035,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		(*pcmp)->mode |= mode & (SND_PCM_NO_AUTO_RESAMPLE|
 					 SND_PCM_NO_AUTO_CHANNELS|
 					 SND_PCM_NO_AUTO_FORMAT|
-					 SND_PCM_NO_SOFTVOL);
+					 SND_PCM_NO_SOFTVOL|
+					 SND_PCM_SINGLE_THREAD);
 
 	hw = (*pcmp)->private_data;
 	if (format != SND_PCM_FORMAT_UNKNOWN)
@@ -1935,6 +2045,7 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		hw->channels = channels;
 	if (rate > 0)
 		hw->rate = rate;
+	hw->sync_ptr_budget = sync_ptr_budget * 1000ULL;
 	if (chmap)
 		hw->chmap_override = chmap;
 
@@ -37,6 +37,8 @@
 typedef float float_t;
 typedef double double_t;
 
+#include "pcm_lfloat_simd.c"
+
 #if __GNUC__ < 2 || (__GNUC__ == 2 && __GNUC_MINOR__ <= 91)
 #define BUGGY_GCC
 #endif
@@ -56,6 +58,10 @@ typedef struct {
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
 		     unsigned int get32idx, unsigned int put32floatidx);
+	lfloat_generic_f direct;	/* direct conversion of the host formats */
+	lfloat_conv_f conv_func;	/* vector kernel for contiguous samples */
+	int dither;
+	unsigned int dither_state[LFLOAT_DITHER_LANES];
 } snd_pcm_lfloat_t;
 
 int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
@@ -271,6 +277,7 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	snd_pcm_t *slave = lfloat->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int i;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_lfloat_hw_refine_cchange,
 					  snd_pcm_lfloat_hw_refine_sprepare,
@@ -294,9 +301,64 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->direct = lfloat_select_conv(src_format, dst_format,
+					    &lfloat->conv_func);
+	/* the generators must not start at zero */
+	for (i = 0; i < LFLOAT_DITHER_LANES; i++)
+		lfloat->dither_state[i] = 0x9e3779b9U * (i + 1);
 	return 0;
 }
 
+static void snd_pcm_lfloat_convert(snd_pcm_t *pcm,
+				   const snd_pcm_channel_area_t *dst_areas,
+				   snd_pcm_uframes_t dst_offset,
+				   snd_pcm_format_t dst_format,
+				   const snd_pcm_channel_area_t *src_areas,
+				   snd_pcm_uframes_t src_offset,
+				   snd_pcm_format_t src_format,
+				   snd_pcm_uframes_t frames)
+{
+	snd_pcm_lfloat_t *lfloat = pcm->private_data;
+	unsigned int *dither = lfloat->dither ? lfloat->dither_state : NULL;
+	unsigned int dst_width, src_width, channel;
+	void *dst, *src;
+
+	if (!lfloat->direct) {
+		lfloat->func(dst_areas, dst_offset,
+			     src_areas, src_offset,
+			     pcm->channels, frames,
+			     lfloat->int32_idx, lfloat->float32_idx);
+		return;
+	}
+	dst_width = snd_pcm_format_physical_width(dst_format);
+	src_width = snd_pcm_format_physical_width(src_format);
+	dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+						pcm->channels, dst_width);
+	src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+						pcm->channels, src_width);
+	if (dst && src) {
+		if (lfloat->conv_func)
+			lfloat->conv_func(dst, src, frames * pcm->channels, dither);
+		else
+			lfloat->direct(dst, dst_width / 8, src, src_width / 8,
+				       frames * pcm->channels, dither);
+		return;
+	}
+	for (channel = 0; channel < pcm->channels; channel++) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		int src_step = snd_pcm_channel_area_step(src_area);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		if (lfloat->conv_func &&
+		    dst_step * 8 == (int)dst_width && src_step * 8 == (int)src_width)
+			lfloat->conv_func(dst, src, frames, dither);
+		else
+			lfloat->direct(dst, dst_step, src, src_step, frames, dither);
+	}
+}
+
 static snd_pcm_uframes_t
 snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -309,10 +371,8 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	snd_pcm_lfloat_convert(pcm, slave_areas, slave_offset, lfloat->sformat,
+			       areas, offset, pcm->format, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +389,8 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	snd_pcm_lfloat_convert(pcm, areas, offset, pcm->format,
+			       slave_areas, slave_offset, lfloat->sformat, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -342,6 +400,8 @@ static void snd_pcm_lfloat_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	snd_output_printf(out, "Linear Integer <-> Linear Float conversion PCM (%s)\n", 
 		snd_pcm_format_name(lfloat->sformat));
+	if (lfloat->dither)
+		snd_output_printf(out, "  Dither: triangular\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -439,9 +499,18 @@ pcm.name {
                 pcm { }         # Slave PCM definition
                 format STR      # Slave format
         }
+        [dither BOOL]           # TPDF dither when narrowing (default no)
 }
 \endcode
 
+S16, S24, S24_3LE and S32 samples in the host byte order are converted
+directly to and from FLOAT and FLOAT64, with SSE2 or NEON code for the
+contiguous samples.  Towards the integers the samples are rounded to the
+nearest value and clamped.  With \c dither set, a triangular dither of
++-1 LSB is added before the rounding to S16, S24 and S24_3LE.  The
+other formats are converted through S32 samples, truncated and without
+dither.
+
 \subsection pcm_plugins_lfloat_funcref Function reference
 
 <UL>
@@ -473,6 +542,7 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_t *spcm;
 	snd_config_t *slave = NULL, *sconf;
 	snd_pcm_format_t sformat;
+	int dither = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -484,6 +554,13 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 			slave = n;
 			continue;
 		}
+		if (strcmp(id, "dither") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			dither = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -506,9 +583,12 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	err = snd_pcm_lfloat_open(pcmp, name, sformat, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_lfloat_t *)(*pcmp)->private_data)->dither = dither;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_lfloat_open, SND_PCM_DLSYM_VERSION);
@@ -0,0 +1,784 @@
+/*
+ * direct integer <-> float conversion code (generic, SSE2, NEON)
+ *
+ * The conversions between S16, S24, S24_3LE and S32 and FLOAT and
+ * FLOAT64 in the host byte order skip the intermediate S32 sample of the
+ * label code.  The integers are scaled by a power of two, so the float
+ * samples are exact up to the float precision.  Towards the integers the
+ * samples are rounded to the nearest value and clamped to the range of
+ * the format, NaN gives the minimum.  When narrowing to 16 or 24 bits a
+ * triangular (TPDF) dither of +-1 LSB can be added before the rounding.
+ *
+ * The vector kernels work on contiguous samples and give the same results
+ * as the generic code, which also handles the strided areas.
+ */
+
+#include "pcm_simd.h"
+
+/* the plugin has its own float_t, no <math.h> */
+#define lfloat_lrintf(v)	__builtin_lrintf(v)
+#define lfloat_lrint(v)		__builtin_lrint(v)
+
+enum {
+	LFLOAT_S16,
+	LFLOAT_S24,		/* in the lower 3 bytes of 32 bits */
+	LFLOAT_S24_3LE,
+	LFLOAT_S32,
+	LFLOAT_INTS
+};
+
+/*
+ * the dither generators are interleaved, the sample i of a run uses the
+ * xorshift state i % LFLOAT_DITHER_LANES
+ */
+#define LFLOAT_DITHER_LANES	8
+
+typedef void (*lfloat_generic_f)(char *dst, int dst_step,
+				 const char *src, int src_step,
+				 unsigned int samples, unsigned int *dither);
+typedef void (*lfloat_conv_f)(void *dst, const void *src,
+			      unsigned int samples, unsigned int *dither);
+
+static inline unsigned int lfloat_bits(int fmt)
+{
+	return fmt == LFLOAT_S16 ? 16 : fmt == LFLOAT_S32 ? 32 : 24;
+}
+
+static inline unsigned int lfloat_width(int fmt)
+{
+	return fmt == LFLOAT_S16 ? 2 : fmt == LFLOAT_S24_3LE ? 3 : 4;
+}
+
+static inline int32_t lfloat_get(const char *p, int fmt)
+{
+	const uint8_t *b = (const uint8_t *)p;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		return *(const int16_t *)p;
+	case LFLOAT_S24:
+		return (int32_t)(*(const uint32_t *)p << 8) >> 8;
+	case LFLOAT_S24_3LE:
+		return b[0] | (b[1] << 8) | (((const int8_t *)p)[2] * 65536);
+	default:
+		return *(const int32_t *)p;
+	}
+}
+
+static inline void lfloat_put(char *p, int fmt, int32_t v)
+{
+	uint8_t *b = (uint8_t *)p;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		*(int16_t *)p = v;
+		break;
+	case LFLOAT_S24_3LE:
+		b[0] = v;
+		b[1] = v >> 8;
+		b[2] = v >> 16;
+		break;
+	default:
+		*(int32_t *)p = v;
+		break;
+	}
+}
+
+static inline float lfloat_dither_noise(unsigned int *state, unsigned int lane)
+{
+	uint32_t x = state[lane];
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	state[lane] = x;
+	return (float)((int32_t)(x & 0xffff) - (int32_t)(x >> 16)) * (1.0f / 65536);
+}
+
+/* the comparisons are ordered like the vector min/max, for NaN */
+static inline int32_t lfloat_round_float(float v, unsigned int bits)
+{
+	float lo, hi;
+
+	if (bits == 32) {
+		if (v >= 2147483648.0f)
+			return 0x7fffffff;
+		if (!(v > -2147483648.0f))
+			return INT32_MIN;
+		return lfloat_lrintf(v);
+	}
+	lo = -(float)(1 << (bits - 1));
+	hi = (float)((1 << (bits - 1)) - 1);
+	v = v > lo ? v : lo;
+	v = v < hi ? v : hi;
+	return lfloat_lrintf(v);
+}
+
+static inline int32_t lfloat_round_double(double v, unsigned int bits)
+{
+	double lo = -(double)(1U << (bits - 1));
+	double hi = (double)((1U << (bits - 1)) - 1);
+
+	v = v > lo ? v : lo;
+	v = v < hi ? v : hi;
+	return lfloat_lrint(v);
+}
+
+static inline __attribute__((always_inline))
+void generic_to_float(char *dst, int dst_step, const char *src, int src_step,
+		      unsigned int samples, int fmt)
+{
+	const float scale = 1.0f / (1U << (lfloat_bits(fmt) - 1));
+	unsigned int i;
+
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step)
+		*(float *)dst = (float)lfloat_get(src, fmt) * scale;
+}
+
+static inline __attribute__((always_inline))
+void generic_to_double(char *dst, int dst_step, const char *src, int src_step,
+		       unsigned int samples, int fmt)
+{
+	const double scale = 1.0 / (1U << (lfloat_bits(fmt) - 1));
+	unsigned int i;
+
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step)
+		*(double *)dst = (double)lfloat_get(src, fmt) * scale;
+}
+
+static inline __attribute__((always_inline))
+void generic_from_float(char *dst, int dst_step, const char *src, int src_step,
+			unsigned int samples, unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const float scale = (float)(1U << (bits - 1));
+	unsigned int i;
+	float v;
+
+	if (bits == 32)
+		dither = NULL;
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step) {
+		v = *(const float *)src * scale;
+		if (dither)
+			v += lfloat_dither_noise(dither, i % LFLOAT_DITHER_LANES);
+		lfloat_put(dst, fmt, lfloat_round_float(v, bits));
+	}
+}
+
+static inline __attribute__((always_inline))
+void generic_from_double(char *dst, int dst_step, const char *src, int src_step,
+			 unsigned int samples, unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const double scale = (double)(1U << (bits - 1));
+	unsigned int i;
+	double v;
+
+	if (bits == 32)
+		dither = NULL;
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step) {
+		v = *(const double *)src * scale;
+		if (dither)
+			v += lfloat_dither_noise(dither, i % LFLOAT_DITHER_LANES);
+		lfloat_put(dst, fmt, lfloat_round_double(v, bits));
+	}
+}
+
+#define LFLOAT_GENERIC(fmt, name)					\
+static void generic_##name##_to_float(char *dst, int dst_step,		\
+				      const char *src, int src_step,	\
+				      unsigned int samples,		\
+				      unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	generic_to_float(dst, dst_step, src, src_step, samples, fmt);	\
+}									\
+static void generic_##name##_to_double(char *dst, int dst_step,		\
+				       const char *src, int src_step,	\
+				       unsigned int samples,		\
+				       unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	generic_to_double(dst, dst_step, src, src_step, samples, fmt);	\
+}									\
+static void generic_float_to_##name(char *dst, int dst_step,		\
+				    const char *src, int src_step,	\
+				    unsigned int samples, unsigned int *dither) \
+{									\
+	generic_from_float(dst, dst_step, src, src_step, samples, dither, fmt); \
+}									\
+static void generic_double_to_##name(char *dst, int dst_step,		\
+				     const char *src, int src_step,	\
+				     unsigned int samples, unsigned int *dither) \
+{									\
+	generic_from_double(dst, dst_step, src, src_step, samples, dither, fmt); \
+}
+
+LFLOAT_GENERIC(LFLOAT_S16, s16)
+LFLOAT_GENERIC(LFLOAT_S24, s24)
+LFLOAT_GENERIC(LFLOAT_S24_3LE, s24_3le)
+LFLOAT_GENERIC(LFLOAT_S32, s32)
+
+/* [integer to float][integer format][float64] */
+static const lfloat_generic_f lfloat_generic_table[2][LFLOAT_INTS][2] = {
+	{
+		{ generic_float_to_s16, generic_double_to_s16 },
+		{ generic_float_to_s24, generic_double_to_s24 },
+		{ generic_float_to_s24_3le, generic_double_to_s24_3le },
+		{ generic_float_to_s32, generic_double_to_s32 },
+	}, {
+		{ generic_s16_to_float, generic_s16_to_double },
+		{ generic_s24_to_float, generic_s24_to_double },
+		{ generic_s24_3le_to_float, generic_s24_3le_to_double },
+		{ generic_s32_to_float, generic_s32_to_double },
+	},
+};
+
+#if defined(SND_PCM_SIMD_X86)
+
+/* 8 samples to two vectors of 32-bit integers */
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_load(const char *s, int fmt, __m128i *a, __m128i *b)
+{
+	__m128i x;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		x = _mm_loadu_si128((const __m128i *)s);
+		*a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		*b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		break;
+	case LFLOAT_S24:
+		*a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i *)s), 8), 8);
+		*b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i *)(s + 16)), 8), 8);
+		break;
+	case LFLOAT_S24_3LE:
+		*a = _mm_setr_epi32(lfloat_get(s, fmt), lfloat_get(s + 3, fmt),
+				    lfloat_get(s + 6, fmt), lfloat_get(s + 9, fmt));
+		*b = _mm_setr_epi32(lfloat_get(s + 12, fmt), lfloat_get(s + 15, fmt),
+				    lfloat_get(s + 18, fmt), lfloat_get(s + 21, fmt));
+		break;
+	default:
+		*a = _mm_loadu_si128((const __m128i *)s);
+		*b = _mm_loadu_si128((const __m128i *)(s + 16));
+		break;
+	}
+}
+
+/* the samples are in the range of the format */
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_store(char *d, int fmt, __m128i a, __m128i b)
+{
+	int32_t t[8];
+	unsigned int k;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		_mm_storeu_si128((__m128i *)d, _mm_packs_epi32(a, b));
+		break;
+	case LFLOAT_S24_3LE:
+		_mm_storeu_si128((__m128i *)t, a);
+		_mm_storeu_si128((__m128i *)(t + 4), b);
+		for (k = 0; k < 8; k++)
+			lfloat_put(d + k * 3, fmt, t[k]);
+		break;
+	default:
+		_mm_storeu_si128((__m128i *)d, a);
+		_mm_storeu_si128((__m128i *)(d + 16), b);
+		break;
+	}
+}
+
+/* the next states of the generators and their noise */
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128 sse2_dither(__m128i *state)
+{
+	__m128i x = *state;
+
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	*state = x;
+	x = _mm_sub_epi32(_mm_and_si128(x, _mm_set1_epi32(0xffff)),
+			  _mm_srli_epi32(x, 16));
+	return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 65536));
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128i sse2_round_float(__m128 v, unsigned int bits)
+{
+	__m128 over;
+
+	if (bits == 32) {
+		/* the overflows convert to 0x80000000 */
+		over = _mm_cmpge_ps(v, _mm_set1_ps(2147483648.0f));
+		return _mm_xor_si128(_mm_cvtps_epi32(v), _mm_castps_si128(over));
+	}
+	v = _mm_max_ps(v, _mm_set1_ps(-(float)(1 << (bits - 1))));
+	v = _mm_min_ps(v, _mm_set1_ps((float)((1 << (bits - 1)) - 1)));
+	return _mm_cvtps_epi32(v);
+}
+
+/* two samples to the lower half */
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128i sse2_round_double(__m128d v, unsigned int bits)
+{
+	v = _mm_max_pd(v, _mm_set1_pd(-(double)(1U << (bits - 1))));
+	v = _mm_min_pd(v, _mm_set1_pd((double)((1U << (bits - 1)) - 1)));
+	return _mm_cvtpd_epi32(v);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_to_float(float *d, const char *s, unsigned int samples, int fmt)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / (1U << (lfloat_bits(fmt) - 1)));
+	const unsigned int width = lfloat_width(fmt);
+	unsigned int i;
+	__m128i a, b;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 8 * width) {
+		sse2_load(s, fmt, &a, &b);
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+		_mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+	}
+	generic_to_float((char *)(d + i), 4, s, width, samples - i, fmt);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_to_double(double *d, const char *s, unsigned int samples, int fmt)
+{
+	const __m128d scale = _mm_set1_pd(1.0 / (1U << (lfloat_bits(fmt) - 1)));
+	const unsigned int width = lfloat_width(fmt);
+	unsigned int i;
+	__m128i a, b;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 8 * width) {
+		sse2_load(s, fmt, &a, &b);
+		_mm_storeu_pd(d + i, _mm_mul_pd(_mm_cvtepi32_pd(a), scale));
+		_mm_storeu_pd(d + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(a, a)), scale));
+		_mm_storeu_pd(d + i + 4, _mm_mul_pd(_mm_cvtepi32_pd(b), scale));
+		_mm_storeu_pd(d + i + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(b, b)), scale));
+	}
+	generic_to_double((char *)(d + i), 8, s, width, samples - i, fmt);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_from_float(char *d, const float *s, unsigned int samples,
+		     unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const unsigned int width = lfloat_width(fmt);
+	const __m128 scale = _mm_set1_ps((float)(1U << (bits - 1)));
+	__m128i x0 = _mm_setzero_si128(), x1 = _mm_setzero_si128();
+	unsigned int i;
+
+	if (bits == 32)
+		dither = NULL;
+	if (dither) {
+		x0 = _mm_loadu_si128((const __m128i *)dither);
+		x1 = _mm_loadu_si128((const __m128i *)(dither + 4));
+	}
+	for (i = 0; i + 8 <= samples; i += 8, d += 8 * width) {
+		__m128 v0 = _mm_mul_ps(_mm_loadu_ps(s + i), scale);
+		__m128 v1 = _mm_mul_ps(_mm_loadu_ps(s + i + 4), scale);
+		if (dither) {
+			v0 = _mm_add_ps(v0, sse2_dither(&x0));
+			v1 = _mm_add_ps(v1, sse2_dither(&x1));
+		}
+		sse2_store(d, fmt, sse2_round_float(v0, bits), sse2_round_float(v1, bits));
+	}
+	if (dither) {
+		_mm_storeu_si128((__m128i *)dither, x0);
+		_mm_storeu_si128((__m128i *)(dither + 4), x1);
+	}
+	generic_from_float(d, width, (const char *)(s + i), 4, samples - i, dither, fmt);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+void sse2_from_double(char *d, const double *s, unsigned int samples,
+		      unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const unsigned int width = lfloat_width(fmt);
+	const __m128d scale = _mm_set1_pd((double)(1U << (bits - 1)));
+	__m128i x0 = _mm_setzero_si128(), x1 = _mm_setzero_si128();
+	unsigned int i, k;
+
+	if (bits == 32)
+		dither = NULL;
+	if (dither) {
+		x0 = _mm_loadu_si128((const __m128i *)dither);
+		x1 = _mm_loadu_si128((const __m128i *)(dither + 4));
+	}
+	for (i = 0; i + 8 <= samples; i += 8, d += 8 * width) {
+		__m128d v[4];
+		__m128i r[4];
+
+		for (k = 0; k < 4; k++)
+			v[k] = _mm_mul_pd(_mm_loadu_pd(s + i + k * 2), scale);
+		if (dither) {
+			__m128 n0 = sse2_dither(&x0);
+			__m128 n1 = sse2_dither(&x1);
+			v[0] = _mm_add_pd(v[0], _mm_cvtps_pd(n0));
+			v[1] = _mm_add_pd(v[1], _mm_cvtps_pd(_mm_movehl_ps(n0, n0)));
+			v[2] = _mm_add_pd(v[2], _mm_cvtps_pd(n1));
+			v[3] = _mm_add_pd(v[3], _mm_cvtps_pd(_mm_movehl_ps(n1, n1)));
+		}
+		for (k = 0; k < 4; k++)
+			r[k] = sse2_round_double(v[k], bits);
+		sse2_store(d, fmt, _mm_unpacklo_epi64(r[0], r[1]),
+			   _mm_unpacklo_epi64(r[2], r[3]));
+	}
+	if (dither) {
+		_mm_storeu_si128((__m128i *)dither, x0);
+		_mm_storeu_si128((__m128i *)(dither + 4), x1);
+	}
+	generic_from_double(d, width, (const char *)(s + i), 8, samples - i, dither, fmt);
+}
+
+#define LFLOAT_SSE2(fmt, name)						\
+SND_PCM_SIMD_TARGET_SSE2						\
+static void sse2_##name##_to_float(void *dst, const void *src,		\
+				   unsigned int samples,		\
+				   unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	sse2_to_float(dst, src, samples, fmt);				\
+}									\
+SND_PCM_SIMD_TARGET_SSE2						\
+static void sse2_##name##_to_double(void *dst, const void *src,	\
+				    unsigned int samples,		\
+				    unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	sse2_to_double(dst, src, samples, fmt);				\
+}									\
+SND_PCM_SIMD_TARGET_SSE2						\
+static void sse2_float_to_##name(void *dst, const void *src,		\
+				 unsigned int samples, unsigned int *dither) \
+{									\
+	sse2_from_float(dst, src, samples, dither, fmt);		\
+}									\
+SND_PCM_SIMD_TARGET_SSE2						\
+static void sse2_double_to_##name(void *dst, const void *src,		\
+				  unsigned int samples, unsigned int *dither) \
+{									\
+	sse2_from_double(dst, src, samples, dither, fmt);		\
+}
+
+LFLOAT_SSE2(LFLOAT_S16, s16)
+LFLOAT_SSE2(LFLOAT_S24, s24)
+LFLOAT_SSE2(LFLOAT_S24_3LE, s24_3le)
+LFLOAT_SSE2(LFLOAT_S32, s32)
+
+static const lfloat_conv_f lfloat_simd_table[2][LFLOAT_INTS][2] = {
+	{
+		{ sse2_float_to_s16, sse2_double_to_s16 },
+		{ sse2_float_to_s24, sse2_double_to_s24 },
+		{ sse2_float_to_s24_3le, sse2_double_to_s24_3le },
+		{ sse2_float_to_s32, sse2_double_to_s32 },
+	}, {
+		{ sse2_s16_to_float, sse2_s16_to_double },
+		{ sse2_s24_to_float, sse2_s24_to_double },
+		{ sse2_s24_3le_to_float, sse2_s24_3le_to_double },
+		{ sse2_s32_to_float, sse2_s32_to_double },
+	},
+};
+
+#define LFLOAT_SIMD_CAPS	SND_PCM_SIMD_SSE2
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+/* 8 samples to two vectors of 32-bit integers */
+static inline __attribute__((always_inline))
+void neon_load(const char *s, int fmt, int32x4_t *a, int32x4_t *b)
+{
+	int32_t t[8];
+	unsigned int k;
+	int16x8_t x;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		x = vld1q_s16((const int16_t *)s);
+		*a = vmovl_s16(vget_low_s16(x));
+		*b = vmovl_high_s16(x);
+		break;
+	case LFLOAT_S24:
+		*a = vshrq_n_s32(vshlq_n_s32(vld1q_s32((const int32_t *)s), 8), 8);
+		*b = vshrq_n_s32(vshlq_n_s32(vld1q_s32((const int32_t *)(s + 16)), 8), 8);
+		break;
+	case LFLOAT_S24_3LE:
+		for (k = 0; k < 8; k++)
+			t[k] = lfloat_get(s + k * 3, fmt);
+		*a = vld1q_s32(t);
+		*b = vld1q_s32(t + 4);
+		break;
+	default:
+		*a = vld1q_s32((const int32_t *)s);
+		*b = vld1q_s32((const int32_t *)(s + 16));
+		break;
+	}
+}
+
+/* the samples are in the range of the format */
+static inline __attribute__((always_inline))
+void neon_store(char *d, int fmt, int32x4_t a, int32x4_t b)
+{
+	int32_t t[8];
+	unsigned int k;
+
+	switch (fmt) {
+	case LFLOAT_S16:
+		vst1q_s16((int16_t *)d, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+		break;
+	case LFLOAT_S24_3LE:
+		vst1q_s32(t, a);
+		vst1q_s32(t + 4, b);
+		for (k = 0; k < 8; k++)
+			lfloat_put(d + k * 3, fmt, t[k]);
+		break;
+	default:
+		vst1q_s32((int32_t *)d, a);
+		vst1q_s32((int32_t *)(d + 16), b);
+		break;
+	}
+}
+
+/* the next states of the generators and their noise */
+static inline __attribute__((always_inline))
+float32x4_t neon_dither(uint32x4_t *state)
+{
+	uint32x4_t x = *state;
+	int32x4_t n;
+
+	x = veorq_u32(x, vshlq_n_u32(x, 13));
+	x = veorq_u32(x, vshrq_n_u32(x, 17));
+	x = veorq_u32(x, vshlq_n_u32(x, 5));
+	*state = x;
+	n = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(x, vdupq_n_u32(0xffff))),
+		      vreinterpretq_s32_u32(vshrq_n_u32(x, 16)));
+	return vmulq_n_f32(vcvtq_f32_s32(n), 1.0f / 65536);
+}
+
+static inline __attribute__((always_inline))
+int32x4_t neon_round_float(float32x4_t v, unsigned int bits)
+{
+	if (bits == 32) {
+		/* the conversion saturates, but gives 0 for NaN */
+		return vbslq_s32(vceqq_f32(v, v), vcvtnq_s32_f32(v),
+				 vdupq_n_s32(INT32_MIN));
+	}
+	v = vmaxnmq_f32(v, vdupq_n_f32(-(float)(1 << (bits - 1))));
+	v = vminnmq_f32(v, vdupq_n_f32((float)((1 << (bits - 1)) - 1)));
+	return vcvtnq_s32_f32(v);
+}
+
+static inline __attribute__((always_inline))
+int32x2_t neon_round_double(float64x2_t v, unsigned int bits)
+{
+	v = vmaxnmq_f64(v, vdupq_n_f64(-(double)(1U << (bits - 1))));
+	v = vminnmq_f64(v, vdupq_n_f64((double)((1U << (bits - 1)) - 1)));
+	return vmovn_s64(vcvtnq_s64_f64(v));
+}
+
+static inline __attribute__((always_inline))
+void neon_to_float(float *d, const char *s, unsigned int samples, int fmt)
+{
+	const float scale = 1.0f / (1U << (lfloat_bits(fmt) - 1));
+	const unsigned int width = lfloat_width(fmt);
+	unsigned int i;
+	int32x4_t a, b;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 8 * width) {
+		neon_load(s, fmt, &a, &b);
+		vst1q_f32(d + i, vmulq_n_f32(vcvtq_f32_s32(a), scale));
+		vst1q_f32(d + i + 4, vmulq_n_f32(vcvtq_f32_s32(b), scale));
+	}
+	generic_to_float((char *)(d + i), 4, s, width, samples - i, fmt);
+}
+
+static inline __attribute__((always_inline))
+void neon_to_double(double *d, const char *s, unsigned int samples, int fmt)
+{
+	const double scale = 1.0 / (1U << (lfloat_bits(fmt) - 1));
+	const unsigned int width = lfloat_width(fmt);
+	unsigned int i;
+	int32x4_t a, b;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 8 * width) {
+		neon_load(s, fmt, &a, &b);
+		vst1q_f64(d + i, vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(a))), scale));
+		vst1q_f64(d + i + 2, vmulq_n_f64(vcvtq_f64_s64(vmovl_high_s32(a)), scale));
+		vst1q_f64(d + i + 4, vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(b))), scale));
+		vst1q_f64(d + i + 6, vmulq_n_f64(vcvtq_f64_s64(vmovl_high_s32(b)), scale));
+	}
+	generic_to_double((char *)(d + i), 8, s, width, samples - i, fmt);
+}
+
+static inline __attribute__((always_inline))
+void neon_from_float(char *d, const float *s, unsigned int samples,
+		     unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const unsigned int width = lfloat_width(fmt);
+	const float scale = (float)(1U << (bits - 1));
+	uint32x4_t x0 = vdupq_n_u32(0), x1 = vdupq_n_u32(0);
+	unsigned int i;
+
+	if (bits == 32)
+		dither = NULL;
+	if (dither) {
+		x0 = vld1q_u32(dither);
+		x1 = vld1q_u32(dither + 4);
+	}
+	for (i = 0; i + 8 <= samples; i += 8, d += 8 * width) {
+		float32x4_t v0 = vmulq_n_f32(vld1q_f32(s + i), scale);
+		float32x4_t v1 = vmulq_n_f32(vld1q_f32(s + i + 4), scale);
+		if (dither) {
+			v0 = vaddq_f32(v0, neon_dither(&x0));
+			v1 = vaddq_f32(v1, neon_dither(&x1));
+		}
+		neon_store(d, fmt, neon_round_float(v0, bits), neon_round_float(v1, bits));
+	}
+	if (dither) {
+		vst1q_u32(dither, x0);
+		vst1q_u32(dither + 4, x1);
+	}
+	generic_from_float(d, width, (const char *)(s + i), 4, samples - i, dither, fmt);
+}
+
+static inline __attribute__((always_inline))
+void neon_from_double(char *d, const double *s, unsigned int samples,
+		      unsigned int *dither, int fmt)
+{
+	const unsigned int bits = lfloat_bits(fmt);
+	const unsigned int width = lfloat_width(fmt);
+	const double scale = (double)(1U << (bits - 1));
+	uint32x4_t x0 = vdupq_n_u32(0), x1 = vdupq_n_u32(0);
+	unsigned int i, k;
+
+	if (bits == 32)
+		dither = NULL;
+	if (dither) {
+		x0 = vld1q_u32(dither);
+		x1 = vld1q_u32(dither + 4);
+	}
+	for (i = 0; i + 8 <= samples; i += 8, d += 8 * width) {
+		float64x2_t v[4];
+
+		for (k = 0; k < 4; k++)
+			v[k] = vmulq_n_f64(vld1q_f64(s + i + k * 2), scale);
+		if (dither) {
+			float32x4_t n0 = neon_dither(&x0);
+			float32x4_t n1 = neon_dither(&x1);
+			v[0] = vaddq_f64(v[0], vcvt_f64_f32(vget_low_f32(n0)));
+			v[1] = vaddq_f64(v[1], vcvt_high_f64_f32(n0));
+			v[2] = vaddq_f64(v[2], vcvt_f64_f32(vget_low_f32(n1)));
+			v[3] = vaddq_f64(v[3], vcvt_high_f64_f32(n1));
+		}
+		neon_store(d, fmt,
+			   vcombine_s32(neon_round_double(v[0], bits),
+					neon_round_double(v[1], bits)),
+			   vcombine_s32(neon_round_double(v[2], bits),
+					neon_round_double(v[3], bits)));
+	}
+	if (dither) {
+		vst1q_u32(dither, x0);
+		vst1q_u32(dither + 4, x1);
+	}
+	generic_from_double(d, width, (const char *)(s + i), 8, samples - i, dither, fmt);
+}
+
+#define LFLOAT_NEON(fmt, name)						\
+static void neon_##name##_to_float(void *dst, const void *src,		\
+				   unsigned int samples,		\
+				   unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	neon_to_float(dst, src, samples, fmt);				\
+}									\
+static void neon_##name##_to_double(void *dst, const void *src,	\
+				    unsigned int samples,		\
+				    unsigned int *dither ATTRIBUTE_UNUSED) \
+{									\
+	neon_to_double(dst, src, samples, fmt);				\
+}									\
+static void neon_float_to_##name(void *dst, const void *src,		\
+				 unsigned int samples, unsigned int *dither) \
+{									\
+	neon_from_float(dst, src, samples, dither, fmt);		\
+}									\
+static void neon_double_to_##name(void *dst, const void *src,		\
+				  unsigned int samples, unsigned int *dither) \
+{									\
+	neon_from_double(dst, src, samples, dither, fmt);		\
+}
+
+LFLOAT_NEON(LFLOAT_S16, s16)
+LFLOAT_NEON(LFLOAT_S24, s24)
+LFLOAT_NEON(LFLOAT_S24_3LE, s24_3le)
+LFLOAT_NEON(LFLOAT_S32, s32)
+
+static const lfloat_conv_f lfloat_simd_table[2][LFLOAT_INTS][2] = {
+	{
+		{ neon_float_to_s16, neon_double_to_s16 },
+		{ neon_float_to_s24, neon_double_to_s24 },
+		{ neon_float_to_s24_3le, neon_double_to_s24_3le },
+		{ neon_float_to_s32, neon_double_to_s32 },
+	}, {
+		{ neon_s16_to_float, neon_s16_to_double },
+		{ neon_s24_to_float, neon_s24_to_double },
+		{ neon_s24_3le_to_float, neon_s24_3le_to_double },
+		{ neon_s32_to_float, neon_s32_to_double },
+	},
+};
+
+#define LFLOAT_SIMD_CAPS	SND_PCM_SIMD_NEON
+
+#endif
+
+/* the index of the conversion tables, -1 for the other formats */
+static int lfloat_int_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return LFLOAT_S16;
+	case SND_PCM_FORMAT_S24:
+		return LFLOAT_S24;
+	case SND_PCM_FORMAT_S24_3LE:
+		return LFLOAT_S24_3LE;
+	case SND_PCM_FORMAT_S32:
+		return LFLOAT_S32;
+	default:
+		return -1;
+	}
+}
+
+static int lfloat_float_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_FLOAT:
+		return 0;
+	case SND_PCM_FORMAT_FLOAT64:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * returns the generic code for the direct conversion, and the vector
+ * kernel in *conv when there is one on this machine
+ */
+static lfloat_generic_f lfloat_select_conv(snd_pcm_format_t src_format,
+					   snd_pcm_format_t dst_format,
+					   lfloat_conv_f *conv)
+{
+	int to_float = snd_pcm_format_linear(src_format) == 1;
+	int i = lfloat_int_index(to_float ? src_format : dst_format);
+	int f = lfloat_float_index(to_float ? dst_format : src_format);
+
+	*conv = NULL;
+	if (i < 0 || f < 0)
+		return NULL;
+#ifdef LFLOAT_SIMD_CAPS
+	if (snd_pcm_simd_caps() & LFLOAT_SIMD_CAPS)
+		*conv = lfloat_simd_table[to_float][i][f];
+#endif
+	return lfloat_generic_table[to_float][i][f];
+}
@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "pcm_linear_simd.c"
 
 #ifndef PIC
 /* entry for static linking */
@@ -44,6 +45,7 @@ typedef struct {
 	unsigned int use_getput;
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
+	linear_conv_f conv_func;	/* vector kernel for interleaved buffers */
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
@@ -328,9 +330,49 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			linear->conv_idx = snd_pcm_linear_convert_index(linear->sformat,
 									format);
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		linear->conv_func = linear_select_conv(format, linear->sformat);
+	else
+		linear->conv_func = linear_select_conv(linear->sformat, format);
 	return 0;
 }
 
+static void snd_pcm_linear_convert_areas(snd_pcm_t *pcm,
+					 const snd_pcm_channel_area_t *dst_areas,
+					 snd_pcm_uframes_t dst_offset,
+					 snd_pcm_format_t dst_format,
+					 const snd_pcm_channel_area_t *src_areas,
+					 snd_pcm_uframes_t src_offset,
+					 snd_pcm_format_t src_format,
+					 snd_pcm_uframes_t frames)
+{
+	snd_pcm_linear_t *linear = pcm->private_data;
+
+	if (linear->conv_func) {
+		void *dst, *src;
+
+		dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+							pcm->channels,
+							snd_pcm_format_physical_width(dst_format));
+		src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+							pcm->channels,
+							snd_pcm_format_physical_width(src_format));
+		if (dst && src) {
+			linear->conv_func(dst, src, frames * pcm->channels);
+			return;
+		}
+	}
+	if (linear->use_getput)
+		snd_pcm_linear_getput(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      pcm->channels, frames,
+				      linear->get_idx, linear->put_idx);
+	else
+		snd_pcm_linear_convert(dst_areas, dst_offset,
+				       src_areas, src_offset,
+				       pcm->channels, frames, linear->conv_idx);
+}
+
 static snd_pcm_uframes_t
 snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -343,15 +385,8 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(slave_areas, slave_offset,
-				      areas, offset, 
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(slave_areas, slave_offset,
-				       areas, offset, 
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_convert_areas(pcm, slave_areas, slave_offset, linear->sformat,
+				     areas, offset, pcm->format, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -368,15 +403,8 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(areas, offset, 
-				      slave_areas, slave_offset,
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(areas, offset, 
-				       slave_areas, slave_offset,
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_convert_areas(pcm, areas, offset, pcm->format,
+				     slave_areas, slave_offset, linear->sformat, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -485,6 +513,11 @@ pcm.name {
 }
 \endcode
 
+Interleaved buffers of S16_LE, S24_3LE and S32_LE samples are converted
+with SSE2/SSSE3 or NEON code when the CPU supports it, other formats and
+layouts sample by sample.  Set the LIBASOUND_NO_SIMD environment variable
+to force the sample by sample code.
+
 \subsection pcm_plugins_linear_funcref Function reference
 
 <UL>
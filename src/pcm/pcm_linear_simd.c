@@ -0,0 +1,309 @@
+/*
+ * vectorized linear conversion code (SSE2, SSSE3, NEON)
+ *
+ * The kernels convert contiguous (interleaved) samples between S16_LE,
+ * S24_3LE and S32_LE.  For these formats the conversions of the label
+ * code in plugin_ops.h only move the upper bytes of each sample and zero
+ * fill or drop the lower ones, so they are done with byte shuffles and
+ * give the same results as the generic code.
+ */
+
+#include "pcm_simd.h"
+
+typedef void (*linear_conv_f)(void *dst, const void *src, unsigned int samples);
+
+/* the reference code and the tails of the kernels */
+static void generic_conv(uint8_t *dst, const uint8_t *src, unsigned int samples,
+			 unsigned int src_width, unsigned int dst_width)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < samples; i++, src += src_width, dst += dst_width) {
+		for (k = 0; k < dst_width; k++)
+			dst[k] = k + src_width >= dst_width ?
+				src[k + src_width - dst_width] : 0;
+	}
+}
+
+#if defined(SND_PCM_SIMD_X86)
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_s16_to_s32(void *dst, const void *src, unsigned int samples)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const int16_t *s = src;
+	int32_t *d = dst;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+		_mm_storeu_si128((__m128i *)(d + i), _mm_unpacklo_epi16(zero, a));
+		_mm_storeu_si128((__m128i *)(d + i + 4), _mm_unpackhi_epi16(zero, a));
+	}
+	generic_conv((uint8_t *)(d + i), (const uint8_t *)(s + i), samples - i, 2, 4);
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_s32_to_s16(void *dst, const void *src, unsigned int samples)
+{
+	const int32_t *s = src;
+	int16_t *d = dst;
+	unsigned int i;
+
+	/* the shifted samples fit in 16 bits, the pack does not saturate */
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(s + i)), 16);
+		__m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(s + i + 4)), 16);
+		_mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(a, b));
+	}
+	generic_conv((uint8_t *)(d + i), (const uint8_t *)(s + i), samples - i, 4, 2);
+}
+
+/* stores the lower 12 bytes */
+SND_PCM_SIMD_TARGET_SSSE3
+static inline void ssse3_store12(uint8_t *d, __m128i r)
+{
+	uint32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+
+	_mm_storel_epi64((__m128i *)d, r);
+	memcpy(d + 8, &tail, 4);
+}
+
+SND_PCM_SIMD_TARGET_SSSE3
+static void ssse3_s16_to_s24_3le(void *dst, const void *src, unsigned int samples)
+{
+	const __m128i lo = _mm_setr_epi8(-1, 0, 1, -1, 2, 3, -1, 4,
+					 5, -1, 6, 7, -1, -1, -1, -1);
+	const __m128i hi = _mm_setr_epi8(-1, 8, 9, -1, 10, 11, -1, 12,
+					 13, -1, 14, 15, -1, -1, -1, -1);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 16, d += 24) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		/* the upper 4 bytes are overwritten by the second store */
+		_mm_storeu_si128((__m128i *)d, _mm_shuffle_epi8(a, lo));
+		ssse3_store12(d + 12, _mm_shuffle_epi8(a, hi));
+	}
+	generic_conv(d, s, samples - i, 2, 3);
+}
+
+SND_PCM_SIMD_TARGET_SSSE3
+static void ssse3_s24_3le_to_s16(void *dst, const void *src, unsigned int samples)
+{
+	const __m128i pack = _mm_setr_epi8(1, 2, 4, 5, 7, 8, 10, 11,
+					   -1, -1, -1, -1, -1, -1, -1, -1);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+
+	/* the second load reads 4 bytes beyond the 8 samples */
+	for (i = 0; i + 10 <= samples; i += 8, s += 24, d += 16) {
+		__m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)s), pack);
+		__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 12)), pack);
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(a, b));
+	}
+	generic_conv(d, s, samples - i, 3, 2);
+}
+
+SND_PCM_SIMD_TARGET_SSSE3
+static void ssse3_s24_3le_to_s32(void *dst, const void *src, unsigned int samples)
+{
+	const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+					     -1, 6, 7, 8, -1, 9, 10, 11);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+
+	/* the second load reads 4 bytes beyond the 8 samples */
+	for (i = 0; i + 10 <= samples; i += 8, s += 24, d += 32) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 12));
+		_mm_storeu_si128((__m128i *)d, _mm_shuffle_epi8(a, unpack));
+		_mm_storeu_si128((__m128i *)(d + 16), _mm_shuffle_epi8(b, unpack));
+	}
+	generic_conv(d, s, samples - i, 3, 4);
+}
+
+SND_PCM_SIMD_TARGET_SSSE3
+static void ssse3_s32_to_s24_3le(void *dst, const void *src, unsigned int samples)
+{
+	const __m128i pack = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10,
+					   11, 13, 14, 15, -1, -1, -1, -1);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8, s += 32, d += 24) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+		/* the upper 4 bytes are overwritten by the second store */
+		_mm_storeu_si128((__m128i *)d, _mm_shuffle_epi8(a, pack));
+		ssse3_store12(d + 12, _mm_shuffle_epi8(b, pack));
+	}
+	generic_conv(d, s, samples - i, 4, 3);
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+/* the structured loads and stores split the samples into byte planes */
+
+static void neon_s16_to_s32(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x4_t r;
+
+	r.val[0] = r.val[1] = vdupq_n_u8(0);
+	for (i = 0; i + 16 <= samples; i += 16, s += 32, d += 64) {
+		uint8x16x2_t a = vld2q_u8(s);
+		r.val[2] = a.val[0];
+		r.val[3] = a.val[1];
+		vst4q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 2, 4);
+}
+
+static void neon_s32_to_s16(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x2_t r;
+
+	for (i = 0; i + 16 <= samples; i += 16, s += 64, d += 32) {
+		uint8x16x4_t a = vld4q_u8(s);
+		r.val[0] = a.val[2];
+		r.val[1] = a.val[3];
+		vst2q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 4, 2);
+}
+
+static void neon_s16_to_s24_3le(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x3_t r;
+
+	r.val[0] = vdupq_n_u8(0);
+	for (i = 0; i + 16 <= samples; i += 16, s += 32, d += 48) {
+		uint8x16x2_t a = vld2q_u8(s);
+		r.val[1] = a.val[0];
+		r.val[2] = a.val[1];
+		vst3q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 2, 3);
+}
+
+static void neon_s24_3le_to_s16(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x2_t r;
+
+	for (i = 0; i + 16 <= samples; i += 16, s += 48, d += 32) {
+		uint8x16x3_t a = vld3q_u8(s);
+		r.val[0] = a.val[1];
+		r.val[1] = a.val[2];
+		vst2q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 3, 2);
+}
+
+static void neon_s24_3le_to_s32(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x4_t r;
+
+	r.val[0] = vdupq_n_u8(0);
+	for (i = 0; i + 16 <= samples; i += 16, s += 48, d += 64) {
+		uint8x16x3_t a = vld3q_u8(s);
+		r.val[1] = a.val[0];
+		r.val[2] = a.val[1];
+		r.val[3] = a.val[2];
+		vst4q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 3, 4);
+}
+
+static void neon_s32_to_s24_3le(void *dst, const void *src, unsigned int samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i;
+	uint8x16x3_t r;
+
+	for (i = 0; i + 16 <= samples; i += 16, s += 64, d += 48) {
+		uint8x16x4_t a = vld4q_u8(s);
+		r.val[0] = a.val[1];
+		r.val[1] = a.val[2];
+		r.val[2] = a.val[3];
+		vst3q_u8(d, r);
+	}
+	generic_conv(d, s, samples - i, 4, 3);
+}
+
+#endif
+
+/* the index of the kernel tables, -1 for the formats without kernels */
+static int linear_simd_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+		return 0;
+	case SND_PCM_FORMAT_S24_3LE:
+		return 1;
+	case SND_PCM_FORMAT_S32_LE:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+/* returns NULL when the formats have no vector kernel on this machine */
+static linear_conv_f linear_select_conv(snd_pcm_format_t src_format,
+					snd_pcm_format_t dst_format)
+{
+#if defined(SND_PCM_SIMD_X86)
+	static const linear_conv_f sse2[3][3] = {
+		{ NULL, NULL, sse2_s16_to_s32 },
+		{ NULL, NULL, NULL },
+		{ sse2_s32_to_s16, NULL, NULL },
+	};
+	static const linear_conv_f ssse3[3][3] = {
+		{ NULL, ssse3_s16_to_s24_3le, sse2_s16_to_s32 },
+		{ ssse3_s24_3le_to_s16, NULL, ssse3_s24_3le_to_s32 },
+		{ sse2_s32_to_s16, ssse3_s32_to_s24_3le, NULL },
+	};
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	static const linear_conv_f neon[3][3] = {
+		{ NULL, neon_s16_to_s24_3le, neon_s16_to_s32 },
+		{ neon_s24_3le_to_s16, NULL, neon_s24_3le_to_s32 },
+		{ neon_s32_to_s16, neon_s32_to_s24_3le, NULL },
+	};
+#endif
+	unsigned int caps = snd_pcm_simd_caps();
+	int src = linear_simd_index(src_format);
+	int dst = linear_simd_index(dst_format);
+
+	if (src < 0 || dst < 0)
+		return NULL;
+#if defined(SND_PCM_SIMD_X86)
+	if (caps & SND_PCM_SIMD_SSSE3)
+		return ssse3[src][dst];
+	if (caps & SND_PCM_SIMD_SSE2)
+		return sse2[src][dst];
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON)
+		return neon[src][dst];
+#endif
+	(void)caps;
+	return NULL;
+}
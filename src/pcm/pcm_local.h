@@ -187,6 +187,27 @@ typedef struct {
 	int (*mmap_begin)(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames); /* locked */
 } snd_pcm_fast_ops_t;
 
+/*
+ * Period sized scratch buffers shared by the plugins of a chain
+ *
+ * The plugins of a chain run one after another, so one set of buffers
+ * serves all of them: the contents are valid only until the plugin calls
+ * into its slave.  Slots 0 and 1 are the input and output of a
+ * conversion step (ping-pong), slot 2 holds a period copied out of a ring
+ * buffer.  A reservation may move the buffers, so the plugins look them
+ * up with snd_pcm_scratch() on each use.
+ */
+#define SND_PCM_SCRATCH_PING	0
+#define SND_PCM_SCRATCH_PONG	1
+#define SND_PCM_SCRATCH_PERIOD	2
+#define SND_PCM_SCRATCH_SLOTS	3
+
+typedef struct _snd_pcm_scratch {
+	unsigned int refs;
+	void *buf[SND_PCM_SCRATCH_SLOTS];
+	size_t size[SND_PCM_SCRATCH_SLOTS];
+} snd_pcm_scratch_t;
+
 struct _snd_pcm {
 	void *open_func;
 	char *name;
@@ -246,6 +267,7 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	snd_pcm_scratch_t *scratch;	/* scratch buffers of the plugin chain */
 #ifdef THREAD_SAFE_API
 	int need_lock;		/* true = this PCM (plugin) is thread-unsafe,
 				 * thus it needs a lock.
@@ -278,6 +300,12 @@ struct _snd_pcm {
 	snd1_pcm_areas_from_bufs
 #define snd_pcm_open_named_slave \
 	snd1_pcm_open_named_slave
+#define snd_pcm_scratch_share \
+	snd1_pcm_scratch_share
+#define snd_pcm_scratch_reserve \
+	snd1_pcm_scratch_reserve
+#define snd_pcm_scratch_release \
+	snd1_pcm_scratch_release
 #define snd_pcm_hw_open_fd \
 	snd1_pcm_hw_open_fd
 #define snd_pcm_wait_nocheck \
@@ -369,6 +397,15 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode);
 int snd_pcm_free(snd_pcm_t *pcm);
 
+void snd_pcm_scratch_share(snd_pcm_t *pcm, snd_pcm_t *slave);
+int snd_pcm_scratch_reserve(snd_pcm_t *pcm, unsigned int slot, size_t size);
+void snd_pcm_scratch_release(snd_pcm_t *pcm);
+
+static inline void *snd_pcm_scratch(snd_pcm_t *pcm, unsigned int slot)
+{
+	return pcm->scratch->buf[slot];
+}
+
 void snd_pcm_areas_from_buf(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void *buf);
 void snd_pcm_areas_from_bufs(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void **bufs);
 
@@ -643,6 +680,27 @@ static inline unsigned int snd_pcm_channel_area_step(const snd_pcm_channel_area_
 	return area->step / 8;
 }
 
+/* returns the first sample at offset if all the channels are interleaved
+ * in one buffer, in order and aligned to the sample width, or NULL
+ */
+static inline void *snd_pcm_channel_areas_interleaved(const snd_pcm_channel_area_t *areas,
+						      snd_pcm_uframes_t offset,
+						      unsigned int channels,
+						      unsigned int width)
+{
+	unsigned int c;
+
+	if (areas[0].first % width || areas[0].step != channels * width)
+		return NULL;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].first != areas[0].first + c * width ||
+		    areas[c].step != areas[0].step)
+			return NULL;
+	}
+	return snd_pcm_channel_area_addr(areas, offset);
+}
+
 static inline snd_pcm_sframes_t _snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
 	/* lock handled in the callback */
@@ -2398,8 +2398,10 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		err = pcm->ops->hw_params(pcm->op_arg, params);
 	else
 		err = -ENOSYS;
-	if (err < 0)
+	if (err < 0) {
+		snd_pcm_scratch_release(pcm);
 		return err;
+	}
 
 	pcm->setup = 1;
 	INTERNAL(snd_pcm_hw_params_get_access)(params, &pcm->access);
@@ -374,9 +374,32 @@ static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plu
 	int err;
 	if (clt->rate == slv->rate)
 		return 0;
-	assert(snd_pcm_format_linear(slv->format));
-	err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
-				plug->gen.slave, plug->gen.slave != plug->req_slave);
+	err = -EINVAL;
+	if (snd_pcm_format_float(slv->format)) {
+		/* keep the float samples if the converter takes them */
+		err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate,
+					plug->rate_converter, plug->gen.slave,
+					plug->gen.slave != plug->req_slave);
+		if (err == -EINVAL) {
+#ifdef BUILD_PCM_PLUGIN_LFLOAT
+			err = snd_pcm_lfloat_open(new, NULL, slv->format,
+						  plug->gen.slave,
+						  plug->gen.slave != plug->req_slave);
+			if (err < 0)
+				return err;
+			plug->gen.slave = *new;
+			slv->format = SND_PCM_FORMAT_S16;
+			err = -EINVAL;
+#else
+			return err;
+#endif
+		}
+	}
+	if (err == -EINVAL) {
+		assert(snd_pcm_format_linear(slv->format));
+		err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
+					plug->gen.slave, plug->gen.slave != plug->req_slave);
+	}
 	if (err < 0)
 		return err;
 	slv->access = clt->access;
@@ -400,7 +423,8 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 	if (clt->rate != slv->rate &&
 	    clt->channels > slv->channels)
 		return 0;
-	assert(snd_pcm_format_linear(slv->format));
+	assert(snd_pcm_format_linear(slv->format) ||
+	       snd_pcm_format_float(slv->format));
 	tt_ssize = slv->channels;
 	tt_cused = clt->channels;
 	tt_sused = slv->channels;
@@ -484,7 +508,9 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 		return err;
 	slv->channels = clt->channels;
 	slv->access = clt->access;
-	if (snd_pcm_format_linear(clt->format))
+	/* the format conversion is fused into the routing pass */
+	if (snd_pcm_format_linear(clt->format) ||
+	    snd_pcm_format_float(clt->format))
 		slv->format = clt->format;
 	return 1;
 }
@@ -539,6 +565,20 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 		}
 #ifdef BUILD_PCM_PLUGIN_LFLOAT
 	} else if (snd_pcm_format_float(slv->format)) {
+		/* the rate plugin tries a native float conversion first */
+		if (clt->format == slv->format && clt->rate != slv->rate &&
+		    clt->channels == slv->channels &&
+		    (!plug->ttable || plug->ttable_ok))
+			return 0;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+		/* the route plugin converts the format in the same pass */
+		if (clt->rate == slv->rate &&
+		    (clt->channels != slv->channels ||
+		     (plug->ttable && !plug->ttable_ok)) &&
+		    (snd_pcm_format_linear(clt->format) ||
+		     snd_pcm_format_float(clt->format)))
+			return 0;
+#endif
 		if (snd_pcm_format_linear(clt->format)) {
 			cfmt = clt->format;
 			f = snd_pcm_lfloat_open;
@@ -1166,6 +1206,12 @@ int snd_pcm_plug_open(snd_pcm_t **pcmp,
 
 This plugin converts channels, rate and format on request.
 
+The plugins are chained so that each conversion pass does as much as
+possible: when the channels change or a transfer table is given, the
+route plugin converts the sample format (linear or float) and applies the
+table gains in the same pass, instead of a separate format conversion
+plugin with its own buffer.  The dump of the chain shows the fused stage.
+
 \code
 pcm.name {
         type plug               # Automatic conversion PCM
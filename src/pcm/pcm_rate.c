@@ -48,6 +48,12 @@ const char *_snd_module_pcm_rate = "";
 
 typedef struct _snd_pcm_rate snd_pcm_rate_t;
 
+/* a committed playback period, kept for rewinds */
+struct snd_pcm_rate_period {
+	snd_pcm_uframes_t slave_size;
+	long long slip_acc;		/* before the period */
+};
+
 struct _snd_pcm_rate {
 	snd_pcm_generic_t gen;
 	snd_pcm_uframes_t appl_ptr, hw_ptr, last_slave_hw_ptr;
@@ -56,7 +62,8 @@ struct _snd_pcm_rate {
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_format_t sformat;
 	unsigned int srate;
-	snd_pcm_channel_area_t *pareas;	/* areas for splitted period (rate pcm) */
+	snd_pcm_channel_area_t *pareas;	/* areas for splitted period (rate pcm),
+					 * in the scratch buffers of the chain */
 	snd_pcm_channel_area_t *sareas;	/* areas for splitted period (slave pcm) */
 	snd_pcm_rate_info_t info;
 	void *open_func;
@@ -64,24 +71,84 @@ struct _snd_pcm_rate {
 	snd_pcm_rate_ops_t ops;
 	unsigned int get_idx;
 	unsigned int put_idx;
-	int16_t *src_buf;
-	int16_t *dst_buf;
 	int start_pending; /* start is triggered but not commited to slave */
 	snd_htimestamp_t trigger_tstamp;
 	unsigned int plugin_version;
 	unsigned int rate_min, rate_max;
+	uint64_t in_formats, out_formats;	/* handled by ops.convert */
+	unsigned int format_flags;
+	/* variable ratio: each slave period is stretched by ratio_ppm */
+	int ratio_ppm;
+	unsigned int slip_max;		/* max. frames added to or removed from a period */
+	long long slip_acc;		/* pending stretch in 1/1000000 frames */
+	snd_pcm_sframes_t slip_pending;	/* committed slip not yet seen by hw_ptr */
+	snd_pcm_uframes_t slave_pos;	/* slave hw_ptr in nominal periods */
+	struct {
+		int enabled;
+		int max_ppm;
+		int running;
+		snd_pcm_uframes_t warmup;	/* slave frames before the target is taken */
+		double level;		/* averaged slave fill level */
+		double target;
+		double integ;
+	} drift;
+	/* history of the committed periods, newest at hist_head - 1 */
+	struct snd_pcm_rate_period *hist;
+	char *hist_state;		/* converter states before the periods */
+	size_t state_size;
+	unsigned int hist_size, hist_head, hist_count;
 };
 
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
 
+#define SND_PCM_RATE_MAX_PPM	1000	/* limit of the ratio adjustment */
+
+/*
+ * drift controller time constants in seconds; slow enough to ignore
+ * the period sized jitter of the fill level, Ti = 4 * Tp for a
+ * critically damped loop
+ */
+#define DRIFT_AVERAGE		2.0	/* averaging of the fill level */
+#define DRIFT_WARMUP		2.0	/* until the target level is taken */
+#define DRIFT_TP		30.0	/* proportional */
+#define DRIFT_TI		120.0	/* integral */
+
 #endif /* DOC_HIDDEN */
 
+/* the formats the converter takes on the client side */
+static void snd_pcm_rate_client_formats(snd_pcm_t *pcm, snd_pcm_format_mask_t *mask)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+	uint64_t formats;
+
+	snd_mask_none(mask);
+	if (rate->sformat != SND_PCM_FORMAT_UNKNOWN &&
+	    ((rate->format_flags & SND_PCM_RATE_FLAG_SYNC_FORMATS) ||
+	     !snd_pcm_format_linear(rate->sformat))) {
+		snd_mask_set(mask, rate->sformat);
+		return;
+	}
+	if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
+		formats = rate->in_formats & rate->out_formats;
+	else if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		formats = rate->in_formats;
+	else
+		formats = rate->out_formats;
+	mask->bits[0] = (uint32_t)formats;
+	mask->bits[1] = (uint32_t)(formats >> 32);
+	/* a float format must be the same on both sides */
+	if (rate->sformat != SND_PCM_FORMAT_UNKNOWN)
+		snd_mask_intersect(mask, &linear);
+}
+
 static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
-	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	snd_pcm_format_mask_t format_mask;
+	snd_pcm_rate_client_formats(pcm, &format_mask);
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
@@ -119,6 +186,11 @@ static int snd_pcm_rate_hw_refine_sprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *
 	if (rate->sformat != SND_PCM_FORMAT_UNKNOWN) {
 		_snd_pcm_hw_params_set_format(sparams, rate->sformat);
 		_snd_pcm_hw_params_set_subformat(sparams, SND_PCM_SUBFORMAT_STD);
+	} else {
+		snd_pcm_format_mask_t format_mask;
+		snd_pcm_rate_client_formats(pcm, &format_mask);
+		_snd_pcm_hw_param_set_mask(sparams, SND_PCM_HW_PARAM_FORMAT,
+					   &format_mask);
 	}
 	_snd_pcm_hw_param_set_minmax(sparams, SND_PCM_HW_PARAM_RATE,
 				     rate->srate, 0, rate->srate + 1, -1);
@@ -286,24 +358,29 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	if (err < 0)
 		return err;
 
-	rate->pareas = malloc(2 * channels * sizeof(*rate->pareas));
+	/* the slave periods are stretched in the variable ratio mode */
+	rate->slip_max = 0;
+	if (rate->format_flags & SND_PCM_RATE_FLAG_VARIABLE_FRAMES)
+		rate->slip_max = SND_PCM_RATE_VARIABLE_SLIP(sinfo->period_size);
+
+	rate->pareas = calloc(2 * channels, sizeof(*rate->pareas));
 	if (rate->pareas == NULL)
 		goto error;
 
 	cwidth = snd_pcm_format_physical_width(cinfo->format);
 	swidth = snd_pcm_format_physical_width(sinfo->format);
-	rate->pareas[0].addr = malloc(((cwidth * channels * cinfo->period_size) / 8) +
-				      ((swidth * channels * sinfo->period_size) / 8));
-	if (rate->pareas[0].addr == NULL)
+	if (snd_pcm_scratch_reserve(pcm, SND_PCM_SCRATCH_PERIOD,
+				    (cwidth * channels * cinfo->period_size) / 8) < 0)
 		goto error;
-
+	/* the slave period is kept over the slave calls, it is no scratch */
 	rate->sareas = rate->pareas + channels;
-	rate->sareas[0].addr = (char *)rate->pareas[0].addr + ((cwidth * channels * cinfo->period_size) / 8);
+	rate->sareas[0].addr = malloc((swidth * channels * (sinfo->period_size + rate->slip_max)) / 8);
+	if (rate->sareas[0].addr == NULL)
+		goto error;
 	for (chn = 0; chn < channels; chn++) {
-		rate->pareas[chn].addr = (char *)rate->pareas[0].addr + (cwidth * chn * cinfo->period_size) / 8;
 		rate->pareas[chn].first = 0;
 		rate->pareas[chn].step = cwidth;
-		rate->sareas[chn].addr = (char *)rate->sareas[0].addr + (swidth * chn * sinfo->period_size) / 8;
+		rate->sareas[chn].addr = (char *)rate->sareas[0].addr + (swidth * chn * (sinfo->period_size + rate->slip_max)) / 8;
 		rate->sareas[chn].first = 0;
 		rate->sareas[chn].step = swidth;
 	}
@@ -311,11 +388,24 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	if (rate->ops.convert_s16) {
 		rate->get_idx = snd_pcm_linear_get_index(rate->info.in.format, SND_PCM_FORMAT_S16);
 		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, rate->info.out.format);
-		free(rate->src_buf);
-		rate->src_buf = malloc(channels * rate->info.in.period_size * 2);
-		free(rate->dst_buf);
-		rate->dst_buf = malloc(channels * rate->info.out.period_size * 2);
-		if (! rate->src_buf || ! rate->dst_buf)
+		if (snd_pcm_scratch_reserve(pcm, SND_PCM_SCRATCH_PING,
+					    channels * (rate->info.in.period_size + rate->slip_max) * 2) < 0 ||
+		    snd_pcm_scratch_reserve(pcm, SND_PCM_SCRATCH_PONG,
+					    channels * (rate->info.out.period_size + rate->slip_max) * 2) < 0)
+			goto error;
+	}
+
+	/* converter snapshots for rewinding the committed periods */
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    rate->plugin_version >= 0x010003 && rate->ops.get_state_size &&
+	    rate->ops.save_state && rate->ops.restore_state) {
+		rate->state_size = rate->ops.get_state_size(rate->obj);
+		rate->hist_size = cinfo->buffer_size / cinfo->period_size + 1;
+		free(rate->hist);
+		free(rate->hist_state);
+		rate->hist = calloc(rate->hist_size, sizeof(*rate->hist));
+		rate->hist_state = malloc(rate->hist_size * rate->state_size + 1);
+		if (! rate->hist || ! rate->hist_state)
 			goto error;
 	}
 
@@ -323,10 +413,16 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 
  error:
 	if (rate->pareas) {
-		free(rate->pareas[0].addr);
+		if (rate->sareas)
+			free(rate->sareas[0].addr);
 		free(rate->pareas);
 		rate->pareas = NULL;
+		rate->sareas = NULL;
 	}
+	free(rate->hist);
+	free(rate->hist_state);
+	rate->hist = NULL;
+	rate->hist_state = NULL;
 	if (rate->ops.free)
 		rate->ops.free(rate->obj);
 	return -ENOMEM;
@@ -336,16 +432,17 @@ static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	if (rate->pareas) {
-		free(rate->pareas[0].addr);
+		free(rate->sareas[0].addr);
 		free(rate->pareas);
 		rate->pareas = NULL;
 		rate->sareas = NULL;
 	}
 	if (rate->ops.free)
 		rate->ops.free(rate->obj);
-	free(rate->src_buf);
-	free(rate->dst_buf);
-	rate->src_buf = rate->dst_buf = NULL;
+	free(rate->hist);
+	free(rate->hist_state);
+	rate->hist = NULL;
+	rate->hist_state = NULL;
 	return snd_pcm_hw_free(rate->gen.slave);
 }
 
@@ -423,6 +520,17 @@ static int snd_pcm_rate_init(snd_pcm_t *pcm)
 		rate->ops.reset(rate->obj);
 	rate->last_commit_ptr = 0;
 	rate->start_pending = 0;
+	rate->slip_acc = 0;
+	rate->slip_pending = 0;
+	rate->slave_pos = 0;
+	rate->hist_head = 0;
+	rate->hist_count = 0;
+	if (rate->drift.enabled) {
+		rate->ratio_ppm = 0;
+		rate->drift.running = 0;
+		rate->drift.warmup = DRIFT_WARMUP * rate->gen.slave->rate;
+		rate->drift.integ = 0;
+	}
 	return 0;
 }
 
@@ -502,31 +610,24 @@ static void convert_from_s16(snd_pcm_rate_t *rate, const int16_t *buf,
 	}
 }
 
-static void do_convert(const snd_pcm_channel_area_t *dst_areas,
+/* the S16 samples are staged in the ping-pong scratch buffers */
+static void do_convert(snd_pcm_t *pcm,
+		       const snd_pcm_channel_area_t *dst_areas,
 		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		       const snd_pcm_channel_area_t *src_areas,
 		       snd_pcm_uframes_t src_offset, unsigned int src_frames,
-		       unsigned int channels,
-		       snd_pcm_rate_t *rate)
+		       unsigned int channels)
 {
+	snd_pcm_rate_t *rate = pcm->private_data;
+
 	if (rate->ops.convert_s16) {
-		const int16_t *src;
-		int16_t *dst;
-		if (! rate->src_buf)
-			src = (int16_t *)src_areas->addr + src_offset * channels;
-		else {
-			convert_to_s16(rate, rate->src_buf, src_areas, src_offset,
-				       src_frames, channels);
-			src = rate->src_buf;
-		}
-		if (! rate->dst_buf)
-			dst = (int16_t *)dst_areas->addr + dst_offset * channels;
-		else
-			dst = rate->dst_buf;
+		int16_t *src = snd_pcm_scratch(pcm, SND_PCM_SCRATCH_PING);
+		int16_t *dst = snd_pcm_scratch(pcm, SND_PCM_SCRATCH_PONG);
+		convert_to_s16(rate, src, src_areas, src_offset,
+			       src_frames, channels);
 		rate->ops.convert_s16(rate->obj, dst, dst_frames, src, src_frames);
-		if (dst == rate->dst_buf)
-			convert_from_s16(rate, rate->dst_buf, dst_areas, dst_offset,
-					 dst_frames, channels);
+		convert_from_s16(rate, dst, dst_areas, dst_offset,
+				 dst_frames, channels);
 	} else {
 		rate->ops.convert(rate->obj, dst_areas, dst_offset, dst_frames,
 				   src_areas, src_offset, src_frames);
@@ -538,12 +639,12 @@ snd_pcm_rate_write_areas1(snd_pcm_t *pcm,
 			 const snd_pcm_channel_area_t *areas,
 			 snd_pcm_uframes_t offset,
 			 const snd_pcm_channel_area_t *slave_areas,
-			 snd_pcm_uframes_t slave_offset)
+			 snd_pcm_uframes_t slave_offset,
+			 snd_pcm_uframes_t slave_size)
 {
-	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(slave_areas, slave_offset, rate->gen.slave->period_size,
+	do_convert(pcm, slave_areas, slave_offset, slave_size,
 		   areas, offset, pcm->period_size,
-		   pcm->channels, rate);
+		   pcm->channels);
 }
 
 static inline void
@@ -551,12 +652,102 @@ snd_pcm_rate_read_areas1(snd_pcm_t *pcm,
 			 const snd_pcm_channel_area_t *areas,
 			 snd_pcm_uframes_t offset,
 			 const snd_pcm_channel_area_t *slave_areas,
-			 snd_pcm_uframes_t slave_offset)
+			 snd_pcm_uframes_t slave_offset,
+			 snd_pcm_uframes_t slave_size)
+{
+	do_convert(pcm, areas, offset, pcm->period_size,
+		   slave_areas, slave_offset, slave_size,
+		   pcm->channels);
+}
+
+/* the areas of a client period in the scratch buffers */
+static const snd_pcm_channel_area_t *snd_pcm_rate_period_areas(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	char *buf = snd_pcm_scratch(pcm, SND_PCM_SCRATCH_PERIOD);
+	unsigned int chn;
+
+	for (chn = 0; chn < pcm->channels; chn++)
+		rate->pareas[chn].addr = buf + (pcm->sample_bits * chn * pcm->period_size) / 8;
+	return rate->pareas;
+}
+
+/* the slave frames for the next period with the ratio adjustment */
+static snd_pcm_uframes_t snd_pcm_rate_slave_period(snd_pcm_rate_t *rate)
+{
+	snd_pcm_uframes_t size = rate->gen.slave->period_size;
+	snd_pcm_sframes_t slip;
+
+	if (!rate->ratio_ppm && !rate->slip_acc)
+		return size;
+	slip = (rate->slip_acc + (long long)rate->ratio_ppm * size) / 1000000;
+	if (slip > (snd_pcm_sframes_t)rate->slip_max)
+		slip = rate->slip_max;
+	else if (slip < -(snd_pcm_sframes_t)rate->slip_max)
+		slip = -(snd_pcm_sframes_t)rate->slip_max;
+	return size + slip;
+}
+
+/* a period of slave_size frames was transferred */
+static void snd_pcm_rate_slip(snd_pcm_t *pcm, snd_pcm_uframes_t slave_size)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(areas, offset, pcm->period_size,
-		   slave_areas, slave_offset, rate->gen.slave->period_size,
-		   pcm->channels, rate);
+	snd_pcm_uframes_t size = rate->gen.slave->period_size;
+	snd_pcm_sframes_t slip = slave_size - size;
+	long long limit = (long long)rate->slip_max * 1000000;
+
+	rate->slip_acc += (long long)rate->ratio_ppm * size - slip * 1000000LL;
+	if (rate->slip_acc > limit)
+		rate->slip_acc = limit;
+	else if (rate->slip_acc < -limit)
+		rate->slip_acc = -limit;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		rate->slip_pending += slip;
+}
+
+/*
+ * PI controller holding the buffered frames (slave and client side, in
+ * slave frames) at the level seen after the warmup; frames is the time
+ * step in slave frames
+ */
+static void snd_pcm_rate_drift_update(snd_pcm_t *pcm, snd_pcm_uframes_t level,
+				      snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	unsigned int srate = rate->gen.slave->rate;
+	double dt = (double)frames / srate;
+	double k = dt / DRIFT_AVERAGE;
+	double e, integ, ppm;
+
+	if (snd_pcm_state(rate->gen.slave) != SND_PCM_STATE_RUNNING)
+		return;
+	if (!rate->drift.running) {
+		rate->drift.running = 1;
+		rate->drift.level = level;
+	} else
+		rate->drift.level += ((double)level - rate->drift.level) * (k < 1 ? k : 1);
+	if (rate->drift.warmup) {
+		if (rate->drift.warmup > frames) {
+			rate->drift.warmup -= frames;
+			return;
+		}
+		rate->drift.warmup = 0;
+		rate->drift.target = rate->drift.level;
+		return;
+	}
+	e = rate->drift.level - rate->drift.target;
+	/* a growing playback queue needs less slave frames per period */
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		e = -e;
+	integ = rate->drift.integ + e * dt;
+	ppm = (e + integ / DRIFT_TI) * 1e6 / (srate * DRIFT_TP);
+	if (ppm > rate->drift.max_ppm)
+		ppm = rate->drift.max_ppm;
+	else if (ppm < -rate->drift.max_ppm)
+		ppm = -rate->drift.max_ppm;
+	else
+		rate->drift.integ = integ;
+	rate->ratio_ppm = ppm < 0 ? ppm - 0.5 : ppm + 0.5;
 }
 
 static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_ptr)
@@ -573,7 +764,21 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 		slave_hw_ptr_diff += rate->gen.slave->boundary; /* slave boundary wraparound */
 	else if (slave_hw_ptr_diff == 0)
 		return;
-	last_slave_hw_ptr_frac = rate->last_slave_hw_ptr % rate->gen.slave->period_size;
+	rate->last_slave_hw_ptr = slave_hw_ptr;
+	/* frames added to the stretched periods don't advance the client */
+	if (rate->slip_pending > 0) {
+		snd_pcm_sframes_t skip = rate->slip_pending;
+		if (skip > slave_hw_ptr_diff)
+			skip = slave_hw_ptr_diff;
+		rate->slip_pending -= skip;
+		slave_hw_ptr_diff -= skip;
+		if (slave_hw_ptr_diff == 0)
+			return;
+	} else if (rate->slip_pending < 0) {
+		slave_hw_ptr_diff -= rate->slip_pending;
+		rate->slip_pending = 0;
+	}
+	last_slave_hw_ptr_frac = rate->slave_pos % rate->gen.slave->period_size;
 	/* While handling fraction part fo slave period, rounded value will be
 	 * introduced by input_frames().
 	 * To eliminate rounding issue on rate->hw_ptr, subtract last rounded
@@ -587,7 +792,7 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 			(((last_slave_hw_ptr_frac + slave_hw_ptr_diff) / rate->gen.slave->period_size) * pcm->period_size) -
 			rate->ops.input_frames(rate->obj, last_slave_hw_ptr_frac) +
 			rate->ops.input_frames(rate->obj, (last_slave_hw_ptr_frac + slave_hw_ptr_diff) % rate->gen.slave->period_size));
-	rate->last_slave_hw_ptr = slave_hw_ptr;
+	rate->slave_pos = (rate->slave_pos + slave_hw_ptr_diff) % rate->gen.slave->boundary;
 
 	rate->hw_ptr %= pcm->boundary;
 }
@@ -675,26 +880,34 @@ static int snd_pcm_rate_reset(snd_pcm_t *pcm)
 	return 0;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
-{
-	return 0;
-}
-
-static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
-{
-	return 0;
-}
-
-static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                             snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+/* saves the state before the next period is committed */
+static void snd_pcm_rate_save_period(snd_pcm_rate_t *rate)
 {
-        return 0;
+	if (!rate->hist)
+		return;
+	rate->hist[rate->hist_head].slip_acc = rate->slip_acc;
+	if (rate->state_size)
+		rate->ops.save_state(rate->obj, rate->hist_state +
+				     rate->hist_head * rate->state_size);
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                              snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+/* the period saved last was committed (slave_size > 0) or not */
+static void snd_pcm_rate_push_period(snd_pcm_rate_t *rate,
+				     snd_pcm_uframes_t slave_size)
 {
-        return 0;
+	if (!rate->hist)
+		return;
+	if (!slave_size) {
+		/* the converted data was dropped, so is the state change */
+		if (rate->state_size)
+			rate->ops.restore_state(rate->obj, rate->hist_state +
+						rate->hist_head * rate->state_size);
+		return;
+	}
+	rate->hist[rate->hist_head].slave_size = slave_size;
+	rate->hist_head = (rate->hist_head + 1) % rate->hist_size;
+	if (rate->hist_count < rate->hist_size)
+		rate->hist_count++;
 }
 
 static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
@@ -707,19 +920,23 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 	const snd_pcm_channel_area_t *slave_areas;
 	snd_pcm_uframes_t slave_offset, xfer;
 	snd_pcm_uframes_t slave_frames = ULONG_MAX;
+	snd_pcm_uframes_t convert_size;
 	snd_pcm_sframes_t result;
 
+	/* a partial period (drain) is still converted as a whole */
+	convert_size = size == pcm->period_size ? slave_size : rate->gen.slave->period_size;
 	areas = snd_pcm_mmap_areas(pcm);
 	if (cont >= size) {
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
-		if (slave_frames < slave_size) {
-			snd_pcm_rate_write_areas1(pcm, areas, appl_offset, rate->sareas, 0);
+		if (slave_frames < convert_size) {
+			snd_pcm_rate_write_areas1(pcm, areas, appl_offset, rate->sareas, 0,
+						  convert_size);
 			goto __partial;
 		}
 		snd_pcm_rate_write_areas1(pcm, areas, appl_offset,
-					  slave_areas, slave_offset);
+					  slave_areas, slave_offset, convert_size);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, slave_size);
 		if (result < (snd_pcm_sframes_t)slave_size) {
 			if (result < 0)
@@ -730,16 +947,19 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 			return 0;
 		}
 	} else {
-		snd_pcm_areas_copy(rate->pareas, 0,
+		const snd_pcm_channel_area_t *pareas = snd_pcm_rate_period_areas(pcm);
+
+		snd_pcm_areas_copy(pareas, 0,
 				   areas, appl_offset,
 				   pcm->channels, cont,
 				   pcm->format);
-		snd_pcm_areas_copy(rate->pareas, cont,
+		snd_pcm_areas_copy(pareas, cont,
 				   areas, 0,
 				   pcm->channels, size - cont,
 				   pcm->format);
 
-		snd_pcm_rate_write_areas1(pcm, rate->pareas, 0, rate->sareas, 0);
+		snd_pcm_rate_write_areas1(pcm, pareas, 0, rate->sareas, 0,
+					  convert_size);
 
 		/* ok, commit first fragment */
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
@@ -804,15 +1024,17 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 	return 1;
 }
 
-static int snd_pcm_rate_commit_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t appl_offset)
+static int snd_pcm_rate_commit_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t appl_offset,
+					   snd_pcm_uframes_t slave_size)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
 	return snd_pcm_rate_commit_area(pcm, rate, appl_offset, pcm->period_size,
-					rate->gen.slave->period_size);
+					slave_size);
 }
 
-static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_offset)
+static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_offset,
+					 snd_pcm_uframes_t slave_size)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	snd_pcm_uframes_t cont = pcm->buffer_size - hw_offset;
@@ -827,12 +1049,12 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
-		if (slave_frames < rate->gen.slave->period_size)
+		if (slave_frames < slave_size)
 			goto __partial;
 		snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
-					 slave_areas, slave_offset);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->gen.slave->period_size);
-		if (result < (snd_pcm_sframes_t)rate->gen.slave->period_size) {
+					 slave_areas, slave_offset, slave_size);
+		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, slave_size);
+		if (result < (snd_pcm_sframes_t)slave_size) {
 			if (result < 0)
 				return result;
 			result = snd_pcm_rewind(rate->gen.slave, result);
@@ -848,8 +1070,8 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 	      __partial:
 		xfer = 0;
 		cont = slave_frames;
-		if (cont > rate->gen.slave->period_size)
-			cont = rate->gen.slave->period_size;
+		if (cont > slave_size)
+			cont = slave_size;
 		snd_pcm_areas_copy(rate->sareas, 0,
 				   slave_areas, slave_offset,
 				   pcm->channels, cont,
@@ -865,11 +1087,11 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		}
 		xfer = cont;
 
-		if (xfer == rate->gen.slave->period_size)
+		if (xfer == slave_size)
 			goto __transfer;
 
 		/* grab second fragment */
-		cont = rate->gen.slave->period_size - cont;
+		cont = slave_size - cont;
 		slave_frames = cont;
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
@@ -898,17 +1120,19 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		cont = pcm->buffer_size - hw_offset;
 		if (cont >= pcm->period_size) {
 			snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
-						 rate->sareas, 0);
+						 rate->sareas, 0, slave_size);
 		} else {
+			const snd_pcm_channel_area_t *pareas = snd_pcm_rate_period_areas(pcm);
+
 			snd_pcm_rate_read_areas1(pcm,
-						 rate->pareas, 0,
-						 rate->sareas, 0);
+						 pareas, 0,
+						 rate->sareas, 0, slave_size);
 			snd_pcm_areas_copy(areas, hw_offset,
-					   rate->pareas, 0,
+					   pareas, 0,
 					   pcm->channels, cont,
 					   pcm->format);
 			snd_pcm_areas_copy(areas, 0,
-					   rate->pareas, cont,
+					   pareas, cont,
 					   pcm->channels, pcm->period_size - cont,
 					   pcm->format);
 		}
@@ -920,7 +1144,7 @@ static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t app
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	snd_pcm_t *slave = rate->gen.slave;
-	snd_pcm_uframes_t xfer;
+	snd_pcm_uframes_t xfer, period, done = 0;
 	snd_pcm_sframes_t slave_size;
 	int err;
 
@@ -932,22 +1156,160 @@ static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t app
 		xfer = appl_ptr - rate->last_commit_ptr + pcm->boundary;
 	else
 		xfer = appl_ptr - rate->last_commit_ptr;
-	while (xfer >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= rate->gen.slave->period_size) {
-		err = snd_pcm_rate_commit_next_period(pcm, rate->last_commit_ptr % pcm->buffer_size);
+	while (xfer >= pcm->period_size) {
+		period = snd_pcm_rate_slave_period(rate);
+		if ((snd_pcm_uframes_t)slave_size < period)
+			break;
+		snd_pcm_rate_save_period(rate);
+		err = snd_pcm_rate_commit_next_period(pcm, rate->last_commit_ptr % pcm->buffer_size,
+						      period);
+		snd_pcm_rate_push_period(rate, err > 0 ? period : 0);
 		if (err == 0)
 			break;
 		if (err < 0)
 			return err;
+		snd_pcm_rate_slip(pcm, period);
 		xfer -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
+		slave_size -= period;
+		done += period;
 		rate->last_commit_ptr += pcm->period_size;
 		if (rate->last_commit_ptr >= pcm->boundary)
 			rate->last_commit_ptr = 0;
 	}
+	if (done && rate->drift.enabled)
+		snd_pcm_rate_drift_update(pcm, slave->buffer_size - slave_size +
+					  rate->ops.output_frames(rate->obj, xfer),
+					  done);
 	return 0;
 }
 
+/*
+ * up to frames of playback to rewind: the frames not committed yet and
+ * the newest committed periods which the slave can still rewind
+ */
+static snd_pcm_uframes_t snd_pcm_rate_rewind_periods(snd_pcm_t *pcm,
+						     snd_pcm_uframes_t frames,
+						     unsigned int *periodsp,
+						     snd_pcm_uframes_t *slave_framesp)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_uframes_t pending = snd_pcm_rate_playback_internal_delay(pcm);
+	snd_pcm_uframes_t limit = snd_pcm_mmap_hw_rewindable(pcm);
+	snd_pcm_uframes_t slave_frames = 0;
+	snd_pcm_sframes_t slave_avail = 0;
+	unsigned int periods = 0, idx = rate->hist_head;
+
+	if (frames > limit)
+		frames = limit;
+	if (frames > pending && rate->hist_count)
+		slave_avail = snd_pcm_rewindable(rate->gen.slave);
+	while (frames > pending + periods * pcm->period_size &&
+	       periods < rate->hist_count) {
+		idx = idx ? idx - 1 : rate->hist_size - 1;
+		if (slave_avail < 0 ||
+		    slave_frames + rate->hist[idx].slave_size > (snd_pcm_uframes_t)slave_avail ||
+		    pending + (periods + 1) * pcm->period_size > limit)
+			break;
+		slave_frames += rate->hist[idx].slave_size;
+		periods++;
+	}
+	if (frames > pending + periods * pcm->period_size)
+		frames = pending + periods * pcm->period_size;
+	*periodsp = periods;
+	*slave_framesp = slave_frames;
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm)
+{
+	snd_pcm_uframes_t slave_frames;
+	unsigned int periods;
+
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE)
+		return snd_pcm_mmap_hw_rewindable(pcm);
+	return snd_pcm_rate_rewind_periods(pcm, pcm->buffer_size,
+					   &periods, &slave_frames);
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm)
+{
+	return snd_pcm_mmap_avail(pcm);
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm,
+                                             snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_uframes_t slave_frames;
+	snd_pcm_sframes_t result;
+	unsigned int periods, idx;
+
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE) {
+		/* the converted frames are still in our buffer */
+		if (frames > snd_pcm_mmap_hw_rewindable(pcm))
+			frames = snd_pcm_mmap_hw_rewindable(pcm);
+		snd_pcm_mmap_appl_backward(pcm, frames);
+		return frames;
+	}
+
+	snd_pcm_rate_sync_hwptr(pcm);
+	frames = snd_pcm_rate_rewind_periods(pcm, frames, &periods, &slave_frames);
+	if (periods) {
+		result = snd_pcm_rewind(rate->gen.slave, slave_frames);
+		if (result < 0)
+			return result;
+		if ((snd_pcm_uframes_t)result != slave_frames) {
+			/* only whole periods can be taken back */
+			if (result > 0)
+				INTERNAL(snd_pcm_forward)(rate->gen.slave, result);
+			frames = snd_pcm_rate_playback_internal_delay(pcm);
+			periods = 0;
+		}
+	}
+	if (periods) {
+		/* back to the state before the oldest rewound period */
+		idx = rate->hist_head;
+		while (periods--) {
+			idx = idx ? idx - 1 : rate->hist_size - 1;
+			if (rate->slip_max)
+				rate->slip_pending -= (snd_pcm_sframes_t)rate->hist[idx].slave_size -
+						      (snd_pcm_sframes_t)rate->gen.slave->period_size;
+			rate->last_commit_ptr = rate->last_commit_ptr ?
+				rate->last_commit_ptr - pcm->period_size :
+				pcm->boundary - pcm->period_size;
+			rate->hist_count--;
+		}
+		rate->hist_head = idx;
+		rate->slip_acc = rate->hist[idx].slip_acc;
+		if (rate->state_size)
+			rate->ops.restore_state(rate->obj, rate->hist_state +
+						idx * rate->state_size);
+	}
+	snd_pcm_mmap_appl_backward(pcm, frames);
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm,
+                                              snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t avail = snd_pcm_mmap_avail(pcm);
+	int err;
+
+	if (avail < 0)
+		return avail;
+	if (frames > (snd_pcm_uframes_t)avail)
+		frames = avail;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		/* the skipped frames are converted as they are */
+		err = snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr + frames);
+		if (err < 0)
+			return err;
+	}
+	snd_pcm_mmap_appl_forward(pcm, frames);
+	return frames;
+}
+
 static snd_pcm_sframes_t snd_pcm_rate_mmap_commit(snd_pcm_t *pcm,
 						  snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						  snd_pcm_uframes_t size)
@@ -982,25 +1344,34 @@ static snd_pcm_sframes_t snd_pcm_rate_avail_update(snd_pcm_t *pcm)
 	snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr);
 	return snd_pcm_mmap_avail(pcm);
  _capture: {
-	snd_pcm_uframes_t xfer, hw_offset, size;
+	snd_pcm_uframes_t xfer, hw_offset, size, period, done = 0;
 	
 	xfer = snd_pcm_mmap_capture_avail(pcm);
 	size = pcm->buffer_size - xfer;
 	hw_offset = snd_pcm_mmap_hw_offset(pcm);
-	while (size >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= rate->gen.slave->period_size) {
-		int err = snd_pcm_rate_grab_next_period(pcm, hw_offset);
+	while (size >= pcm->period_size) {
+		int err;
+		period = snd_pcm_rate_slave_period(rate);
+		if ((snd_pcm_uframes_t)slave_size < period)
+			break;
+		err = snd_pcm_rate_grab_next_period(pcm, hw_offset, period);
 		if (err < 0)
 			return err;
 		if (err == 0)
 			return (snd_pcm_sframes_t)xfer;
+		snd_pcm_rate_slip(pcm, period);
 		xfer += pcm->period_size;
 		size -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
+		slave_size -= period;
+		done += period;
 		hw_offset += pcm->period_size;
 		hw_offset %= pcm->buffer_size;
 		snd_pcm_mmap_hw_forward(pcm, pcm->period_size);
 	}
+	if (done && rate->drift.enabled)
+		snd_pcm_rate_drift_update(pcm, slave_size +
+					  rate->ops.input_frames(rate->obj, xfer),
+					  done);
 	return (snd_pcm_sframes_t)xfer;
  }
 }
@@ -1060,6 +1431,8 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 		sw_params.avail_min = 1;
 		snd_pcm_sw_params(rate->gen.slave, &sw_params);
 
+		/* no rewinds after the drain */
+		rate->hist_count = 0;
 		size = rate->appl_ptr - rate->last_commit_ptr;
 		if (size > pcm->boundary)
 			size -= pcm->boundary;
@@ -1073,7 +1446,7 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 				break;
 			if (size > pcm->period_size) {
 				psize = pcm->period_size;
-				spsize = rate->gen.slave->period_size;
+				spsize = snd_pcm_rate_slave_period(rate);
 			} else {
 				psize = size;
 				spsize = rate->ops.output_frames(rate->obj, size);
@@ -1083,6 +1456,8 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 			commit_err = snd_pcm_rate_commit_area(pcm, rate, ofs,
 						 psize, spsize);
 			if (commit_err == 1) {
+				if (psize == pcm->period_size)
+					snd_pcm_rate_slip(pcm, spsize);
 				rate->last_commit_ptr += psize;
 				if (rate->last_commit_ptr >= pcm->boundary)
 					rate->last_commit_ptr = 0;
@@ -1189,6 +1564,11 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (rate->ops.dump)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
+	if (rate->drift.enabled)
+		snd_output_printf(out, "Drift compensation: %d ppm (max %d)\n",
+				  rate->ratio_ppm, rate->drift.max_ppm);
+	else if (rate->ratio_ppm)
+		snd_output_printf(out, "Ratio adjustment: %d ppm\n", rate->ratio_ppm);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1272,7 +1652,10 @@ const snd_config_t *snd_pcm_rate_get_default_converter(snd_config_t *root)
 #ifdef PIC
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	return strcmp(type, "linear") == 0 ||
+	       strcmp(type, "polyphase") == 0 ||
+	       strcmp(type, "polyphase_fast") == 0 ||
+	       strcmp(type, "polyphase_best") == 0;
 }
 
 static const char *const default_rate_plugins[] = {
@@ -1344,6 +1727,29 @@ static int rate_open_func(snd_pcm_rate_t *rate, const char *type, const snd_conf
 }
 #endif
 
+/* query the formats which ops.convert takes without a S16 pass and the flags */
+static void rate_query_formats(snd_pcm_rate_t *rate)
+{
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+
+	rate->in_formats = linear.bits[0] | ((uint64_t)linear.bits[1] << 32);
+	rate->out_formats = rate->in_formats;
+	rate->format_flags = 0;
+	if (rate->plugin_version < 0x010003 || !rate->ops.get_supported_formats)
+		return;
+	if (rate->ops.get_supported_formats(rate->obj, &rate->in_formats,
+					    &rate->out_formats,
+					    &rate->format_flags) < 0) {
+		rate->in_formats = rate->out_formats =
+			linear.bits[0] | ((uint64_t)linear.bits[1] << 32);
+		rate->format_flags = 0;
+	} else if (rate->ops.convert_s16) {
+		/* S16 converters take only the flags */
+		rate->in_formats = rate->out_formats =
+			linear.bits[0] | ((uint64_t)linear.bits[1] << 32);
+	}
+}
+
 /*
  * If the conf is an array of alternatives then the id of
  * the first element will be "0" (or maybe NULL). Otherwise assume it is
@@ -1395,11 +1801,15 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 #ifndef PIC
 	snd_pcm_rate_open_func_t open_func;
 	extern int SND_PCM_RATE_PLUGIN_ENTRY(linear) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
 #endif
 
 	assert(pcmp && slave);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1)
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    snd_pcm_format_float(sformat) != 1)
 		return -EINVAL;
 	rate = calloc(1, sizeof(snd_pcm_rate_t));
 	if (!rate) {
@@ -1471,14 +1881,25 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return -ENOENT;
 	}
 #else
-	type = "linear";
-	open_func = SND_PCM_RATE_PLUGIN_ENTRY(linear);
+	if (converter)
+		snd_config_get_string(converter, &type);
+	if (type && !strcmp(type, "polyphase"))
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(polyphase);
+	else if (type && !strcmp(type, "polyphase_fast"))
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast);
+	else if (type && !strcmp(type, "polyphase_best"))
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best);
+	else {
+		type = "linear";
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(linear);
+	}
 	err = open_func(SND_PCM_RATE_PLUGIN_VERSION, &rate->obj, &rate->ops);
 	if (err < 0) {
 		snd_pcm_free(pcm);
 		free(rate);
 		return err;
 	}
+	rate->plugin_version = rate->ops.version;
 #endif
 
 	if (! rate->ops.init || ! (rate->ops.convert || rate->ops.convert_s16) ||
@@ -1489,6 +1910,21 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	}
 
+	rate_query_formats(rate);
+	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
+	    (sformat >= 64 ||
+	     !((slave->stream == SND_PCM_STREAM_PLAYBACK ?
+		rate->out_formats : rate->in_formats) & (1ULL << sformat)))) {
+		/* e.g. a float slave with a S16 only converter */
+		if (rate->ops.close)
+			rate->ops.close(rate->obj);
+		if (rate->open_func)
+			snd_dlobj_cache_put(rate->open_func);
+		snd_pcm_free(pcm);
+		free(rate);
+		return -EINVAL;
+	}
+
 	pcm->ops = &snd_pcm_rate_ops;
 	pcm->fast_ops = &snd_pcm_rate_fast_ops;
 	pcm->private_data = rate;
@@ -1503,11 +1939,96 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/* the rate PCM itself or behind a plug or a simple conversion PCM */
+static snd_pcm_rate_t *snd_pcm_rate_find(snd_pcm_t *pcm)
+{
+	while (pcm) {
+		switch (pcm->type) {
+		case SND_PCM_TYPE_RATE:
+			return pcm->private_data;
+		case SND_PCM_TYPE_PLUG:
+		case SND_PCM_TYPE_LINEAR:
+		case SND_PCM_TYPE_LINEAR_FLOAT:
+		case SND_PCM_TYPE_ROUTE:
+		case SND_PCM_TYPE_MULAW:
+		case SND_PCM_TYPE_ALAW:
+		case SND_PCM_TYPE_ADPCM:
+		case SND_PCM_TYPE_SOFTVOL:
+			pcm = ((snd_pcm_generic_t *)pcm->private_data)->slave;
+			break;
+		default:
+			return NULL;
+		}
+	}
+	return NULL;
+}
+#endif
+
+/**
+ * \brief Adjusts the conversion ratio of a rate PCM
+ * \param pcm PCM handle, a rate PCM or a plug PCM with a rate conversion
+ * \param ppm the slave rate offset in parts per million
+ * \retval zero on success otherwise a negative error code
+ *
+ * The slave side produces (playback) or consumes (capture) ppm parts
+ * per million more frames than the nominal rate ratio, e.g. to follow
+ * a slave clock which runs slightly fast or slow.  The converter state
+ * is kept, the new ratio applies from the next period.  The limit is
+ * +-1000 ppm.  The converter must support the variable ratio mode
+ * (the built-in ones do), otherwise -ENOSYS is returned; -EBUSY is
+ * returned while the drift compensation controls the ratio.
+ */
+int snd_pcm_rate_set_ratio_ppm(snd_pcm_t *pcm, int ppm)
+{
+	snd_pcm_rate_t *rate = snd_pcm_rate_find(pcm);
+	int err = 0;
+
+	if (!rate)
+		return -EINVAL;
+	if (!(rate->format_flags & SND_PCM_RATE_FLAG_VARIABLE_FRAMES))
+		return -ENOSYS;
+	if (ppm < -SND_PCM_RATE_MAX_PPM || ppm > SND_PCM_RATE_MAX_PPM)
+		return -EINVAL;
+	snd_pcm_lock(pcm);
+	if (rate->drift.enabled)
+		err = -EBUSY;
+	else
+		rate->ratio_ppm = ppm;
+	snd_pcm_unlock(pcm);
+	return err;
+}
+
+/**
+ * \brief Returns the current conversion ratio adjustment of a rate PCM
+ * \param pcm PCM handle, a rate PCM or a plug PCM with a rate conversion
+ * \param ppm Returns the slave rate offset in parts per million
+ * \retval zero on success otherwise a negative error code
+ *
+ * With the drift compensation enabled, this is the value chosen by
+ * the controller.
+ */
+int snd_pcm_rate_get_ratio_ppm(snd_pcm_t *pcm, int *ppm)
+{
+	snd_pcm_rate_t *rate = snd_pcm_rate_find(pcm);
+
+	if (!rate)
+		return -EINVAL;
+	snd_pcm_lock(pcm);
+	*ppm = rate->ratio_ppm;
+	snd_pcm_unlock(pcm);
+	return 0;
+}
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_rate Plugin: Rate
 
-This plugin converts a stream rate. The input and output formats must be linear.
+This plugin converts a stream rate. The input and output formats must be linear,
+or the same float format on both sides when the converter handles it natively
+(the built-in linear converter does). Linear formats are passed to converters
+which process them natively, others work on S16 and the conversion from and to
+S16 is done by this plugin.
 
 \code
 pcm.name {
@@ -1531,14 +2052,41 @@ pcm.name {
 		name STR	# Convertor type
 		xxx yyy		# optional convertor-specific configuration
 	}
+	drift_compensation BOOL	# follow the slave clock (default no)
+	drift_max_ppm INT	# limit of the ratio adjustment (default 500)
 }
 \endcode
 
+With drift_compensation, the ratio is adjusted at runtime so that the
+fill level of the slave buffer stays where it was two seconds after
+the start: the slave period is stretched or shrunk by a few frames
+from time to time, by at most drift_max_ppm parts per million.  This
+keeps a stream in sync with a slave device running on an independent
+clock.  The same adjustment is available manually through
+snd_pcm_rate_set_ratio_ppm().  Both need a converter with the variable
+ratio mode; the built-in ones support it.
+
+The conversion works on whole periods.  A playback stream can be
+rewound into the periods already passed to the slave as long as the
+slave can rewind them and the converter can save and restore its
+state (the built-in ones can); otherwise only the frames of the
+unfinished period are rewindable.
+
+Besides the external converter plugins, two converters are built in:
+"linear" (linear interpolation, the last resort of the default list)
+and "polyphase", a polyphase Kaiser windowed-sinc filter with the
+coefficients precomputed at hw_params and vectorized inner loops.
+"polyphase_fast", "polyphase" and "polyphase_best" select the quality
+presets (16, 32 and 64 taps at the unity ratio with 64, 128 and 256
+table phases).  The filter is widened when downsampling.
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
   <LI>snd_pcm_rate_open()
   <LI>_snd_pcm_rate_open()
+  <LI>snd_pcm_rate_set_ratio_ppm()
+  <LI>snd_pcm_rate_get_ratio_ppm()
 </UL>
 
 */
@@ -1567,6 +2115,8 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int srate = -1;
 	const snd_config_t *converter = NULL;
+	int drift = 0;
+	long drift_max_ppm = 500;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1583,6 +2133,27 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 			converter = n;
 			continue;
 		}
+		if (strcmp(id, "drift_compensation") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("The field drift_compensation must be a boolean type");
+				return err;
+			}
+			drift = err;
+			continue;
+		}
+		if (strcmp(id, "drift_max_ppm") == 0) {
+			err = snd_config_get_integer(n, &drift_max_ppm);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (drift_max_ppm < 1 || drift_max_ppm > SND_PCM_RATE_MAX_PPM) {
+				SNDERR("drift_max_ppm out of range (1-%d)", SND_PCM_RATE_MAX_PPM);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1597,9 +2168,10 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1) {
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    snd_pcm_format_float(sformat) != 1) {
 	    	snd_config_delete(sconf);
-		SNDERR("slave format is not linear");
+		SNDERR("slave format is not linear or float");
 		return -EINVAL;
 	}
 	err = snd_pcm_open_slave(&spcm, root, sconf, stream, mode, conf);
@@ -1608,9 +2180,21 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_rate_open(pcmp, name, sformat, (unsigned int) srate,
 				converter, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	if (drift) {
+		snd_pcm_rate_t *rate = (*pcmp)->private_data;
+		if (!(rate->format_flags & SND_PCM_RATE_FLAG_VARIABLE_FRAMES)) {
+			SNDERR("rate converter doesn't support drift compensation");
+			snd_pcm_close(*pcmp);
+			return -EINVAL;
+		}
+		rate->drift.enabled = 1;
+		rate->drift.max_ppm = drift_max_ppm;
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_rate_open, SND_PCM_DLSYM_VERSION);
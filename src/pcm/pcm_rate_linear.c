@@ -27,24 +27,32 @@
 #include "pcm_rate.h"
 
 #include "plugin_ops.h"
+#include "pcm_simd.h"
 
 
 /* LINEAR_DIV needs to be large enough to handle resampling from 768000 -> 8000 */
 #define LINEAR_DIV_SHIFT 19
 #define LINEAR_DIV (1<<LINEAR_DIV_SHIFT)
 
+/* interpolates one interleaved S16 frame */
+typedef void (*linear_frame_s16_t)(int16_t *dst, const int16_t *old_frame,
+				   const int16_t *new_frame, unsigned int channels,
+				   int old_weight, int new_weight);
+
 struct rate_linear {
 	unsigned int get_idx;
 	unsigned int put_idx;
 	unsigned int pitch;
 	unsigned int pitch_shift;	/* for expand interpolation */
+	unsigned int src_frames, dst_frames;	/* nominal period sizes */
 	unsigned int channels;
-	int16_t *old_sample;
+	void *old_sample;	/* one int16_t, int32_t or float per channel */
 	void (*func)(struct rate_linear *rate,
 		     const snd_pcm_channel_area_t *dst_areas,
 		     snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		     const snd_pcm_channel_area_t *src_areas,
 		     snd_pcm_uframes_t src_offset, unsigned int src_frames);
+	linear_frame_s16_t frame_s16;	/* vectorized, NULL if not available */
 };
 
 static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
@@ -65,25 +73,212 @@ static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
 	return muldiv_near(frames, rate->pitch, LINEAR_DIV);
 }
 
+/*
+ * The S16 code for interleaved buffers walks the frames instead of the
+ * channels, so the position and the weights are computed once per frame
+ * and all channels of a frame are interpolated by one vector kernel.
+ * The results are bit-exact to the per-channel code.
+ */
+
+static void generic_frame_s16(int16_t *dst, const int16_t *old_frame,
+			      const int16_t *new_frame, unsigned int channels,
+			      int old_weight, int new_weight)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++)
+		dst[c] = (old_frame[c] * old_weight + new_frame[c] * new_weight) >> 16;
+}
+
+#if defined(SND_PCM_SIMD_X86)
+
+/*
+ * pmaddwd takes 16 bit factors, so the weights (up to 17 bit) are split
+ * to w = 256 * w_hi + w_lo and the two partial sums are combined again
+ */
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128i sse2_lerp_s16(__m128i pairs, __m128i w_hi, __m128i w_lo)
+{
+	__m128i v = _mm_add_epi32(_mm_slli_epi32(_mm_madd_epi16(pairs, w_hi), 8),
+				  _mm_madd_epi16(pairs, w_lo));
+
+	v = _mm_srai_epi32(v, 16);
+	/* keep the low 16 bits like the scalar store does */
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_frame_s16(int16_t *dst, const int16_t *old_frame,
+			   const int16_t *new_frame, unsigned int channels,
+			   int old_weight, int new_weight)
+{
+	/* (old, new) sample pairs meet (old_weight, new_weight) pairs */
+	__m128i w_hi = _mm_set1_epi32((int)(((uint32_t)(new_weight >> 8) << 16) |
+					    ((uint32_t)(old_weight >> 8) & 0xffff)));
+	__m128i w_lo = _mm_set1_epi32((int)(((uint32_t)(new_weight & 0xff) << 16) |
+					    (uint32_t)(old_weight & 0xff)));
+	__m128i o, n, lo, hi;
+	unsigned int c;
+
+	for (c = 0; c + 8 <= channels; c += 8) {
+		o = _mm_loadu_si128((const __m128i *)(old_frame + c));
+		n = _mm_loadu_si128((const __m128i *)(new_frame + c));
+		lo = sse2_lerp_s16(_mm_unpacklo_epi16(o, n), w_hi, w_lo);
+		hi = sse2_lerp_s16(_mm_unpackhi_epi16(o, n), w_hi, w_lo);
+		_mm_storeu_si128((__m128i *)(dst + c), _mm_packs_epi32(lo, hi));
+	}
+	if (c + 4 <= channels) {
+		o = _mm_loadl_epi64((const __m128i *)(old_frame + c));
+		n = _mm_loadl_epi64((const __m128i *)(new_frame + c));
+		lo = sse2_lerp_s16(_mm_unpacklo_epi16(o, n), w_hi, w_lo);
+		_mm_storel_epi64((__m128i *)(dst + c), _mm_packs_epi32(lo, lo));
+		c += 4;
+	}
+	if (c < channels)
+		generic_frame_s16(dst + c, old_frame + c, new_frame + c,
+				  channels - c, old_weight, new_weight);
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+static void neon_frame_s16(int16_t *dst, const int16_t *old_frame,
+			   const int16_t *new_frame, unsigned int channels,
+			   int old_weight, int new_weight)
+{
+	int32x4_t ow = vdupq_n_s32(old_weight), nw = vdupq_n_s32(new_weight);
+	int16x8_t o, n;
+	int32x4_t lo, hi;
+	unsigned int c;
+
+	for (c = 0; c + 8 <= channels; c += 8) {
+		o = vld1q_s16(old_frame + c);
+		n = vld1q_s16(new_frame + c);
+		lo = vmlaq_s32(vmulq_s32(vmovl_s16(vget_low_s16(o)), ow),
+			       vmovl_s16(vget_low_s16(n)), nw);
+		hi = vmlaq_s32(vmulq_s32(vmovl_s16(vget_high_s16(o)), ow),
+			       vmovl_s16(vget_high_s16(n)), nw);
+		/* vmovn keeps the low 16 bits like the scalar store does */
+		vst1q_s16(dst + c, vcombine_s16(vmovn_s32(vshrq_n_s32(lo, 16)),
+						vmovn_s32(vshrq_n_s32(hi, 16))));
+	}
+	if (c + 4 <= channels) {
+		lo = vmlaq_s32(vmulq_s32(vmovl_s16(vld1_s16(old_frame + c)), ow),
+			       vmovl_s16(vld1_s16(new_frame + c)), nw);
+		vst1_s16(dst + c, vmovn_s32(vshrq_n_s32(lo, 16)));
+		c += 4;
+	}
+	if (c < channels)
+		generic_frame_s16(dst + c, old_frame + c, new_frame + c,
+				  channels - c, old_weight, new_weight);
+}
+
+#endif
+
+static linear_frame_s16_t linear_select_frame_s16(void)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+
+#if defined(SND_PCM_SIMD_X86)
+	if (caps & SND_PCM_SIMD_SSE2)
+		return sse2_frame_s16;
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON)
+		return neon_frame_s16;
+#endif
+	(void)caps;
+	return NULL;
+}
+
+static void linear_expand_s16_interleaved(struct rate_linear *rate,
+					  int16_t *dst, unsigned int dst_frames,
+					  const int16_t *src, unsigned int src_frames)
+{
+	unsigned int channels = rate->channels;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int src_frames1 = 0;
+	unsigned int dst_frames1;
+	unsigned int pos = get_threshold;
+	int16_t *saved = rate->old_sample;
+	const int16_t *old_frame = saved;
+	const int16_t *new_frame = saved;
+	int old_weight, new_weight;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		if (pos >= get_threshold) {
+			pos -= get_threshold;
+			old_frame = new_frame;
+			if (src_frames1 < src_frames)
+				new_frame = src;
+		}
+		new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+		old_weight = 0x10000 - new_weight;
+		rate->frame_s16(dst, old_frame, new_frame, channels,
+				old_weight, new_weight);
+		dst += channels;
+		pos += LINEAR_DIV;
+		if (pos >= get_threshold) {
+			src += channels;
+			src_frames1++;
+		}
+	}
+	if (new_frame != saved)
+		memcpy(saved, new_frame, channels * sizeof(*saved));
+}
+
+static void linear_shrink_s16_interleaved(struct rate_linear *rate,
+					  int16_t *dst, unsigned int dst_frames,
+					  const int16_t *src, unsigned int src_frames)
+{
+	unsigned int channels = rate->channels;
+	unsigned int get_increment = rate->pitch;
+	unsigned int src_frames1;
+	unsigned int dst_frames1 = 0;
+	unsigned int pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+	const int16_t *old_frame = src;	/* has zero weight for the first sample */
+	const int16_t *new_frame;
+	int old_weight, new_weight;
+
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		new_frame = src;
+		src += channels;
+		pos += get_increment;
+		if (pos >= LINEAR_DIV) {
+			pos -= LINEAR_DIV;
+			old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+			new_weight = 0x10000 - old_weight;
+			rate->frame_s16(dst, old_frame, new_frame, channels,
+					old_weight, new_weight);
+			dst += channels;
+			dst_frames1++;
+			if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+				SNDERR("dst_frames overflow");
+				break;
+			}
+		}
+		old_frame = new_frame;
+	}
+}
+
 static void linear_expand(struct rate_linear *rate,
 			  const snd_pcm_channel_area_t *dst_areas,
 			  snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 			  const snd_pcm_channel_area_t *src_areas,
 			  snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
-#define GET16_LABELS
-#define PUT16_LABELS
+#define GET32_LABELS
+#define PUT32_LABELS
 #include "plugin_ops.h"
-#undef GET16_LABELS
-#undef PUT16_LABELS
-	void *get = get16_labels[rate->get_idx];
-	void *put = put16_labels[rate->put_idx];
+#undef GET32_LABELS
+#undef PUT32_LABELS
+	void *get = get32_labels[rate->get_idx];
+	void *put = put32_labels[rate->put_idx];
 	unsigned int get_threshold = rate->pitch;
 	unsigned int channel;
 	unsigned int src_frames1;
 	unsigned int dst_frames1;
-	int16_t sample = 0;
+	uint32_t sample = 0;
 	unsigned int pos;
+	int32_t *old_samples = rate->old_sample;
 	
 	for (channel = 0; channel < rate->channels; ++channel) {
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
@@ -91,8 +286,8 @@ static void linear_expand(struct rate_linear *rate,
 		const char *src;
 		char *dst;
 		int src_step, dst_step;
-		int16_t old_sample = 0;
-		int16_t new_sample;
+		int32_t old_sample = 0;
+		int32_t new_sample;
 		int old_weight, new_weight;
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
 		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
@@ -100,7 +295,7 @@ static void linear_expand(struct rate_linear *rate,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		src_frames1 = 0;
 		dst_frames1 = 0;
-		new_sample = rate->old_sample[channel];
+		new_sample = old_samples[channel];
 		pos = get_threshold;
 		while (dst_frames1 < dst_frames) {
 			if (pos >= get_threshold) {
@@ -108,20 +303,20 @@ static void linear_expand(struct rate_linear *rate,
 				old_sample = new_sample;
 				if (src_frames1 < src_frames) {
 					goto *get;
-#define GET16_END after_get
+#define GET32_END after_get
 #include "plugin_ops.h"
-#undef GET16_END
+#undef GET32_END
 				after_get:
 					new_sample = sample;
 				}
 			}
 			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
 			old_weight = 0x10000 - new_weight;
-			sample = (old_sample * old_weight + new_sample * new_weight) >> 16;
+			sample = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
 			goto *put;
-#define PUT16_END after_put
+#define PUT32_END after_put
 #include "plugin_ops.h"
-#undef PUT16_END
+#undef PUT32_END
 		after_put:
 			dst += dst_step;
 			dst_frames1++;
@@ -131,7 +326,7 @@ static void linear_expand(struct rate_linear *rate,
 				src_frames1++;
 			}
 		} 
-		rate->old_sample[channel] = new_sample;
+		old_samples[channel] = new_sample;
 	}
 }
 
@@ -147,6 +342,19 @@ static void linear_expand_s16(struct rate_linear *rate,
 	unsigned int dst_frames1;
 	unsigned int get_threshold = rate->pitch;
 	unsigned int pos;
+	int16_t *old_samples = rate->old_sample;
+
+	if (rate->frame_s16 && rate->channels >= 4) {
+		int16_t *dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+								 rate->channels, 16);
+		const int16_t *src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+								       rate->channels, 16);
+		if (dst && src) {
+			linear_expand_s16_interleaved(rate, dst, dst_frames,
+						      src, src_frames);
+			return;
+		}
+	}
 	
 	for (channel = 0; channel < rate->channels; ++channel) {
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
@@ -163,7 +371,7 @@ static void linear_expand_s16(struct rate_linear *rate,
 		dst_step = snd_pcm_channel_area_step(dst_area) >> 1;
 		src_frames1 = 0;
 		dst_frames1 = 0;
-		new_sample = rate->old_sample[channel];
+		new_sample = old_samples[channel];
 		pos = get_threshold;
 		while (dst_frames1 < dst_frames) {
 			if (pos >= get_threshold) {
@@ -183,7 +391,113 @@ static void linear_expand_s16(struct rate_linear *rate,
 				src_frames1++;
 			}
 		} 
-		rate->old_sample[channel] = new_sample;
+		old_samples[channel] = new_sample;
+	}
+}
+
+/* optimized version for S32 format */
+static void linear_expand_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int pos;
+	int32_t *old_samples = rate->old_sample;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample;
+		int old_weight, new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = old_samples[channel];
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+			old_weight = 0x10000 - new_weight;
+			*dst = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		}
+		old_samples[channel] = new_sample;
+	}
+}
+
+/* version for native float format */
+static void linear_expand_float(struct rate_linear *rate,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int pos;
+	float *old_samples = rate->old_sample;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0;
+		float new_sample;
+		int old_weight, new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = old_samples[channel];
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+			old_weight = 0x10000 - new_weight;
+			*dst = (old_sample * old_weight + new_sample * new_weight) * (1.0f / 0x10000);
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		}
+		old_samples[channel] = new_sample;
 	}
 }
 
@@ -193,18 +507,18 @@ static void linear_shrink(struct rate_linear *rate,
 			  const snd_pcm_channel_area_t *src_areas,
 			  snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
-#define GET16_LABELS
-#define PUT16_LABELS
+#define GET32_LABELS
+#define PUT32_LABELS
 #include "plugin_ops.h"
-#undef GET16_LABELS
-#undef PUT16_LABELS
-	void *get = get16_labels[rate->get_idx];
-	void *put = put16_labels[rate->put_idx];
+#undef GET32_LABELS
+#undef PUT32_LABELS
+	void *get = get32_labels[rate->get_idx];
+	void *put = put32_labels[rate->put_idx];
 	unsigned int get_increment = rate->pitch;
 	unsigned int channel;
 	unsigned int src_frames1;
 	unsigned int dst_frames1;
-	int16_t sample = 0;
+	uint32_t sample = 0;
 	unsigned int pos;
 
 	for (channel = 0; channel < rate->channels; ++channel) {
@@ -213,8 +527,8 @@ static void linear_shrink(struct rate_linear *rate,
 		const char *src;
 		char *dst;
 		int src_step, dst_step;
-		int16_t old_sample = 0;
-		int16_t new_sample = 0;
+		int32_t old_sample = 0;
+		int32_t new_sample = 0;
 		int old_weight, new_weight;
 		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
@@ -226,9 +540,9 @@ static void linear_shrink(struct rate_linear *rate,
 		while (src_frames1 < src_frames) {
 			
 			goto *get;
-#define GET16_END after_get
+#define GET32_END after_get
 #include "plugin_ops.h"
-#undef GET16_END
+#undef GET32_END
 		after_get:
 			new_sample = sample;
 			src += src_step;
@@ -238,11 +552,11 @@ static void linear_shrink(struct rate_linear *rate,
 				pos -= LINEAR_DIV;
 				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
 				new_weight = 0x10000 - old_weight;
-				sample = (old_sample * old_weight + new_sample * new_weight) >> 16;
+				sample = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
 				goto *put;
-#define PUT16_END after_put
+#define PUT32_END after_put
 #include "plugin_ops.h"
-#undef PUT16_END
+#undef PUT32_END
 			after_put:
 				dst += dst_step;
 				dst_frames1++;
@@ -269,6 +583,18 @@ static void linear_shrink_s16(struct rate_linear *rate,
 	unsigned int dst_frames1;
 	unsigned int pos = 0;
 
+	if (rate->frame_s16 && rate->channels >= 4) {
+		int16_t *dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+								 rate->channels, 16);
+		const int16_t *src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+								       rate->channels, 16);
+		if (dst && src) {
+			linear_shrink_s16_interleaved(rate, dst, dst_frames,
+						      src, src_frames);
+			return;
+		}
+	}
+
 	for (channel = 0; channel < rate->channels; ++channel) {
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
 		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
@@ -308,6 +634,142 @@ static void linear_shrink_s16(struct rate_linear *rate,
 	}
 }
 
+/* optimized version for S32 format */
+static void linear_shrink_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample = 0;
+		int old_weight, new_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+				new_weight = 0x10000 - old_weight;
+				*dst = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+/* version for native float format */
+static void linear_shrink_float(struct rate_linear *rate,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0;
+		float new_sample = 0;
+		int old_weight, new_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+				new_weight = 0x10000 - old_weight;
+				*dst = (old_sample * old_weight + new_sample * new_weight) * (1.0f / 0x10000);
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+/*
+ * pitch for a period of src_frames to dst_frames: the ratio of the
+ * sizes, kept in the range where expand reads exactly src_frames and
+ * shrink writes exactly dst_frames
+ */
+static void linear_period_pitch(struct rate_linear *rate,
+				unsigned int dst_frames, unsigned int src_frames)
+{
+	uint64_t pitch, lo, hi;
+
+	pitch = ((uint64_t)dst_frames * LINEAR_DIV + src_frames / 2) / src_frames;
+	if (rate->pitch >= LINEAR_DIV) {
+		/* 1 + (dst_frames - 1) * LINEAR_DIV / pitch reads */
+		lo = (uint64_t)(dst_frames - 1) * LINEAR_DIV / src_frames + 1;
+		hi = (uint64_t)(dst_frames - 1) * LINEAR_DIV / (src_frames - 1);
+	} else {
+		/* 1 + (src_frames - 1) * pitch / LINEAR_DIV writes */
+		lo = ((uint64_t)(dst_frames - 1) * LINEAR_DIV + src_frames - 2) /
+			(src_frames - 1);
+		hi = ((uint64_t)dst_frames * LINEAR_DIV + src_frames - 2) /
+			(src_frames - 1) - 1;
+	}
+	if (pitch < lo)
+		pitch = lo;
+	else if (pitch > hi)
+		pitch = hi;
+	rate->pitch = pitch;
+	if (pitch >= LINEAR_DIV) {
+		rate->pitch_shift = 0;
+		while ((rate->pitch >> rate->pitch_shift) >= (1 << 16))
+			rate->pitch_shift++;
+	}
+}
+
 static void linear_convert(void *obj, 
 			   const snd_pcm_channel_area_t *dst_areas,
 			   snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -315,8 +777,17 @@ static void linear_convert(void *obj,
 			   snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
 	struct rate_linear *rate = obj;
+	unsigned int pitch = rate->pitch;
+	unsigned int pitch_shift = rate->pitch_shift;
+
+	/* a stretched period (variable ratio) gets its own pitch */
+	if ((src_frames != rate->src_frames || dst_frames != rate->dst_frames) &&
+	    src_frames > 1 && dst_frames > 1)
+		linear_period_pitch(rate, dst_frames, src_frames);
 	rate->func(rate, dst_areas, dst_offset, dst_frames,
 		   src_areas, src_offset, src_frames);
+	rate->pitch = pitch;
+	rate->pitch_shift = pitch_shift;
 }
 
 static void linear_free(void *obj)
@@ -331,17 +802,36 @@ static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 {
 	struct rate_linear *rate = obj;
 
-	rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S16);
-	rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, info->out.format);
+	if (info->in.format != info->out.format &&
+	    (info->in.format == SND_PCM_FORMAT_FLOAT ||
+	     info->out.format == SND_PCM_FORMAT_FLOAT))
+		return -EINVAL;
+	/* other linear formats are handled at 32 bit */
+	if (info->in.format != SND_PCM_FORMAT_FLOAT) {
+		rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S32);
+		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, info->out.format);
+	}
 	if (info->in.rate < info->out.rate) {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+		if (info->in.format != info->out.format)
+			rate->func = linear_expand;
+		else if (info->in.format == SND_PCM_FORMAT_S16)
 			rate->func = linear_expand_s16;
+		else if (info->in.format == SND_PCM_FORMAT_S32)
+			rate->func = linear_expand_s32;
+		else if (info->in.format == SND_PCM_FORMAT_FLOAT)
+			rate->func = linear_expand_float;
 		else
 			rate->func = linear_expand;
 		/* pitch is get_threshold */
 	} else {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+		if (info->in.format != info->out.format)
+			rate->func = linear_shrink;
+		else if (info->in.format == SND_PCM_FORMAT_S16)
 			rate->func = linear_shrink_s16;
+		else if (info->in.format == SND_PCM_FORMAT_S32)
+			rate->func = linear_shrink_s32;
+		else if (info->in.format == SND_PCM_FORMAT_FLOAT)
+			rate->func = linear_shrink_float;
 		else
 			rate->func = linear_shrink;
 		/* pitch is get_increment */
@@ -349,9 +839,10 @@ static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 	rate->pitch = (((uint64_t)info->out.rate * LINEAR_DIV) +
 		       (info->in.rate / 2)) / info->in.rate;
 	rate->channels = info->channels;
+	rate->frame_s16 = linear_select_frame_s16();
 
 	free(rate->old_sample);
-	rate->old_sample = malloc(sizeof(*rate->old_sample) * rate->channels);
+	rate->old_sample = malloc(sizeof(int32_t) * rate->channels);
 	if (! rate->old_sample)
 		return -ENOMEM;
 
@@ -363,6 +854,8 @@ static int linear_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
 	struct rate_linear *rate = obj;
 	snd_pcm_uframes_t cframes;
 
+	rate->src_frames = info->in.period_size;
+	rate->dst_frames = info->out.period_size;
 	rate->pitch = (((uint64_t)info->out.period_size * LINEAR_DIV) +
 		       (info->in.period_size/2) ) / info->in.period_size;
 			
@@ -397,7 +890,29 @@ static void linear_reset(void *obj)
 
 	/* for expand */
 	if (rate->old_sample)
-		memset(rate->old_sample, 0, sizeof(*rate->old_sample) * rate->channels);
+		memset(rate->old_sample, 0, sizeof(int32_t) * rate->channels);
+}
+
+/* only the expand interpolation carries the last frame over */
+static size_t linear_get_state_size(void *obj)
+{
+	struct rate_linear *rate = obj;
+
+	return sizeof(int32_t) * rate->channels;
+}
+
+static void linear_save_state(void *obj, void *state)
+{
+	struct rate_linear *rate = obj;
+
+	memcpy(state, rate->old_sample, sizeof(int32_t) * rate->channels);
+}
+
+static void linear_restore_state(void *obj, const void *state)
+{
+	struct rate_linear *rate = obj;
+
+	memcpy(rate->old_sample, state, sizeof(int32_t) * rate->channels);
 }
 
 static void linear_close(void *obj)
@@ -413,6 +928,19 @@ static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
 	return 0;
 }
 
+static int get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				 uint64_t *in_formats, uint64_t *out_formats,
+				 unsigned int *flags)
+{
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+
+	*in_formats = linear.bits[0] | ((uint64_t)linear.bits[1] << 32) |
+		      (1ULL << SND_PCM_FORMAT_FLOAT);
+	*out_formats = *in_formats;
+	*flags = SND_PCM_RATE_FLAG_VARIABLE_FRAMES;
+	return 0;
+}
+
 static void linear_dump(ATTRIBUTE_UNUSED void *rate, snd_output_t *out)
 {
 	snd_output_printf(out, "Converter: linear-interpolation\n");
@@ -430,6 +958,10 @@ static const snd_pcm_rate_ops_t linear_ops = {
 	.version = SND_PCM_RATE_PLUGIN_VERSION,
 	.get_supported_rates = get_supported_rates,
 	.dump = linear_dump,
+	.get_supported_formats = get_supported_formats,
+	.get_state_size = linear_get_state_size,
+	.save_state = linear_save_state,
+	.restore_state = linear_restore_state,
 };
 
 int SND_PCM_RATE_PLUGIN_ENTRY(linear) (ATTRIBUTE_UNUSED unsigned int version,
@@ -0,0 +1,457 @@
+/*
+ *  Polyphase windowed-sinc rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The converter works on whole periods: the output frame k of a period
+ * of dst_frames is taken at the input position k * src_frames / dst_frames,
+ * so the phase restarts at zero on each period and only the last input
+ * frames (the filter history) are kept.  The fractional position selects
+ * two neighbouring rows of the precomputed Kaiser windowed-sinc table;
+ * the two dot products are interpolated linearly.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+#include "pcm_simd.h"
+
+/* filter length limit when the cutoff is lowered for downsampling */
+#define POLY_MAX_TAPS	512
+
+struct poly_preset {
+	const char *name;
+	unsigned int taps;	/* filter length at the unity ratio */
+	unsigned int phases;	/* table rows per input sample */
+	double rolloff;		/* cutoff relative to the lower Nyquist freq. */
+	double beta;		/* Kaiser window parameter */
+};
+
+static const struct poly_preset poly_presets[] = {
+	{ "fast", 16, 64, 0.85, 6.0 },
+	{ "medium", 32, 128, 0.91, 8.0 },
+	{ "best", 64, 256, 0.95, 10.0 },
+};
+
+typedef void (poly_dot2_t)(const float *x, const float *h0, const float *h1,
+			   unsigned int taps, float *r0, float *r1);
+
+struct rate_poly {
+	const struct poly_preset *preset;
+	unsigned int channels;
+	unsigned int in_rate, out_rate;
+	unsigned int in_period, out_period;
+	unsigned int taps;
+	unsigned int phases;
+	float *coefs;		/* (phases + 1) rows of taps */
+	float *buf;		/* per channel: taps - 1 history + one period */
+	unsigned int buf_frames;
+	poly_dot2_t *dot2;
+};
+
+/* two dot products sharing the input, taps is a multiple of 8 */
+static void generic_dot2(const float *x, const float *h0, const float *h1,
+			 unsigned int taps, float *r0, float *r1)
+{
+	float s0 = 0, s1 = 0;
+	unsigned int i;
+
+	for (i = 0; i < taps; i++) {
+		s0 += x[i] * h0[i];
+		s1 += x[i] * h1[i];
+	}
+	*r0 = s0;
+	*r1 = s1;
+}
+
+#if defined(SND_PCM_SIMD_X86)
+
+SND_PCM_SIMD_TARGET_SSE2
+static float sse2_hsum(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_dot2(const float *x, const float *h0, const float *h1,
+		      unsigned int taps, float *r0, float *r1)
+{
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+	__m128 v;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 4) {
+		v = _mm_loadu_ps(x + i);
+		s0 = _mm_add_ps(s0, _mm_mul_ps(v, _mm_loadu_ps(h0 + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(v, _mm_loadu_ps(h1 + i)));
+	}
+	*r0 = sse2_hsum(s0);
+	*r1 = sse2_hsum(s1);
+}
+
+SND_PCM_SIMD_TARGET_AVX2
+static void avx2_dot2(const float *x, const float *h0, const float *h1,
+		      unsigned int taps, float *r0, float *r1)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	__m256 v;
+	__m128 t0, t1;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 8) {
+		v = _mm256_loadu_ps(x + i);
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(v, _mm256_loadu_ps(h0 + i)));
+		s1 = _mm256_add_ps(s1, _mm256_mul_ps(v, _mm256_loadu_ps(h1 + i)));
+	}
+	t0 = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+	t1 = _mm_add_ps(_mm256_castps256_ps128(s1), _mm256_extractf128_ps(s1, 1));
+	t0 = _mm_add_ps(t0, _mm_movehl_ps(t0, t0));
+	t1 = _mm_add_ps(t1, _mm_movehl_ps(t1, t1));
+	*r0 = _mm_cvtss_f32(_mm_add_ss(t0, _mm_shuffle_ps(t0, t0, 1)));
+	*r1 = _mm_cvtss_f32(_mm_add_ss(t1, _mm_shuffle_ps(t1, t1, 1)));
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+static void neon_dot2(const float *x, const float *h0, const float *h1,
+		      unsigned int taps, float *r0, float *r1)
+{
+	float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+	float32x4_t v;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 4) {
+		v = vld1q_f32(x + i);
+		s0 = vmlaq_f32(s0, v, vld1q_f32(h0 + i));
+		s1 = vmlaq_f32(s1, v, vld1q_f32(h1 + i));
+	}
+	*r0 = vaddvq_f32(s0);
+	*r1 = vaddvq_f32(s1);
+}
+
+#endif
+
+static poly_dot2_t *poly_select_dot2(void)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+
+#if defined(SND_PCM_SIMD_X86)
+	if (caps & SND_PCM_SIMD_AVX2)
+		return avx2_dot2;
+	if (caps & SND_PCM_SIMD_SSE2)
+		return sse2_dot2;
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON)
+		return neon_dot2;
+#endif
+	(void)caps;
+	return generic_dot2;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double poly_bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+	unsigned int k;
+
+	for (k = 1; k < 50 && term > sum * 1e-12; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/*
+ * row p is applied at the fractional position p / phases between the
+ * input frames c and c + 1 of the window, c = taps / 2 - 1; each row is
+ * normalized to the unity DC gain
+ */
+static void poly_make_table(struct rate_poly *rate, double cutoff)
+{
+	const double half = rate->taps / 2;
+	const double beta = rate->preset->beta;
+	const double i0_beta = poly_bessel_i0(beta);
+	unsigned int p, j;
+	float *row;
+	double x, w, h, sum;
+
+	for (p = 0; p <= rate->phases; p++) {
+		row = rate->coefs + p * rate->taps;
+		sum = 0;
+		for (j = 0; j < rate->taps; j++) {
+			x = (double)j - (half - 1) - (double)p / rate->phases;
+			w = 1 - (x / half) * (x / half);
+			w = w > 0 ? poly_bessel_i0(beta * sqrt(w)) / i0_beta : 0;
+			h = x == 0 ? 1 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+			row[j] = h * w;
+			sum += row[j];
+		}
+		for (j = 0; j < rate->taps; j++)
+			row[j] /= sum;
+	}
+}
+
+static snd_pcm_uframes_t poly_input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_poly *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->in_period, rate->out_period);
+}
+
+static snd_pcm_uframes_t poly_output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_poly *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->out_period, rate->in_period);
+}
+
+static inline int16_t poly_to_s16(float v)
+{
+	if (v >= 32767.0f)
+		return 32767;
+	if (v <= -32768.0f)
+		return -32768;
+	return (int16_t)lrintf(v);
+}
+
+static void poly_convert_s16(void *obj, int16_t *dst, unsigned int dst_frames,
+			     const int16_t *src, unsigned int src_frames)
+{
+	struct rate_poly *rate = obj;
+	const unsigned int taps = rate->taps;
+	const unsigned int channels = rate->channels;
+	unsigned int chn, i, k, p;
+	unsigned long long pos;
+	float *x, *h0, r0, r1, t;
+
+	if (CHECK_SANITY(src_frames > rate->buf_frames)) {
+		SNDERR("src_frames overflow");
+		src_frames = rate->buf_frames;
+	}
+	for (chn = 0; chn < channels; chn++) {
+		x = rate->buf + chn * (taps - 1 + rate->buf_frames);
+		for (i = 0; i < src_frames; i++)
+			x[taps - 1 + i] = src[i * channels + chn];
+		for (k = 0; k < dst_frames; k++) {
+			pos = (unsigned long long)k * src_frames;
+			i = pos / dst_frames;
+			/* phase in 1/65536 of the table row step */
+			pos = ((pos % dst_frames) * rate->phases << 16) / dst_frames;
+			p = pos >> 16;
+			t = (pos & 0xffff) * (1.0f / 65536);
+			h0 = rate->coefs + p * taps;
+			rate->dot2(x + i, h0, h0 + taps, taps, &r0, &r1);
+			dst[k * channels + chn] = poly_to_s16(r0 + (r1 - r0) * t);
+		}
+		/* keep the history for the next period */
+		memmove(x, x + src_frames, (taps - 1) * sizeof(*x));
+	}
+}
+
+static void poly_free(void *obj)
+{
+	struct rate_poly *rate = obj;
+
+	free(rate->coefs);
+	free(rate->buf);
+	rate->coefs = NULL;
+	rate->buf = NULL;
+}
+
+static int poly_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_poly *rate = obj;
+	double cutoff = rate->preset->rolloff;
+	unsigned int taps = rate->preset->taps;
+
+	/* lower the cutoff and widen the filter for downsampling */
+	if (info->out.rate < info->in.rate) {
+		cutoff = cutoff * info->out.rate / info->in.rate;
+		taps = (uint64_t)taps * info->in.rate / info->out.rate;
+		taps = (taps + 7) & ~7U;
+		if (taps > POLY_MAX_TAPS)
+			taps = POLY_MAX_TAPS;
+	}
+
+	poly_free(rate);
+	rate->channels = info->channels;
+	rate->in_rate = info->in.rate;
+	rate->out_rate = info->out.rate;
+	rate->in_period = info->in.period_size;
+	rate->out_period = info->out.period_size;
+	rate->taps = taps;
+	rate->phases = rate->preset->phases;
+	/* room for the stretched periods of the variable ratio mode */
+	rate->buf_frames = info->in.period_size +
+			   SND_PCM_RATE_VARIABLE_SLIP(info->in.period_size);
+	rate->dot2 = poly_select_dot2();
+
+	rate->coefs = malloc((rate->phases + 1) * taps * sizeof(*rate->coefs));
+	rate->buf = calloc(rate->channels * (taps - 1 + rate->buf_frames),
+			   sizeof(*rate->buf));
+	if (!rate->coefs || !rate->buf) {
+		poly_free(rate);
+		return -ENOMEM;
+	}
+	poly_make_table(rate, cutoff);
+	return 0;
+}
+
+static int poly_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_poly *rate = obj;
+
+	if (info->in.period_size > rate->buf_frames) {
+		SNDERR("invalid pcm period_size %ld -> %ld",
+		       info->in.period_size, info->out.period_size);
+		return -EIO;
+	}
+	rate->in_period = info->in.period_size;
+	rate->out_period = info->out.period_size;
+	return 0;
+}
+
+static void poly_reset(void *obj)
+{
+	struct rate_poly *rate = obj;
+
+	if (rate->buf)
+		memset(rate->buf, 0, rate->channels *
+		       (rate->taps - 1 + rate->buf_frames) * sizeof(*rate->buf));
+}
+
+/* the filter history, the last taps - 1 input frames of each channel */
+static size_t poly_get_state_size(void *obj)
+{
+	struct rate_poly *rate = obj;
+
+	return rate->channels * (rate->taps - 1) * sizeof(*rate->buf);
+}
+
+static void poly_save_state(void *obj, void *state)
+{
+	struct rate_poly *rate = obj;
+	unsigned int chn, len = rate->taps - 1;
+	float *dst = state;
+
+	for (chn = 0; chn < rate->channels; chn++)
+		memcpy(dst + chn * len, rate->buf + chn * (len + rate->buf_frames),
+		       len * sizeof(*rate->buf));
+}
+
+static void poly_restore_state(void *obj, const void *state)
+{
+	struct rate_poly *rate = obj;
+	unsigned int chn, len = rate->taps - 1;
+	const float *src = state;
+
+	for (chn = 0; chn < rate->channels; chn++)
+		memcpy(rate->buf + chn * (len + rate->buf_frames), src + chn * len,
+		       len * sizeof(*rate->buf));
+}
+
+static void poly_close(void *obj)
+{
+	poly_free(obj);
+	free(obj);
+}
+
+static int poly_get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+				    unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static int poly_get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				      uint64_t *in_formats, uint64_t *out_formats,
+				      unsigned int *flags)
+{
+	*in_formats = *out_formats = 1ULL << SND_PCM_FORMAT_S16;
+	*flags = SND_PCM_RATE_FLAG_VARIABLE_FRAMES;
+	return 0;
+}
+
+static void poly_dump(void *obj, snd_output_t *out)
+{
+	struct rate_poly *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase windowed-sinc (%s",
+			  rate->preset->name);
+	if (rate->taps)
+		snd_output_printf(out, ", %u taps, %u phases",
+				  rate->taps, rate->phases);
+	snd_output_printf(out, ")\n");
+}
+
+static const snd_pcm_rate_ops_t poly_ops = {
+	.close = poly_close,
+	.init = poly_init,
+	.free = poly_free,
+	.reset = poly_reset,
+	.adjust_pitch = poly_adjust_pitch,
+	.convert_s16 = poly_convert_s16,
+	.input_frames = poly_input_frames,
+	.output_frames = poly_output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = poly_get_supported_rates,
+	.dump = poly_dump,
+	.get_supported_formats = poly_get_supported_formats,
+	.get_state_size = poly_get_state_size,
+	.save_state = poly_save_state,
+	.restore_state = poly_restore_state,
+};
+
+static int poly_open(void **objp, snd_pcm_rate_ops_t *ops,
+		     const struct poly_preset *preset)
+{
+	struct rate_poly *rate;
+
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->preset = preset;
+
+	*objp = rate;
+	*ops = poly_ops;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast) (ATTRIBUTE_UNUSED unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(objp, ops, &poly_presets[0]);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (ATTRIBUTE_UNUSED unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(objp, ops, &poly_presets[1]);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best) (ATTRIBUTE_UNUSED unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(objp, ops, &poly_presets[2]);
+}
@@ -32,6 +32,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "pcm_simd.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -58,6 +59,7 @@ typedef struct {
 } snd_pcm_route_ttable_src_t;
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
+typedef struct snd_pcm_route_matrix snd_pcm_route_matrix_t;
 
 typedef struct {
 	enum {UINT64, FLOAT} sum_idx;
@@ -65,11 +67,14 @@ typedef struct {
 	unsigned int put_idx;
 	unsigned int conv_idx;
 	int use_getput;
+	int get_float;		/* get_idx is an index of get32float_labels */
+	int put_float;		/* put_idx is an index of put32float_labels */
 	unsigned int src_size;
 	snd_pcm_format_t dst_sfmt;
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+	snd_pcm_route_matrix_t *matrix;
 } snd_pcm_route_params_t;
 
 
@@ -89,6 +94,22 @@ struct snd_pcm_route_ttable_dst {
 	route_f func;
 };
 
+typedef void (*route_matrix_f)(const snd_pcm_route_matrix_t *m,
+			       char *dst, const char *src,
+			       snd_pcm_uframes_t frames);
+
+struct snd_pcm_route_matrix {
+	route_matrix_f func;
+	unsigned int src_channels;
+	unsigned int dst_channels;
+	unsigned int width;	/* dst_channels rounded up to the vector size */
+	unsigned int ncols;	/* used source channels */
+	unsigned int *cols;
+	float *coefs;		/* one column of width entries per used source */
+	unsigned int ncopies;	/* destinations with one unattenuated source */
+	unsigned int *copies;	/* dst, src pairs */
+};
+
 typedef union {
 	int32_t as_sint32;
 	int64_t as_sint64;
@@ -105,8 +126,21 @@ typedef struct {
 	snd_pcm_route_params_t params;
 	snd_pcm_chmap_t *chmap;
 	snd_pcm_chmap_query_t **chmap_override;
+	/* transformation table driven by control elements */
+	snd_ctl_t *ctl;
+	snd_ctl_elem_id_t ctl_id;	/* of the first slave channel */
+	unsigned int ctl_numid;
+	unsigned int tt_cused, tt_sused;
+	snd_pcm_route_ttable_entry_t *ttable[2];	/* current and next */
+	unsigned int tt_cur;
+	int ctl_dirty;		/* the elements have changed */
+	int tt_pending;		/* the next table waits for a period boundary */
+	int ramp;		/* ramp the changes over one slave period */
+	snd_pcm_uframes_t ramp_pos, ramp_len;
 } snd_pcm_route_t;
 
+#define ROUTE_CTL_FULL	65536	/* control value of SND_PCM_PLUGIN_ROUTE_FULL */
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert1_zero(const snd_pcm_channel_area_t *dst_area,
@@ -236,9 +270,13 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 {
 #define GET32_LABELS
 #define PUT32_LABELS
+#define GET32F_LABELS
+#define PUT32F_LABELS
 #include "plugin_ops.h"
 #undef GET32_LABELS
 #undef PUT32_LABELS
+#undef GET32F_LABELS
+#undef PUT32F_LABELS
 	static void *const zero_labels[2] = {
 		&&zero_int64,
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
@@ -269,6 +307,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	int src_steps[nsrcs];
 	snd_pcm_route_ttable_src_t src_tt[nsrcs];
 	int32_t sample = 0;
+	snd_tmp_float_t tmp_float;
+	snd_tmp_double_t tmp_double;
 	int srcidx, srcidx1 = 0;
 	for (srcidx = 0; srcidx < nsrcs && (unsigned)srcidx < src_channels; ++srcidx) {
 		const snd_pcm_channel_area_t *src_area;
@@ -288,7 +328,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 					    src_channels,
 					    frames, ttable, params);
 		return;
-	} else if (nsrcs == 1 && src_tt[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) {
+	} else if (nsrcs == 1 && src_tt[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION &&
+		   !params->get_float && !params->put_float) {
 		if (params->use_getput)
 			snd_pcm_route_convert1_one_getput(dst_area, dst_offset,
 							  src_areas, src_offset,
@@ -303,10 +344,12 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 
 	zero = zero_labels[params->sum_idx];
-	get32 = get32_labels[params->get_idx];
+	get32 = params->get_float ? get32float_labels[params->get_idx] :
+		get32_labels[params->get_idx];
 	add = add_labels[params->sum_idx * 2 + ttable->att];
 	norm = norm_labels[params->sum_idx * 2 + ttable->att];
-	put32 = put32_labels[params->put_idx];
+	put32 = params->put_float ? put32float_labels[params->put_idx] :
+		put32_labels[params->put_idx];
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 	dst_step = snd_pcm_channel_area_step(dst_area);
 
@@ -331,8 +374,10 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 			/* Get sample */
 			goto *get32;
 #define GET32_END after_get
+#define GET32F_END after_get
 #include "plugin_ops.h"
 #undef GET32_END
+#undef GET32F_END
 		after_get:
 
 			/* Sum */
@@ -375,7 +420,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
 	norm_float:
 		sum.as_float = rint(sum.as_float);
-		if (sum.as_float > (int64_t)0x7fffffff)
+		/* 0x7fffffff is rounded up to 2^31 in float */
+		if (sum.as_float >= 2147483648.0f)
 			sample = 0x7fffffff;	/* maximum positive value */
 		else if (sum.as_float < -(int64_t)0x80000000)
 			sample = 0x80000000;	/* maximum negative value */
@@ -388,14 +434,421 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 		/* Put sample */
 		goto *put32;
 #define PUT32_END after_put32
+#define PUT32F_END after_put32
 #include "plugin_ops.h"
 #undef PUT32_END
+#undef PUT32F_END
 	after_put32:
 		
 		dst += dst_step;
 	}
 }
 
+/*
+ * Compiled mixing matrix
+ *
+ * When both sides are interleaved S16, S32 or FLOAT in the host byte
+ * order, all destination channels of a frame are mixed at once: each used
+ * source sample is broadcast and multiplied by its column of the dense
+ * coefficient matrix, the columns of unused sources are left out.  For
+ * the integer formats the terms are summed in the same order and
+ * precision as snd_pcm_route_convert1_many() does, so the results are
+ * bit-exact.  FLOAT samples are mixed as they are, without the round trip
+ * through S32 of the per-channel code, so the sums are neither quantized
+ * nor clipped.
+ */
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+
+#define ROUTE_MATRIX_LANES	4
+
+static void matrix_float(const snd_pcm_route_matrix_t *m,
+			 char *dst, const char *src,
+			 snd_pcm_uframes_t frames)
+{
+	const float *s = (const float *)src;
+	float *d = (float *)dst;
+	unsigned int c, k;
+
+	while (frames-- > 0) {
+		for (c = 0; c < m->dst_channels; c++) {
+			const float *coef = m->coefs + c;
+			float sum = 0;
+			for (k = 0; k < m->ncols; k++, coef += m->width)
+				sum += s[m->cols[k]] * *coef;
+			d[c] = sum;
+		}
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+#if defined(SND_PCM_SIMD_X86)
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128 sse2_matrix_sum(const snd_pcm_route_matrix_t *m,
+		       const float *x, unsigned int c)
+{
+	const float *coef = m->coefs + c;
+	__m128 acc = _mm_setzero_ps();
+	unsigned int k;
+
+	for (k = 0; k < m->ncols; k++, coef += m->width)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(x[k]),
+						 _mm_loadu_ps(coef)));
+	return acc;
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_SSE2
+__m128i sse2_matrix_block(const snd_pcm_route_matrix_t *m,
+			  const float *x, unsigned int c)
+{
+	__m128 acc = sse2_matrix_sum(m, x, c);
+	__m128i v;
+
+	/* sums from 2^31 up give 0x80000000, clip them to 0x7fffffff */
+	v = _mm_cvtps_epi32(acc);
+	return _mm_xor_si128(v, _mm_castps_si128(_mm_cmpge_ps(acc, _mm_set1_ps(2147483648.0f))));
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_matrix_s16(const snd_pcm_route_matrix_t *m,
+			    char *dst, const char *src,
+			    snd_pcm_uframes_t frames)
+{
+	const int16_t *s = (const int16_t *)src;
+	int16_t *d = (int16_t *)dst;
+	float x[m->ncols];
+	int16_t tail[8];
+	unsigned int c, k;
+	__m128i v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = (int32_t)((uint32_t)s[m->cols[k]] << 16);
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = _mm_srai_epi32(sse2_matrix_block(m, x, c), 16);
+			v = _mm_packs_epi32(v, v);
+			if (c + 4 <= m->dst_channels) {
+				_mm_storel_epi64((__m128i *)(d + c), v);
+			} else {
+				_mm_storeu_si128((__m128i *)tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_matrix_s32(const snd_pcm_route_matrix_t *m,
+			    char *dst, const char *src,
+			    snd_pcm_uframes_t frames)
+{
+	const int32_t *s = (const int32_t *)src;
+	int32_t *d = (int32_t *)dst;
+	float x[m->ncols];
+	int32_t tail[4];
+	unsigned int c, k;
+	__m128i v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = s[m->cols[k]];
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = sse2_matrix_block(m, x, c);
+			if (c + 4 <= m->dst_channels) {
+				_mm_storeu_si128((__m128i *)(d + c), v);
+			} else {
+				_mm_storeu_si128((__m128i *)tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		/* plain copies keep the bits lost by the float conversion */
+		for (k = 0; k < m->ncopies; k++)
+			d[m->copies[2 * k]] = s[m->copies[2 * k + 1]];
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_matrix_float(const snd_pcm_route_matrix_t *m,
+			      char *dst, const char *src,
+			      snd_pcm_uframes_t frames)
+{
+	const float *s = (const float *)src;
+	float *d = (float *)dst;
+	float x[m->ncols];
+	float tail[4];
+	unsigned int c, k;
+	__m128 v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = s[m->cols[k]];
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = sse2_matrix_sum(m, x, c);
+			if (c + 4 <= m->dst_channels) {
+				_mm_storeu_ps(d + c, v);
+			} else {
+				_mm_storeu_ps(tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+static inline float32x4_t neon_matrix_sum(const snd_pcm_route_matrix_t *m,
+					  const float *x, unsigned int c)
+{
+	const float *coef = m->coefs + c;
+	float32x4_t acc = vdupq_n_f32(0);
+	unsigned int k;
+
+	/* no fused multiply-add, the scalar code rounds the product */
+	for (k = 0; k < m->ncols; k++, coef += m->width)
+		acc = vaddq_f32(acc, vmulq_f32(vdupq_n_f32(x[k]), vld1q_f32(coef)));
+	return acc;
+}
+
+static inline int32x4_t neon_matrix_block(const snd_pcm_route_matrix_t *m,
+					  const float *x, unsigned int c)
+{
+	/* rounds to nearest even and saturates like the scalar code */
+	return vcvtnq_s32_f32(neon_matrix_sum(m, x, c));
+}
+
+static void neon_matrix_s16(const snd_pcm_route_matrix_t *m,
+			    char *dst, const char *src,
+			    snd_pcm_uframes_t frames)
+{
+	const int16_t *s = (const int16_t *)src;
+	int16_t *d = (int16_t *)dst;
+	float x[m->ncols];
+	int16_t tail[4];
+	unsigned int c, k;
+	int16x4_t v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = (int32_t)((uint32_t)s[m->cols[k]] << 16);
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = vshrn_n_s32(neon_matrix_block(m, x, c), 16);
+			if (c + 4 <= m->dst_channels) {
+				vst1_s16(d + c, v);
+			} else {
+				vst1_s16(tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+static void neon_matrix_s32(const snd_pcm_route_matrix_t *m,
+			    char *dst, const char *src,
+			    snd_pcm_uframes_t frames)
+{
+	const int32_t *s = (const int32_t *)src;
+	int32_t *d = (int32_t *)dst;
+	float x[m->ncols];
+	int32_t tail[4];
+	unsigned int c, k;
+	int32x4_t v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = s[m->cols[k]];
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = neon_matrix_block(m, x, c);
+			if (c + 4 <= m->dst_channels) {
+				vst1q_s32(d + c, v);
+			} else {
+				vst1q_s32(tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		/* plain copies keep the bits lost by the float conversion */
+		for (k = 0; k < m->ncopies; k++)
+			d[m->copies[2 * k]] = s[m->copies[2 * k + 1]];
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+static void neon_matrix_float(const snd_pcm_route_matrix_t *m,
+			      char *dst, const char *src,
+			      snd_pcm_uframes_t frames)
+{
+	const float *s = (const float *)src;
+	float *d = (float *)dst;
+	float x[m->ncols];
+	float tail[4];
+	unsigned int c, k;
+	float32x4_t v;
+
+	while (frames-- > 0) {
+		for (k = 0; k < m->ncols; k++)
+			x[k] = s[m->cols[k]];
+		for (c = 0; c < m->dst_channels; c += 4) {
+			v = neon_matrix_sum(m, x, c);
+			if (c + 4 <= m->dst_channels) {
+				vst1q_f32(d + c, v);
+			} else {
+				vst1q_f32(tail, v);
+				memcpy(d + c, tail, (m->dst_channels - c) * sizeof(*d));
+			}
+		}
+		s += m->src_channels;
+		d += m->dst_channels;
+	}
+}
+
+#endif
+
+static route_matrix_f route_select_matrix(snd_pcm_format_t format)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+
+#if defined(SND_PCM_SIMD_X86)
+	if (caps & SND_PCM_SIMD_SSE2) {
+		switch (format) {
+		case SND_PCM_FORMAT_S16:
+			return sse2_matrix_s16;
+		case SND_PCM_FORMAT_S32:
+			return sse2_matrix_s32;
+		default:
+			return sse2_matrix_float;
+		}
+	}
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON) {
+		switch (format) {
+		case SND_PCM_FORMAT_S16:
+			return neon_matrix_s16;
+		case SND_PCM_FORMAT_S32:
+			return neon_matrix_s32;
+		default:
+			return neon_matrix_float;
+		}
+	}
+#endif
+	(void)caps;
+	/* the per-channel code would convert FLOAT to S32 and back */
+	return format == SND_PCM_FORMAT_FLOAT ? matrix_float : NULL;
+}
+
+#endif /* SND_PCM_PLUGIN_ROUTE_FLOAT */
+
+static void snd_pcm_route_matrix_free(snd_pcm_route_params_t *params)
+{
+	free(params->matrix);
+	params->matrix = NULL;
+}
+
+/*
+ * builds the matrix for the given setup, nothing is done when the kernels
+ * do not handle the format or the table does not mix any channels
+ */
+static int snd_pcm_route_matrix_build(snd_pcm_route_params_t *params,
+				      snd_pcm_format_t src_format,
+				      snd_pcm_format_t dst_format,
+				      unsigned int src_channels,
+				      unsigned int dst_channels)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	snd_pcm_route_matrix_t *m;
+	route_matrix_f func;
+	unsigned int used[src_channels];
+	unsigned int dst, src, k, ncols = 0, ncopies = 0, width, rows;
+	int mix = 0;
+
+	snd_pcm_route_matrix_free(params);
+	if (src_format != dst_format ||
+	    (src_format != SND_PCM_FORMAT_S16 && src_format != SND_PCM_FORMAT_S32 &&
+	     src_format != SND_PCM_FORMAT_FLOAT))
+		return 0;
+	/* the channels above the table are silenced */
+	rows = dst_channels < params->ndsts ? dst_channels : params->ndsts;
+	memset(used, 0, sizeof(used));
+	for (dst = 0; dst < rows; dst++) {
+		const snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		unsigned int n = 0, full = 0;
+		for (k = 0; k < d->nsrcs; k++) {
+			src = d->srcs[k].channel;
+			if (src >= src_channels)
+				continue;
+			used[src] = 1;
+			full = d->srcs[k].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION;
+			n++;
+		}
+		if (n == 1 && full)
+			ncopies++;
+		else if (n > 0)
+			mix = 1;
+	}
+	if (!mix)
+		return 0;
+	func = route_select_matrix(src_format);
+	if (!func)
+		return 0;
+	for (src = 0; src < src_channels; src++)
+		ncols += used[src];
+	width = (dst_channels + ROUTE_MATRIX_LANES - 1) / ROUTE_MATRIX_LANES * ROUTE_MATRIX_LANES;
+	m = calloc(1, sizeof(*m) + ncols * width * sizeof(float) +
+		   (ncols + 2 * ncopies) * sizeof(unsigned int));
+	if (!m)
+		return -ENOMEM;
+	m->func = func;
+	m->src_channels = src_channels;
+	m->dst_channels = dst_channels;
+	m->width = width;
+	m->coefs = (float *)(m + 1);
+	m->cols = (unsigned int *)(m->coefs + ncols * width);
+	m->copies = m->cols + ncols;
+	for (src = 0; src < src_channels; src++) {
+		if (used[src])
+			m->cols[m->ncols++] = src;
+	}
+	for (dst = 0; dst < rows; dst++) {
+		const snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		unsigned int n = 0, full = 0;
+		for (k = 0; k < d->nsrcs; k++) {
+			const snd_pcm_route_ttable_src_t *s = &d->srcs[k];
+			unsigned int col;
+			if (s->channel >= (int)src_channels)
+				continue;
+			for (col = 0; m->cols[col] != (unsigned int)s->channel; col++)
+				;
+			m->coefs[col * width + dst] = s->as_float;
+			full = s->as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION;
+			src = s->channel;
+			n++;
+		}
+		if (n == 1 && full) {
+			m->copies[2 * m->ncopies] = dst;
+			m->copies[2 * m->ncopies + 1] = src;
+			m->ncopies++;
+		}
+	}
+	params->matrix = m;
+#else
+	(void)params;
+	(void)src_format;
+	(void)dst_format;
+	(void)src_channels;
+	(void)dst_channels;
+#endif
+	return 0;
+}
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -411,6 +864,20 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+	if (params->matrix &&
+	    params->matrix->src_channels == src_channels &&
+	    params->matrix->dst_channels == dst_channels) {
+		unsigned int width = params->src_size * 8;
+		char *dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+							      dst_channels, width);
+		const char *src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+								    src_channels, width);
+		if (dst && src) {
+			params->matrix->func(params->matrix, dst, src, frames);
+			return;
+		}
+	}
+
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -441,6 +908,11 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 		}
 		free(params->dsts);
 	}
+	snd_pcm_route_matrix_free(params);
+	if (route->ctl)
+		snd_ctl_close(route->ctl);
+	free(route->ttable[0]);
+	free(route->ttable[1]);
 	free(route->chmap);
 	snd_pcm_free_chmaps(route->chmap_override);
 	return snd_pcm_generic_close(pcm);
@@ -451,6 +923,10 @@ static int snd_pcm_route_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
 	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT_LE);
+	snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT_BE);
+	snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT64_LE);
+	snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT64_BE);
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
@@ -545,11 +1021,19 @@ static int snd_pcm_route_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_refine);
 }
 
+/* index of the float labels in plugin_ops.h */
+static unsigned int route_float_index(snd_pcm_format_t format)
+{
+	return (snd_pcm_format_width(format) == 64) * 2 +
+		!snd_pcm_format_cpu_endian(format);
+}
+
 static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_route_t *route = pcm->private_data;
 	snd_pcm_t *slave = route->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int channels;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_route_hw_refine_cchange,
 					  snd_pcm_route_hw_refine_sprepare,
@@ -573,9 +1057,19 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		(snd_pcm_format_physical_width(dst_format) + 7) / 8 == 3 ||
 		snd_pcm_format_width(src_format) == 20 ||
 		snd_pcm_format_width(dst_format) == 20;
-	route->params.get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
-	route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
-	route->params.conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
+	/* the float samples are converted from/to S32 around the sums */
+	route->params.get_float = snd_pcm_format_float(src_format);
+	route->params.put_float = snd_pcm_format_float(dst_format);
+	if (route->params.get_float)
+		route->params.get_idx = route_float_index(src_format);
+	else
+		route->params.get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
+	if (route->params.put_float)
+		route->params.put_idx = route_float_index(dst_format);
+	else
+		route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
+	if (!route->params.get_float && !route->params.put_float)
+		route->params.conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
 	route->params.src_size = snd_pcm_format_width(src_format) / 8;
 	route->params.dst_sfmt = dst_format;
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
@@ -583,9 +1077,327 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 #else
 	route->params.sum_idx = UINT64;
 #endif
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	route->ramp_pos = route->ramp_len = 0;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return snd_pcm_route_matrix_build(&route->params, src_format, dst_format,
+						  channels, slave->channels);
+	return snd_pcm_route_matrix_build(&route->params, src_format, dst_format,
+					  slave->channels, channels);
+}
+
+static int snd_pcm_route_hw_free(snd_pcm_t *pcm)
+{
+	snd_pcm_route_t *route = pcm->private_data;
+
+	snd_pcm_route_matrix_free(&route->params);
+	return snd_pcm_generic_hw_free(pcm);
+}
+
+static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t stream,
+			     unsigned int tt_ssize,
+			     snd_pcm_route_ttable_entry_t *ttable,
+			     unsigned int tt_cused, unsigned int tt_sused);
+
+/*
+ * Runtime changes of the transformation table
+ *
+ * The control elements are only read from the transfer path, which is
+ * the only user of the table, so no lock is needed: the new values are
+ * loaded to the spare table and the compiled table is swapped as a whole
+ * at the next period boundary of the slave.  With ramping, the
+ * coefficients move linearly from the old to the new values over one
+ * slave period.
+ */
+
+static snd_pcm_route_ttable_entry_t route_ctl_to_entry(long val)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	return (snd_pcm_route_ttable_entry_t)val / ROUTE_CTL_FULL;
+#else
+	return val * SND_PCM_PLUGIN_ROUTE_RESOLUTION / ROUTE_CTL_FULL;
+#endif
+}
+
+static long route_entry_to_ctl(snd_pcm_route_ttable_entry_t v)
+{
+	long val;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	val = lrint(v * ROUTE_CTL_FULL);
+#else
+	val = v * ROUTE_CTL_FULL / SND_PCM_PLUGIN_ROUTE_RESOLUTION;
+#endif
+	if (val < 0)
+		return 0;
+	if (val > ROUTE_CTL_FULL)
+		return ROUTE_CTL_FULL;
+	return val;
+}
+
+static void route_free_dsts(snd_pcm_route_params_t *params)
+{
+	unsigned int dst_channel;
+
+	if (params->dsts) {
+		for (dst_channel = 0; dst_channel < params->ndsts; ++dst_channel) {
+			free(params->dsts[dst_channel].srcs);
+		}
+		free(params->dsts);
+	}
+	params->dsts = NULL;
+}
+
+/* compiles the current table, the old one is kept on errors */
+static int snd_pcm_route_reload(snd_pcm_t *pcm)
+{
+	snd_pcm_route_t *route = pcm->private_data;
+	snd_pcm_t *slave = route->plug.gen.slave;
+	snd_pcm_route_params_t params = route->params;
+	int err;
+
+	params.dsts = NULL;
+	err = route_load_ttable(&params, pcm->stream, route->tt_sused,
+				route->ttable[route->tt_cur],
+				route->tt_cused, route->tt_sused);
+	if (err < 0) {
+		route_free_dsts(&params);
+		return err;
+	}
+	route_free_dsts(&route->params);
+	route->params = params;
+	if (!pcm->setup)
+		return 0;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return snd_pcm_route_matrix_build(&route->params, pcm->format, slave->format,
+						  pcm->channels, slave->channels);
+	return snd_pcm_route_matrix_build(&route->params, slave->format, pcm->format,
+					  slave->channels, pcm->channels);
+}
+
+static int route_ctl_read(snd_pcm_route_t *route, snd_pcm_route_ttable_entry_t *ttable)
+{
+	snd_ctl_elem_value_t elem = {0};
+	unsigned int c, s;
+	int err;
+
+	for (s = 0; s < route->tt_sused; s++) {
+		elem.id = route->ctl_id;
+		elem.id.index += s;
+		elem.id.numid = 0;
+		err = snd_ctl_elem_read(route->ctl, &elem);
+		if (err < 0)
+			return err;
+		for (c = 0; c < route->tt_cused; c++)
+			ttable[c * route->tt_sused + s] =
+				route_ctl_to_entry(elem.value.integer.value[c]);
+	}
 	return 0;
 }
 
+/* checks the control events, reads the changed table to the spare one */
+static void snd_pcm_route_update_control(snd_pcm_route_t *route)
+{
+	snd_ctl_event_t ev;
+	unsigned int numid, next = !route->tt_cur;
+	size_t size;
+
+	while (snd_ctl_read(route->ctl, &ev) > 0) {
+		if (snd_ctl_event_get_type(&ev) != SND_CTL_EVENT_ELEM ||
+		    !(snd_ctl_event_elem_get_mask(&ev) & SND_CTL_EVENT_MASK_VALUE))
+			continue;
+		numid = snd_ctl_event_elem_get_numid(&ev);
+		if (numid >= route->ctl_numid &&
+		    numid < route->ctl_numid + route->tt_sused)
+			route->ctl_dirty = 1;
+	}
+	/* the spare table is in use while ramping */
+	if (!route->ctl_dirty || route->tt_pending ||
+	    route->ramp_pos < route->ramp_len)
+		return;
+	route->ctl_dirty = 0;
+	if (route_ctl_read(route, route->ttable[next]) < 0)
+		return;
+	size = route->tt_cused * route->tt_sused * sizeof(snd_pcm_route_ttable_entry_t);
+	if (memcmp(route->ttable[next], route->ttable[route->tt_cur], size))
+		route->tt_pending = 1;
+}
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+static void snd_pcm_route_convert1_ramp(snd_pcm_t *pcm,
+					const snd_pcm_channel_area_t *dst_area,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int src_channels,
+					unsigned int dst_channel,
+					snd_pcm_uframes_t frames)
+{
+#define GET32_LABELS
+#define PUT32_LABELS
+#define GET32F_LABELS
+#define PUT32F_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+#undef PUT32_LABELS
+#undef GET32F_LABELS
+#undef PUT32F_LABELS
+	snd_pcm_route_t *route = pcm->private_data;
+	const snd_pcm_route_params_t *params = &route->params;
+	const snd_pcm_route_ttable_entry_t *old_tt = route->ttable[!route->tt_cur];
+	const snd_pcm_route_ttable_entry_t *new_tt = route->ttable[route->tt_cur];
+	void *get32 = params->get_float ? get32float_labels[params->get_idx] :
+		      get32_labels[params->get_idx];
+	void *put32 = params->put_float ? put32float_labels[params->put_idx] :
+		      put32_labels[params->put_idx];
+	unsigned int nsrcs = 0, ch, idx;
+	unsigned int smul, dmul;
+	const char *src = NULL;		/* read by the get32 labels */
+	const char *srcs[src_channels];
+	int src_steps[src_channels];
+	float olds[src_channels], steps[src_channels];
+	float step = 1.0f / route->ramp_len;
+	snd_pcm_uframes_t pos = route->ramp_pos;
+	char *dst;
+	int dst_step;
+	int32_t sample = 0;
+	snd_tmp_float_t tmp_float;
+	snd_tmp_double_t tmp_double;
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		smul = route->tt_sused;
+		dmul = 1;
+	} else {
+		smul = 1;
+		dmul = route->tt_sused;
+	}
+	for (ch = 0; ch < src_channels && ch < params->nsrcs; ch++) {
+		idx = ch * smul + dst_channel * dmul;
+		if (old_tt[idx] == 0 && new_tt[idx] == 0)
+			continue;
+		srcs[nsrcs] = snd_pcm_channel_area_addr(&src_areas[ch], src_offset);
+		src_steps[nsrcs] = snd_pcm_channel_area_step(&src_areas[ch]);
+		olds[nsrcs] = old_tt[idx];
+		steps[nsrcs] = (new_tt[idx] - old_tt[idx]) * step;
+		nsrcs++;
+	}
+	if (nsrcs == 0) {
+		snd_pcm_area_silence(dst_area, dst_offset, frames, params->dst_sfmt);
+		return;
+	}
+	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	dst_step = snd_pcm_channel_area_step(dst_area);
+	while (frames-- > 0) {
+		float sum = 0;
+		for (idx = 0; idx < nsrcs; idx++) {
+			src = srcs[idx];
+			goto *get32;
+#define GET32_END after_get
+#define GET32F_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+#undef GET32F_END
+		after_get:
+			sum += sample * (olds[idx] + steps[idx] * pos);
+			srcs[idx] += src_steps[idx];
+		}
+		sum = rint(sum);
+		if (sum >= 2147483648.0f)
+			sample = 0x7fffffff;
+		else if (sum < -2147483648.0f)
+			sample = 0x80000000;
+		else
+			sample = sum;
+		goto *put32;
+#define PUT32_END after_put32
+#define PUT32F_END after_put32
+#include "plugin_ops.h"
+#undef PUT32_END
+#undef PUT32F_END
+	after_put32:
+		dst += dst_step;
+		pos++;
+	}
+}
+#endif /* SND_PCM_PLUGIN_ROUTE_FLOAT */
+
+/*
+ * converts the frames, applies a changed table at the period boundaries
+ * of the slave (slave_offset is the offset in the slave buffer)
+ */
+static void snd_pcm_route_transfer(snd_pcm_t *pcm,
+				   const snd_pcm_channel_area_t *dst_areas,
+				   snd_pcm_uframes_t dst_offset,
+				   const snd_pcm_channel_area_t *src_areas,
+				   snd_pcm_uframes_t src_offset,
+				   unsigned int src_channels,
+				   unsigned int dst_channels,
+				   snd_pcm_uframes_t size,
+				   snd_pcm_uframes_t slave_offset)
+{
+	snd_pcm_route_t *route = pcm->private_data;
+	snd_pcm_uframes_t period = route->plug.gen.slave->period_size;
+	snd_pcm_uframes_t frames;
+
+	if (!route->ctl) {
+		snd_pcm_route_convert(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      src_channels, dst_channels,
+				      size, &route->params);
+		return;
+	}
+	snd_pcm_route_update_control(route);
+	while (size > 0) {
+		frames = size;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+		if (route->ramp_pos < route->ramp_len) {
+			unsigned int dst;
+			if (frames > route->ramp_len - route->ramp_pos)
+				frames = route->ramp_len - route->ramp_pos;
+			for (dst = 0; dst < dst_channels; dst++) {
+				if (dst < route->params.ndsts)
+					snd_pcm_route_convert1_ramp(pcm, &dst_areas[dst], dst_offset,
+								    src_areas, src_offset,
+								    src_channels, dst, frames);
+				else
+					snd_pcm_area_silence(&dst_areas[dst], dst_offset,
+							     frames, route->params.dst_sfmt);
+			}
+			route->ramp_pos += frames;
+			goto next;
+		}
+#endif
+		if (route->tt_pending) {
+			if (slave_offset % period == 0) {
+				route->tt_pending = 0;
+				route->tt_cur = !route->tt_cur;
+				if (snd_pcm_route_reload(pcm) < 0) {
+					/* keep the old table */
+					route->tt_cur = !route->tt_cur;
+					continue;
+				}
+				route->ramp_pos = 0;
+				route->ramp_len = route->ramp ? period : 0;
+				continue;
+			}
+			if (frames > period - slave_offset % period)
+				frames = period - slave_offset % period;
+		}
+		snd_pcm_route_convert(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      src_channels, dst_channels,
+				      frames, &route->params);
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	next:
+#endif
+		dst_offset += frames;
+		src_offset += frames;
+		slave_offset += frames;
+		size -= frames;
+	}
+}
+
 static snd_pcm_uframes_t
 snd_pcm_route_write_areas(snd_pcm_t *pcm,
 			  const snd_pcm_channel_area_t *areas,
@@ -599,11 +1411,11 @@ snd_pcm_route_write_areas(snd_pcm_t *pcm,
 	snd_pcm_t *slave = route->plug.gen.slave;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	snd_pcm_route_convert(slave_areas, slave_offset,
-			      areas, offset, 
-			      pcm->channels,
-			      slave->channels,
-			      size, &route->params);
+	snd_pcm_route_transfer(pcm, slave_areas, slave_offset,
+			       areas, offset,
+			       pcm->channels,
+			       slave->channels,
+			       size, slave_offset);
 	*slave_sizep = size;
 	return size;
 }
@@ -621,11 +1433,11 @@ snd_pcm_route_read_areas(snd_pcm_t *pcm,
 	snd_pcm_t *slave = route->plug.gen.slave;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	snd_pcm_route_convert(areas, offset, 
-			      slave_areas, slave_offset,
-			      slave->channels,
-			      pcm->channels,
-			      size, &route->params);
+	snd_pcm_route_transfer(pcm, areas, offset,
+			       slave_areas, slave_offset,
+			       slave->channels,
+			       pcm->channels,
+			       size, slave_offset);
 	*slave_sizep = size;
 	return size;
 }
@@ -716,6 +1528,24 @@ static void snd_pcm_route_dump(snd_pcm_t *pcm, snd_output_t *out)
 		}
 		snd_output_putc(out, '\n');
 	}
+	/* only a format change is fused with the routing */
+	if (pcm->setup && pcm->format != route->plug.gen.slave->format) {
+		snd_pcm_t *slave = route->plug.gen.slave;
+		int att = 0;
+		for (dst = 0; dst < route->params.ndsts; dst++)
+			att |= route->params.dsts[dst].att;
+		snd_output_printf(out, "  Fused conversion: %s -> %s, %u -> %u channels%s\n",
+				  snd_pcm_format_name(pcm->format),
+				  snd_pcm_format_name(slave->format),
+				  pcm->channels, slave->channels,
+				  att ? ", gains" : "");
+	}
+	if (route->params.matrix)
+		snd_output_printf(out, "  Compiled mixing matrix: %u used sources\n",
+				  route->params.matrix->ncols);
+	if (route->ctl)
+		snd_output_printf(out, "  Control: %s%s\n", route->ctl_id.name,
+				  route->ramp ? " (ramped)" : "");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -913,7 +1743,7 @@ static const snd_pcm_ops_t snd_pcm_route_ops = {
 	.info = snd_pcm_generic_info,
 	.hw_refine = snd_pcm_route_hw_refine,
 	.hw_params = snd_pcm_route_hw_params,
-	.hw_free = snd_pcm_generic_hw_free,
+	.hw_free = snd_pcm_route_hw_free,
 	.sw_params = snd_pcm_generic_sw_params,
 	.channel_info = snd_pcm_generic_channel_info,
 	.dump = snd_pcm_route_dump,
@@ -1025,7 +1855,8 @@ int snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	int err;
 	assert(pcmp && slave && ttable);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN && 
-	    snd_pcm_format_linear(sformat) != 1)
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    snd_pcm_format_float(sformat) != 1)
 		return -EINVAL;
 	route = calloc(1, sizeof(snd_pcm_route_t));
 	if (!route) {
@@ -1233,12 +2064,151 @@ int snd_pcm_route_load_ttable(snd_config_t *tt, snd_pcm_route_ttable_entry_t *tt
 					  tt_cused, tt_sused, schannels, NULL);
 }
 
+static int add_user_ctl(snd_pcm_route_t *route, snd_ctl_elem_info_t *cinfo)
+{
+	snd_ctl_elem_value_t elem = {0};
+	unsigned int c, s;
+	int err;
+
+	err = snd_ctl_add_integer_elem_set(route->ctl, cinfo, route->tt_sused,
+					   route->tt_cused, 0, ROUTE_CTL_FULL, 1);
+	if (err < 0)
+		return err;
+	for (s = 0; s < route->tt_sused; s++) {
+		elem.id = route->ctl_id;
+		elem.id.index += s;
+		for (c = 0; c < route->tt_cused; c++)
+			elem.value.integer.value[c] =
+				route_entry_to_ctl(route->ttable[0][c * route->tt_sused + s]);
+		err = snd_ctl_elem_write(route->ctl, &elem);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * load and set up the user-control elements of the table, one element
+ * per slave channel with one value per client channel;
+ * the values of existing elements replace the given table
+ */
+static int route_load_control(snd_pcm_t *pcm, snd_pcm_route_t *route,
+			      int ctl_card, snd_ctl_elem_id_t *ctl_id,
+			      const snd_pcm_route_ttable_entry_t *ttable,
+			      unsigned int tt_ssize,
+			      unsigned int tt_cused, unsigned int tt_sused)
+{
+	char tmp_name[32];
+	snd_pcm_info_t info = {0};
+	snd_ctl_elem_info_t cinfo = {0};
+	unsigned int c, s;
+	size_t size;
+	int err;
+
+	if (tt_cused > 128) {
+		SNDERR("Too many client channels for the route control");
+		return -EINVAL;
+	}
+	/* the control elements end at 1.0, a boost would be lost */
+	for (c = 0; c < tt_cused; c++) {
+		for (s = 0; s < tt_sused; s++) {
+			if (ttable[c * tt_ssize + s] > SND_PCM_PLUGIN_ROUTE_FULL) {
+				SNDERR("Route value of %u.%u above 1.0 with a control",
+				       c, s);
+				return -EINVAL;
+			}
+		}
+	}
+	size = tt_cused * tt_sused * sizeof(snd_pcm_route_ttable_entry_t);
+	route->ttable[0] = malloc(size);
+	route->ttable[1] = malloc(size);
+	if (!route->ttable[0] || !route->ttable[1])
+		return -ENOMEM;
+	route->tt_cused = tt_cused;
+	route->tt_sused = tt_sused;
+	for (c = 0; c < tt_cused; c++)
+		for (s = 0; s < tt_sused; s++)
+			route->ttable[0][c * tt_sused + s] = ttable[c * tt_ssize + s];
+
+	if (ctl_card < 0) {
+		err = snd_pcm_info(pcm, &info);
+		if (err < 0)
+			return err;
+		ctl_card = snd_pcm_info_get_card(&info);
+		if (ctl_card < 0) {
+			SNDERR("No card defined for route control");
+			return -EINVAL;
+		}
+	}
+	sprintf(tmp_name, "hw:%d", ctl_card);
+	err = snd_ctl_open(&route->ctl, tmp_name, 0);
+	if (err < 0) {
+		SNDERR("Cannot open CTL %s", tmp_name);
+		return err;
+	}
+	route->ctl_id = *ctl_id;
+
+	snd_ctl_elem_info_set_id(&cinfo, ctl_id);
+	err = snd_ctl_elem_info(route->ctl, &cinfo);
+	if (err < 0) {
+		if (err != -ENOENT) {
+			SNDERR("Cannot get info for CTL %s", tmp_name);
+			return err;
+		}
+		err = add_user_ctl(route, &cinfo);
+		if (err < 0) {
+			SNDERR("Cannot add a control");
+			return err;
+		}
+	} else if (!(cinfo.access & SNDRV_CTL_ELEM_ACCESS_USER)) {
+		SNDERR("Control %s is not a user control", ctl_id->name);
+		return -EINVAL;
+	} else if (cinfo.type != SND_CTL_ELEM_TYPE_INTEGER ||
+		   cinfo.count != tt_cused ||
+		   cinfo.value.integer.min != 0 ||
+		   cinfo.value.integer.max != ROUTE_CTL_FULL ||
+		   route_ctl_read(route, route->ttable[1]) < 0) {
+		err = snd_ctl_elem_remove(route->ctl, &cinfo.id);
+		if (err < 0) {
+			SNDERR("Control %s mismatch", tmp_name);
+			return err;
+		}
+		/* reset numid */
+		snd_ctl_elem_info_set_id(&cinfo, ctl_id);
+		err = add_user_ctl(route, &cinfo);
+		if (err < 0) {
+			SNDERR("Cannot add a control");
+			return err;
+		}
+	} else {
+		/* keep the table set before */
+		memcpy(route->ttable[0], route->ttable[1], size);
+		err = snd_pcm_route_reload(pcm);
+		if (err < 0)
+			return err;
+	}
+	snd_ctl_elem_info_set_id(&cinfo, ctl_id);
+	err = snd_ctl_elem_info(route->ctl, &cinfo);
+	if (err < 0)
+		return err;
+	route->ctl_numid = cinfo.id.numid;
+	err = snd_ctl_nonblock(route->ctl, 1);
+	if (err < 0)
+		return err;
+	return snd_ctl_subscribe_events(route->ctl, 1);
+}
+
+/* in pcm_misc.c */
+int snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id, int *cardp,
+			     int *cchannelsp, int *hwctlp);
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_route Plugin: Route & Volume
 
 This plugin converts channels and applies volume during the conversion.
-The format and rate must match for both of them.
+The rate must match for both of them.  The sample formats may differ, any
+linear or float formats are converted in the same pass.
 
 SCHANNEL can be a channel name instead of a number (e g FL, LFE).
 If so, a matching channel map will be selected for the slave.
@@ -1261,9 +2231,27 @@ pcm.name {
                 }
         }
         [chmap MAP]             # Override channel maps; MAP is a string array
+        [control {              # Control elements to change the table at runtime
+                name STR        # control element id string
+                [card STR]      # control card index
+                [iface STR]     # interface of the element
+                [index INT]     # index of the element
+                [device INT]    # device number of the element
+                [subdevice INT] # subdevice number of the element
+        }]
+        [ramp BOOL]             # Ramp the table changes (default: no)
 }
 \endcode
 
+When control is given, the table is exposed as a set of integer user
+control elements, one element per slave channel (the element index is
+the control index plus the slave channel) with one value per client
+channel.  The values range from 0 to 65536, 65536 is the route value
+1.0, so the ttable values must not exceed 1.0 then.  If the elements exist already, their values replace the ttable
+of the configuration.  The changed values are applied at the next period
+boundary of the slave; with ramp set, the route values move linearly to
+the new values over one slave period, which avoids clicks.
+
 \subsection pcm_plugins_route_funcref Function reference
 
 <UL>
@@ -1302,6 +2290,9 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int csize, ssize;
 	unsigned int cused, sused;
 	snd_pcm_chmap_query_t **chmaps = NULL;
+	snd_config_t *control = NULL;
+	snd_ctl_elem_id_t ctl_id = {0};
+	int card = -1, ramp = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1330,7 +2321,22 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "control") == 0) {
+			control = n;
+			continue;
+		}
+		if (strcmp(id, "ramp") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("The field ramp must be a boolean type");
+				snd_pcm_free_chmaps(chmaps);
+				return err;
+			}
+			ramp = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
+		snd_pcm_free_chmaps(chmaps);
 		return -EINVAL;
 	}
 	if (!slave) {
@@ -1338,6 +2344,13 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_free_chmaps(chmaps);
 		return -EINVAL;
 	}
+	if (control) {
+		err = snd_pcm_parse_control_id(control, &ctl_id, &card, NULL, NULL);
+		if (err < 0) {
+			snd_pcm_free_chmaps(chmaps);
+			return err;
+		}
+	}
 	if (!tt) {
 		SNDERR("ttable is not defined");
 		snd_pcm_free_chmaps(chmaps);
@@ -1351,9 +2364,10 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	}
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1) {
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    snd_pcm_format_float(sformat) != 1) {
 	    	snd_config_delete(sconf);
-		SNDERR("slave format is not linear");
+		SNDERR("slave format is not linear or float");
 		snd_pcm_free_chmaps(chmaps);
 		return -EINVAL;
 	}
@@ -1415,6 +2429,21 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 				 ttable, ssize,
 				 cused, sused,
 				 spcm, 1);
+	if (err >= 0 && control) {
+		snd_pcm_route_t *route = (*pcmp)->private_data;
+
+		route->ramp = SND_PCM_PLUGIN_ROUTE_FLOAT && ramp;
+		err = route_load_control(*pcmp, route, card, &ctl_id, ttable,
+					 ssize, cused, sused);
+		if (err < 0) {
+			/* closes the slave, too */
+			snd_pcm_close(*pcmp);
+			free(ttable);
+			free(chmap);
+			snd_pcm_free_chmaps(chmaps);
+			return err;
+		}
+	}
 	free(ttable);
 	if (err < 0) {
 		free(chmap);
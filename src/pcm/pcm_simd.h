@@ -0,0 +1,75 @@
+/*
+ *  PCM - SIMD helpers
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __PCM_SIMD_H
+#define __PCM_SIMD_H
+
+/*
+ * The vector kernels are compiled with function-level target attributes
+ * so that the library itself can be built for the baseline ISA and the
+ * best variant is picked at runtime.
+ */
+
+#define SND_PCM_SIMD_SSE2	(1U << 0)
+#define SND_PCM_SIMD_AVX2	(1U << 1)
+#define SND_PCM_SIMD_NEON	(1U << 2)
+#define SND_PCM_SIMD_SSSE3	(1U << 3)
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SND_PCM_SIMD_X86	1
+#include <immintrin.h>
+#define SND_PCM_SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SND_PCM_SIMD_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SND_PCM_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define SND_PCM_SIMD_NEON_ARM64	1
+#include <arm_neon.h>
+#endif
+
+/*
+ * returns the bitmask of the usable SIMD extensions,
+ * LIBASOUND_NO_SIMD environment variable forces the scalar code
+ */
+static inline unsigned int snd_pcm_simd_caps(void)
+{
+	static int caps = -1;
+	unsigned int c = 0;
+
+	if (caps >= 0)
+		return caps;
+	if (getenv("LIBASOUND_NO_SIMD") == NULL) {
+#if defined(SND_PCM_SIMD_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			c |= SND_PCM_SIMD_SSE2;
+		if (__builtin_cpu_supports("ssse3"))
+			c |= SND_PCM_SIMD_SSSE3;
+		if (__builtin_cpu_supports("avx2"))
+			c |= SND_PCM_SIMD_AVX2;
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+		c |= SND_PCM_SIMD_NEON;	/* mandatory on ARMv8-A */
+#endif
+	}
+	caps = c;
+	return c;
+}
+
+#endif /* __PCM_SIMD_H */
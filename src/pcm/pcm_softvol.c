@@ -33,6 +33,8 @@
 
 #include <sound/tlv.h>
 
+#include "pcm_softvol_simd.c"
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_softvol = "";
@@ -53,6 +55,17 @@ typedef struct {
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	/* per channel state, allocated at hw_params */
+	unsigned int *gain;		/* applied gains */
+	int gains_valid;
+	int gain_mute, gain_unity, gain_boost;
+	unsigned int *gain_table;	/* gains repeated for the vector code */
+	unsigned int gain_period;
+	softvol_gain_f gain_func;
+	unsigned int ramp_time;		/* in ms */
+	int ramp_exp;			/* exponential (constant dB) ramps */
+	snd_pcm_uframes_t ramp_frames, ramp_left;
+	double *ramp_gain, *ramp_step;
 } snd_pcm_softvol_t;
 
 #define VOL_SCALE_SHIFT		16
@@ -179,7 +192,8 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 /*
  * apply volumue attenuation
  *
- * TODO: use SIMD operations
+ * The interleaved buffers of the host byte order formats are done by
+ * the vector code in pcm_softvol_simd.c.
  */
 
 #ifndef DOC_HIDDEN
@@ -296,48 +310,62 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	}								\
 } while (0)
 		
-#define GET_VOL_SCALE \
-	switch (ch) { \
-	case 0: \
-	case 2: \
-		vol_scale = (channels == ch + 1) ? vol_c : vol[0]; \
-		break; \
-	case 4: \
-	case 5: \
-		vol_scale = vol_c; \
-		break; \
-	default: \
-		vol_scale = vol[ch & 1]; \
-		break; \
-	}
+/* float samples are scaled directly, with no clipping for boost gains */
+#define CONVERT_AREA_FLOAT(TYPE) do {					\
+	unsigned int ch, fr;						\
+	TYPE *src, *dst;						\
+	TYPE factor;							\
+	for (ch = 0; ch < channels; ch++) {				\
+		src_area = &src_areas[ch];				\
+		dst_area = &dst_areas[ch];				\
+		src = snd_pcm_channel_area_addr(src_area, src_offset);	\
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);	\
+		src_step = snd_pcm_channel_area_step(src_area)		\
+				/ sizeof(TYPE);				\
+		dst_step = snd_pcm_channel_area_step(dst_area)		\
+				/ sizeof(TYPE);				\
+		GET_VOL_SCALE;						\
+		factor = softvol_gain_factor(vol_scale);		\
+		fr = frames;						\
+		while (fr--) {						\
+			*dst = *src * factor;				\
+			src += src_step;				\
+			dst += dst_step;				\
+		}							\
+	}								\
+} while (0)
 
-#endif /* DOC_HIDDEN */
+#define GET_VOL_SCALE \
+	vol_scale = gains[ch]
 
-/* 2-channel stereo control */
-static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
-				       const snd_pcm_channel_area_t *dst_areas,
-				       snd_pcm_uframes_t dst_offset,
-				       const snd_pcm_channel_area_t *src_areas,
-				       snd_pcm_uframes_t src_offset,
-				       unsigned int channels,
-				       snd_pcm_uframes_t frames)
+static inline double softvol_gain_factor(double gain)
 {
-	const snd_pcm_channel_area_t *dst_area, *src_area;
-	unsigned int src_step, dst_step;
-	unsigned int vol_scale, vol[2], vol_c;
+	return gain >= 0xffff && gain < 0x10000 ? 1.0 : gain / 65536.0;
+}
 
-	if (svol->cur_vol[0] == 0 && svol->cur_vol[1] == 0) {
-		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
-				      svol->sformat);
-		return;
-	} else if (svol->zero_dB_val && svol->cur_vol[0] == svol->zero_dB_val &&
-		   svol->cur_vol[1] == svol->zero_dB_val) {
-		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
-				   channels, frames, svol->sformat);
-		return;
-	}
+#endif /* DOC_HIDDEN */
 
-	if (svol->max_val == 1) {
+/*
+ * computes the gain of each channel from the control values;
+ * with a stereo control the channels are assumed to be either mono,
+ * 2.0, 2.1, 4.0, 4.1, 5.1 or 7.1
+ */
+static void softvol_get_gains(snd_pcm_softvol_t *svol, unsigned int channels,
+			      unsigned int *gains)
+{
+	unsigned int vol[2], vol_c, ch;
+
+	if (svol->cchannels == 1) {
+		if (svol->cur_vol[0] == 0)
+			vol_c = 0;
+		else if (svol->max_val == 1)
+			vol_c = 0xffff;
+		else
+			vol_c = svol->dB_value[svol->cur_vol[0]];
+		vol[0] = vol[1] = vol_c;
+	} else if (svol->cur_vol[0] == 0 && svol->cur_vol[1] == 0) {
+		vol[0] = vol[1] = vol_c = 0;
+	} else if (svol->max_val == 1) {
 		vol[0] = svol->cur_vol[0] ? 0xffff : 0;
 		vol[1] = svol->cur_vol[1] ? 0xffff : 0;
 		vol_c = vol[0] | vol[1];
@@ -346,61 +374,186 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 		vol[1] = svol->dB_value[svol->cur_vol[1]];
 		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
 	}
-	switch (svol->sformat) {
-	case SND_PCM_FORMAT_S16_LE:
-	case SND_PCM_FORMAT_S16_BE:
-		/* 16bit samples */
-		CONVERT_AREA(short, 
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S32_LE:
-	case SND_PCM_FORMAT_S32_BE:
-		/* 32bit samples */
-		CONVERT_AREA(int,
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S24_LE:
-		/* 24bit samples */
-		CONVERT_AREA_S24_LE();
-		break;
-	case SND_PCM_FORMAT_S24_3LE:
-		CONVERT_AREA_S24_3LE();
-		break;
-	default:
-		break;
+	for (ch = 0; ch < channels; ch++) {
+		switch (ch) {
+		case 0:
+		case 2:
+			gains[ch] = (channels == ch + 1) ? vol_c : vol[0];
+			break;
+		case 4:
+		case 5:
+			gains[ch] = vol_c;
+			break;
+		default:
+			gains[ch] = vol[ch & 1];
+			break;
+		}
+	}
+}
+
+/* sets the gains to apply, starts a ramp to them if enabled */
+static void softvol_set_gains(snd_pcm_softvol_t *svol, unsigned int channels,
+			      const unsigned int *gains)
+{
+	unsigned int ch, i;
+	double from, to;
+
+	if (svol->ramp_frames && svol->gains_valid) {
+		for (ch = 0; ch < channels; ch++) {
+			from = svol->ramp_left ? svol->ramp_gain[ch] : svol->gain[ch];
+			to = gains[ch];
+			if (svol->ramp_exp) {
+				/* constant dB steps, the silence is 1/65536 */
+				if (from < 1)
+					from = 1;
+				if (to < 1)
+					to = 1;
+				svol->ramp_step[ch] = pow(to / from, 1.0 / svol->ramp_frames);
+			} else {
+				svol->ramp_step[ch] = (to - from) / svol->ramp_frames;
+			}
+			svol->ramp_gain[ch] = from;
+		}
+		svol->ramp_left = svol->ramp_frames;
+	}
+	svol->gains_valid = 1;
+	svol->gain_mute = svol->gain_unity = 1;
+	svol->gain_boost = 0;
+	for (ch = 0; ch < channels; ch++) {
+		svol->gain[ch] = gains[ch];
+		if (gains[ch] != 0)
+			svol->gain_mute = 0;
+		if (gains[ch] != 0xffff)
+			svol->gain_unity = 0;
+		if (gains[ch] > 0xffff)
+			svol->gain_boost = 1;
+	}
+	for (i = 0; i < svol->gain_period + SOFTVOL_GAIN_ALIGN; i++)
+		svol->gain_table[i] = gains[i % channels];
+}
+
+/*
+ * applies the volume ramp, the gains change on each frame, so this is
+ * done by the scalar code
+ */
+static void softvol_convert_ramp(snd_pcm_softvol_t *svol,
+				 const snd_pcm_channel_area_t *dst_areas,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas,
+				 snd_pcm_uframes_t src_offset,
+				 unsigned int channels,
+				 snd_pcm_uframes_t frames)
+{
+	int swap = !snd_pcm_format_cpu_endian(svol->sformat);
+	unsigned int ch, vol;
+	snd_pcm_uframes_t fr;
+
+	for (ch = 0; ch < channels; ch++) {
+		const char *src = snd_pcm_channel_area_addr(&src_areas[ch], src_offset);
+		char *dst = snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset);
+		int src_step = snd_pcm_channel_area_step(&src_areas[ch]);
+		int dst_step = snd_pcm_channel_area_step(&dst_areas[ch]);
+		double gain = svol->ramp_gain[ch];
+		double step = svol->ramp_step[ch];
+		int tmp;
+
+		for (fr = 0; fr < frames; fr++) {
+			vol = (unsigned int)(gain + 0.5);
+			switch (svol->sformat) {
+			case SND_PCM_FORMAT_S16_LE:
+			case SND_PCM_FORMAT_S16_BE:
+				*(short *)dst = MULTI_DIV_short(*(const short *)src, vol, swap);
+				break;
+			case SND_PCM_FORMAT_S32_LE:
+			case SND_PCM_FORMAT_S32_BE:
+				*(int *)dst = MULTI_DIV_int(*(const int *)src, vol, swap);
+				break;
+			case SND_PCM_FORMAT_S24_LE:
+				tmp = *(const int *)src << 8;
+				tmp = (signed int) tmp >> 8;
+				*(int *)dst = MULTI_DIV_24(tmp, vol);
+				break;
+			case SND_PCM_FORMAT_S24_3LE:
+				tmp = (unsigned char)src[0] |
+				      ((unsigned char)src[1] << 8) |
+				      (((const signed char *) src)[2] << 16);
+				tmp = MULTI_DIV_24(tmp, vol);
+				dst[0] = tmp;
+				dst[1] = tmp >> 8;
+				dst[2] = tmp >> 16;
+				break;
+			case SND_PCM_FORMAT_FLOAT:
+				*(float *)dst = *(const float *)src *
+						(float)softvol_gain_factor(gain);
+				break;
+			case SND_PCM_FORMAT_FLOAT64:
+				*(double *)dst = *(const double *)src *
+						 softvol_gain_factor(gain);
+				break;
+			default:
+				break;
+			}
+			gain = svol->ramp_exp ? gain * step : gain + step;
+			src += src_step;
+			dst += dst_step;
+		}
+		svol->ramp_gain[ch] = gain;
 	}
+	svol->ramp_left -= frames;
 }
 
-#undef GET_VOL_SCALE
-#define GET_VOL_SCALE
-
-/* mono control */
-static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
-				     const snd_pcm_channel_area_t *dst_areas,
-				     snd_pcm_uframes_t dst_offset,
-				     const snd_pcm_channel_area_t *src_areas,
-				     snd_pcm_uframes_t src_offset,
-				     unsigned int channels,
-				     snd_pcm_uframes_t frames)
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames)
 {
 	const snd_pcm_channel_area_t *dst_area, *src_area;
 	unsigned int src_step, dst_step;
 	unsigned int vol_scale;
+	const unsigned int *gains = svol->gain;
+
+	if (svol->ramp_left) {
+		snd_pcm_uframes_t size = frames;
+		if (size > svol->ramp_left)
+			size = svol->ramp_left;
+		softvol_convert_ramp(svol, dst_areas, dst_offset,
+				     src_areas, src_offset, channels, size);
+		dst_offset += size;
+		src_offset += size;
+		frames -= size;
+		if (!frames)
+			return;
+	}
 
-	if (svol->cur_vol[0] == 0) {
+	if (svol->gain_mute) {
 		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
 				      svol->sformat);
 		return;
-	} else if (svol->zero_dB_val && svol->cur_vol[0] == svol->zero_dB_val) {
+	} else if (svol->gain_unity) {
 		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
 				   channels, frames, svol->sformat);
 		return;
 	}
 
-	if (svol->max_val == 1)
-		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
-	else
-		vol_scale = svol->dB_value[svol->cur_vol[0]];
+	/* the float kernels also take the boost gains */
+	if (svol->gain_func &&
+	    (!svol->gain_boost || svol->sformat == SND_PCM_FORMAT_FLOAT ||
+	     svol->sformat == SND_PCM_FORMAT_FLOAT64)) {
+		unsigned int width = snd_pcm_format_physical_width(svol->sformat);
+		void *dst = snd_pcm_channel_areas_interleaved(dst_areas, dst_offset,
+							      channels, width);
+		void *src = snd_pcm_channel_areas_interleaved(src_areas, src_offset,
+							      channels, width);
+		if (dst && src) {
+			svol->gain_func(dst, src, frames * channels,
+					svol->gain_table, svol->gain_period);
+			return;
+		}
+	}
+
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -421,6 +574,12 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		CONVERT_AREA_FLOAT(float);
+		break;
+	case SND_PCM_FORMAT_FLOAT64:
+		CONVERT_AREA_FLOAT(double);
+		break;
 	default:
 		break;
 	}
@@ -446,6 +605,18 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 	}
 }
 
+static void softvol_update_gains(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+	unsigned int gains[pcm->channels];
+
+	get_current_volume(svol);
+	softvol_get_gains(svol, pcm->channels, gains);
+	if (!svol->gains_valid ||
+	    memcmp(gains, svol->gain, sizeof(gains)))
+		softvol_set_gains(svol, pcm->channels, gains);
+}
+
 static void softvol_free(snd_pcm_softvol_t *svol)
 {
 	if (svol->plug.gen.close_slave)
@@ -454,6 +625,7 @@ static void softvol_free(snd_pcm_softvol_t *svol)
 		snd_ctl_close(svol->ctl);
 	if (svol->dB_value && svol->dB_value != preset_dB_value)
 		free(svol->dB_value);
+	free(svol->ramp_gain);
 	free(svol);
 }
 
@@ -476,7 +648,9 @@ static int snd_pcm_softvol_hw_refine_cprepare(snd_pcm_t *pcm,
 			(1ULL << SND_PCM_FORMAT_S16_BE) |
 			(1ULL << SND_PCM_FORMAT_S24_LE) |
 			(1ULL << SND_PCM_FORMAT_S32_LE) |
- 			(1ULL << SND_PCM_FORMAT_S32_BE),
+			(1ULL << SND_PCM_FORMAT_S32_BE) |
+			(1ULL << SND_PCM_FORMAT_FLOAT) |
+			(1ULL << SND_PCM_FORMAT_FLOAT64),
 			(1ULL << (SND_PCM_FORMAT_S24_3LE - 32))
 		}
 	};
@@ -620,6 +794,7 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 {
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	snd_pcm_t *slave = svol->plug.gen.slave;
+	unsigned int channels, rate, period;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_softvol_hw_refine_cchange,
 					  snd_pcm_softvol_hw_refine_sprepare,
@@ -632,12 +807,37 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 	    slave->format != SND_PCM_FORMAT_S24_3LE && 
 	    slave->format != SND_PCM_FORMAT_S24_LE &&
 	    slave->format != SND_PCM_FORMAT_S32_LE &&
-	    slave->format != SND_PCM_FORMAT_S32_BE) {
+	    slave->format != SND_PCM_FORMAT_S32_BE &&
+	    slave->format != SND_PCM_FORMAT_FLOAT &&
+	    slave->format != SND_PCM_FORMAT_FLOAT64) {
 		SNDERR("softvol supports only S16_LE, S16_BE, S24_LE, S24_3LE, "
-		       "S32_LE or S32_BE");
+		       "S32_LE, S32_BE, FLOAT or FLOAT64");
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	err = INTERNAL(snd_pcm_hw_params_get_rate)(params, &rate, 0);
+	if (err < 0)
+		return err;
+	/* the gain table repeats after the least common multiple */
+	for (period = channels; period % SOFTVOL_GAIN_ALIGN; period += channels)
+		;
+	free(svol->ramp_gain);
+	svol->ramp_gain = malloc(channels * 2 * sizeof(double) +
+				 channels * sizeof(unsigned int) +
+				 (period + SOFTVOL_GAIN_ALIGN) * sizeof(unsigned int));
+	if (!svol->ramp_gain)
+		return -ENOMEM;
+	svol->ramp_step = svol->ramp_gain + channels;
+	svol->gain = (unsigned int *)(svol->ramp_step + channels);
+	svol->gain_table = svol->gain + channels;
+	svol->gain_period = period;
+	svol->gains_valid = 0;
+	svol->ramp_frames = (snd_pcm_uframes_t)svol->ramp_time * rate / 1000;
+	svol->ramp_left = 0;
+	svol->gain_func = softvol_select_gain(svol->sformat);
 	return 0;
 }
 
@@ -653,13 +853,9 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_update_gains(pcm);
+	softvol_convert(svol, slave_areas, slave_offset,
+			areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -676,13 +872,9 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_update_gains(pcm);
+	softvol_convert(svol, areas, offset, slave_areas,
+			slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -699,6 +891,9 @@ static void snd_pcm_softvol_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "max_dB: %g\n", svol->max_dB);
 		snd_output_printf(out, "resolution: %d\n", svol->max_val + 1);
 	}
+	if (svol->ramp_time)
+		snd_output_printf(out, "ramp: %u ms, %s\n", svol->ramp_time,
+				  svol->ramp_exp ? "exponential" : "linear");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -920,7 +1115,9 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	    sformat != SND_PCM_FORMAT_S24_3LE && 
 	    sformat != SND_PCM_FORMAT_S24_LE &&
 	    sformat != SND_PCM_FORMAT_S32_LE &&
-	    sformat != SND_PCM_FORMAT_S32_BE)
+	    sformat != SND_PCM_FORMAT_S32_BE &&
+	    sformat != SND_PCM_FORMAT_FLOAT &&
+	    sformat != SND_PCM_FORMAT_FLOAT64)
 		return -EINVAL;
 	svol = calloc(1, sizeof(*svol));
 	if (! svol)
@@ -984,6 +1181,8 @@ int snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id, int
 
 This plugin applies the software volume attenuation.
 The format, rate and channels must match for both of source and destination.
+The float formats (FLOAT and FLOAT64 in the host byte order) are scaled
+directly, so the plugin can sit in a float chain without conversions.
 
 When the control is stereo (count=2), the channels are assumed to be either
 mono, 2.0, 2.1, 4.0, 4.1, 5.1 or 7.1.
@@ -1016,9 +1215,16 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp_time INT]         # volume ramp length in ms (default: 0)
+	[ramp_curve STR]        # linear or exponential (default: linear)
 }
 \endcode
 
+When ramp_time is set, a volume change does not jump to the new gain, it
+is ramped on each channel over the given time, either with equal gain
+steps (linear) or with equal dB steps (exponential). This avoids the
+clicks of large volume steps.
+
 \subsection pcm_plugins_softvol_funcref Function reference
 
 <UL>
@@ -1056,6 +1262,8 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	long ramp_time = 0;
+	int ramp_exp = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1098,6 +1306,31 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "ramp_time") == 0) {
+			err = snd_config_get_integer(n, &ramp_time);
+			if (err < 0 || ramp_time < 0 || ramp_time > 10000) {
+				SNDERR("Invalid ramp_time value");
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "ramp_curve") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "linear") == 0)
+				ramp_exp = 0;
+			else if (strcmp(str, "exponential") == 0)
+				ramp_exp = 1;
+			else {
+				SNDERR("Invalid ramp_curve value %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1140,8 +1373,10 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		    sformat != SND_PCM_FORMAT_S24_3LE && 
 		    sformat != SND_PCM_FORMAT_S24_LE &&
 		    sformat != SND_PCM_FORMAT_S32_LE &&
-		    sformat != SND_PCM_FORMAT_S32_BE) {
-			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE or S32_BE format is supported");
+		    sformat != SND_PCM_FORMAT_S32_BE &&
+		    sformat != SND_PCM_FORMAT_FLOAT &&
+		    sformat != SND_PCM_FORMAT_FLOAT64) {
+			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE, S32_BE, FLOAT or FLOAT64 format is supported");
 			snd_config_delete(sconf);
 			return -EINVAL;
 		}
@@ -1160,6 +1395,11 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 					   resolution, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
+		else if (*pcmp != spcm) {
+			snd_pcm_softvol_t *svol = (*pcmp)->private_data;
+			svol->ramp_time = ramp_time;
+			svol->ramp_exp = ramp_exp;
+		}
 	}
 	return err;
 }
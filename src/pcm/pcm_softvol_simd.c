@@ -0,0 +1,449 @@
+/*
+ * vectorized volume code (SSE2, AVX2, NEON)
+ *
+ * The kernels apply the per-sample gains of a repeating table to
+ * contiguous (interleaved) samples in the host byte order.  The gains are
+ * the 16-bit fractions of the softvol code, 0xffff passes the sample
+ * unchanged; larger gains are left to the scalar code for the integer
+ * formats, the float formats take any gain.  The results are bit-exact to
+ * the MULTI_DIV_*() helpers and to the float scaling of the scalar code.
+ */
+
+#include "pcm_simd.h"
+
+/*
+ * the gains repeat after period entries, the period is a multiple of the
+ * channels and of SOFTVOL_GAIN_ALIGN, so the vectors never wrap inside
+ * the table; the table holds SOFTVOL_GAIN_ALIGN more entries for the tail
+ */
+#define SOFTVOL_GAIN_ALIGN	16
+
+typedef void (*softvol_gain_f)(void *dst, const void *src,
+			       unsigned int samples,
+			       const unsigned int *gains, unsigned int period);
+
+static inline int softvol_gain_sample(int a, unsigned int gain)
+{
+	if (gain == 0xffff)
+		return a;
+	return (int)(((long long)a * gain) >> 16);
+}
+
+static void generic_gain_s16(int16_t *dst, const int16_t *src,
+			     unsigned int samples, const unsigned int *gains)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = softvol_gain_sample(src[i], gains[i]);
+}
+
+static void generic_gain_s32(int32_t *dst, const int32_t *src,
+			     unsigned int samples, const unsigned int *gains)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = softvol_gain_sample(src[i], gains[i]);
+}
+
+/* the float factor of a gain, as softvol_gain_factor() */
+static inline double softvol_gain_double(unsigned int gain)
+{
+	return gain == 0xffff ? 1.0 : gain / 65536.0;
+}
+
+static void generic_gain_float(float *dst, const float *src,
+			       unsigned int samples, const unsigned int *gains)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = src[i] * (float)softvol_gain_double(gains[i]);
+}
+
+static void generic_gain_float64(double *dst, const double *src,
+				 unsigned int samples, const unsigned int *gains)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = src[i] * softvol_gain_double(gains[i]);
+}
+
+static void generic_gain_s24_3le(uint8_t *dst, const uint8_t *src,
+				 unsigned int samples, const unsigned int *gains)
+{
+	unsigned int i;
+	int v;
+
+	for (i = 0; i < samples; i++, src += 3, dst += 3) {
+		v = src[0] | (src[1] << 8) | (((const int8_t *)src)[2] << 16);
+		v = softvol_gain_sample(v, gains[i]);
+		dst[0] = v;
+		dst[1] = v >> 8;
+		dst[2] = v >> 16;
+	}
+}
+
+#if defined(SND_PCM_SIMD_X86)
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_gain_s16(void *dst, const void *src, unsigned int samples,
+			  const unsigned int *gains, unsigned int period)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i g_lo = _mm_loadu_si128((const __m128i *)(gains + j));
+		__m128i g_hi = _mm_loadu_si128((const __m128i *)(gains + j + 4));
+		__m128i g, r, copy;
+
+		/* the gains fit in 16 bits, keep them over the signed pack */
+		g_lo = _mm_srai_epi32(_mm_slli_epi32(g_lo, 16), 16);
+		g_hi = _mm_srai_epi32(_mm_slli_epi32(g_hi, 16), 16);
+		g = _mm_packs_epi32(g_lo, g_hi);
+		/* pmulhw is signed, gains from 0x8000 up need a + a * (g - 0x10000) */
+		r = _mm_add_epi16(_mm_mulhi_epi16(a, g),
+				  _mm_and_si128(a, _mm_srai_epi16(g, 15)));
+		copy = _mm_cmpeq_epi16(g, _mm_set1_epi16(-1));
+		r = _mm_or_si128(_mm_and_si128(copy, a), _mm_andnot_si128(copy, r));
+		_mm_storeu_si128((__m128i *)(d + i), r);
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s16(d + i, s + i, samples - i, gains + j);
+}
+
+/*
+ * the gains are below 2^31 and the scaling by 2^-16 is exact, so the
+ * factors are rounded once like the double to float conversion of the
+ * scalar code
+ */
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_gain_float(void *dst, const void *src, unsigned int samples,
+			    const unsigned int *gains, unsigned int period)
+{
+	const float *s = src;
+	float *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i g = _mm_loadu_si128((const __m128i *)(gains + j));
+		__m128 unity = _mm_castsi128_ps(_mm_cmpeq_epi32(g, _mm_set1_epi32(0xffff)));
+		__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(g), _mm_set1_ps(1.0f / 65536));
+
+		f = _mm_or_ps(_mm_and_ps(unity, _mm_set1_ps(1.0f)),
+			      _mm_andnot_ps(unity, f));
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(s + i), f));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_float(d + i, s + i, samples - i, gains + j);
+}
+
+SND_PCM_SIMD_TARGET_SSE2
+static void sse2_gain_float64(void *dst, const void *src, unsigned int samples,
+			      const unsigned int *gains, unsigned int period)
+{
+	const double *s = src;
+	double *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 2 <= samples; i += 2) {
+		__m128i g = _mm_loadl_epi64((const __m128i *)(gains + j));
+		__m128i eq = _mm_cmpeq_epi32(g, _mm_set1_epi32(0xffff));
+		/* the 32-bit compare results widened to the 64-bit lanes */
+		__m128d unity = _mm_castsi128_pd(_mm_unpacklo_epi32(eq, eq));
+		__m128d f = _mm_mul_pd(_mm_cvtepi32_pd(g), _mm_set1_pd(1.0 / 65536));
+
+		f = _mm_or_pd(_mm_and_pd(unity, _mm_set1_pd(1.0)),
+			      _mm_andnot_pd(unity, f));
+		_mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(s + i), f));
+		j += 2;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_float64(d + i, s + i, samples - i, gains + j);
+}
+
+static inline __attribute__((always_inline)) SND_PCM_SIMD_TARGET_AVX2
+__m256i avx2_gain_32(__m256i a, __m256i g)
+{
+	/* the low 32 bits of the 64-bit products shifted by 16 */
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epi32(a, g), 16);
+	__m256i odd = _mm256_slli_epi64(_mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+							 _mm256_srli_epi64(g, 32)), 16);
+	__m256i r = _mm256_blend_epi32(even, odd, 0xaa);
+
+	return _mm256_blendv_epi8(r, a, _mm256_cmpeq_epi32(g, _mm256_set1_epi32(0xffff)));
+}
+
+SND_PCM_SIMD_TARGET_AVX2
+static void avx2_gain_s32(void *dst, const void *src, unsigned int samples,
+			  const unsigned int *gains, unsigned int period)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(gains + j));
+
+		_mm256_storeu_si256((__m256i *)(d + i), avx2_gain_32(a, g));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s32(d + i, s + i, samples - i, gains + j);
+}
+
+SND_PCM_SIMD_TARGET_AVX2
+static void avx2_gain_s24_3le(void *dst, const void *src, unsigned int samples,
+			      const unsigned int *gains, unsigned int period)
+{
+	/* 4 samples of each 128-bit lane to the upper bytes of 32-bit words */
+	const __m256i unpack = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+						-1, 6, 7, 8, -1, 9, 10, 11,
+						-1, 0, 1, 2, -1, 3, 4, 5,
+						-1, 6, 7, 8, -1, 9, 10, 11);
+	const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+					      10, 12, 13, 14, -1, -1, -1, -1,
+					      0, 1, 2, 4, 5, 6, 8, 9,
+					      10, 12, 13, 14, -1, -1, -1, -1);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i, j = 0;
+	uint32_t tail;
+
+	/* the loads of the upper lanes read 4 bytes beyond the 8 samples */
+	for (i = 0; i + 10 <= samples; i += 8, s += 24, d += 24) {
+		__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)s)),
+						    _mm_loadu_si128((const __m128i *)(s + 12)), 1);
+		__m256i g = _mm256_loadu_si256((const __m256i *)(gains + j));
+		__m128i r_lo, r_hi;
+		__m256i r;
+
+		a = _mm256_srai_epi32(_mm256_shuffle_epi8(a, unpack), 8);
+		r = _mm256_shuffle_epi8(avx2_gain_32(a, g), pack);
+		r_lo = _mm256_castsi256_si128(r);
+		r_hi = _mm256_extracti128_si256(r, 1);
+		_mm_storel_epi64((__m128i *)d, r_lo);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(r_lo, 8));
+		memcpy(d + 8, &tail, 4);
+		_mm_storel_epi64((__m128i *)(d + 12), r_hi);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(r_hi, 8));
+		memcpy(d + 20, &tail, 4);
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s24_3le(d, s, samples - i, gains + j);
+}
+
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+
+static void neon_gain_s16(void *dst, const void *src, unsigned int samples,
+			  const unsigned int *gains, unsigned int period)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		int16x8_t a = vld1q_s16(s + i);
+		uint32x4_t g_lo = vld1q_u32(gains + j);
+		uint32x4_t g_hi = vld1q_u32(gains + j + 4);
+		int32x4_t lo, hi;
+		uint16x8_t copy;
+
+		lo = vmulq_s32(vmovl_s16(vget_low_s16(a)), vreinterpretq_s32_u32(g_lo));
+		hi = vmulq_s32(vmovl_s16(vget_high_s16(a)), vreinterpretq_s32_u32(g_hi));
+		copy = vceqq_u16(vcombine_u16(vmovn_u32(g_lo), vmovn_u32(g_hi)),
+				 vdupq_n_u16(0xffff));
+		vst1q_s16(d + i, vbslq_s16(copy, a,
+					   vcombine_s16(vshrn_n_s32(lo, 16),
+							vshrn_n_s32(hi, 16))));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s16(d + i, s + i, samples - i, gains + j);
+}
+
+static inline int32x4_t neon_gain_32(int32x4_t a, uint32x4_t g)
+{
+	int32x4_t gs = vreinterpretq_s32_u32(g);
+	int32x4_t r = vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(a), vget_low_s32(gs)), 16),
+				   vshrn_n_s64(vmull_s32(vget_high_s32(a), vget_high_s32(gs)), 16));
+
+	return vbslq_s32(vceqq_u32(g, vdupq_n_u32(0xffff)), a, r);
+}
+
+static void neon_gain_s32(void *dst, const void *src, unsigned int samples,
+			  const unsigned int *gains, unsigned int period)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		vst1q_s32(d + i, neon_gain_32(vld1q_s32(s + i), vld1q_u32(gains + j)));
+		vst1q_s32(d + i + 4, neon_gain_32(vld1q_s32(s + i + 4),
+						  vld1q_u32(gains + j + 4)));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s32(d + i, s + i, samples - i, gains + j);
+}
+
+/* 4 samples from the byte planes, sign extended */
+static inline int32x4_t neon_s24_unpack(uint8x8_t b0, uint8x8_t b1, int8x8_t b2, int high)
+{
+	uint16x8_t mid = vorrq_u16(vmovl_u8(b0), vshlq_n_u16(vmovl_u8(b1), 8));
+	int16x8_t top = vmovl_s8(b2);
+
+	if (high)
+		return vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(top)), 16),
+				 vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(mid))));
+	return vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(top)), 16),
+			 vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(mid))));
+}
+
+static void neon_gain_s24_3le(void *dst, const void *src, unsigned int samples,
+			      const unsigned int *gains, unsigned int period)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	unsigned int i, j = 0, k;
+
+	for (i = 0; i + 16 <= samples; i += 16, s += 48, d += 48) {
+		uint8x16x3_t b = vld3q_u8(s);
+		int32x4_t v[4];
+		uint16x8_t lo16, hi16;
+
+		for (k = 0; k < 2; k++) {
+			uint8x8_t b0 = k ? vget_high_u8(b.val[0]) : vget_low_u8(b.val[0]);
+			uint8x8_t b1 = k ? vget_high_u8(b.val[1]) : vget_low_u8(b.val[1]);
+			int8x8_t b2 = vreinterpret_s8_u8(k ? vget_high_u8(b.val[2]) :
+							     vget_low_u8(b.val[2]));
+			v[2 * k] = neon_s24_unpack(b0, b1, b2, 0);
+			v[2 * k + 1] = neon_s24_unpack(b0, b1, b2, 1);
+		}
+		for (k = 0; k < 4; k++)
+			v[k] = neon_gain_32(v[k], vld1q_u32(gains + j + 4 * k));
+		for (k = 0; k < 3; k++) {
+			int32x4_t s0 = vshlq_s32(v[0], vdupq_n_s32(-8 * (int)k));
+			int32x4_t s1 = vshlq_s32(v[1], vdupq_n_s32(-8 * (int)k));
+			int32x4_t s2 = vshlq_s32(v[2], vdupq_n_s32(-8 * (int)k));
+			int32x4_t s3 = vshlq_s32(v[3], vdupq_n_s32(-8 * (int)k));
+			lo16 = vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(s0)),
+					    vmovn_u32(vreinterpretq_u32_s32(s1)));
+			hi16 = vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(s2)),
+					    vmovn_u32(vreinterpretq_u32_s32(s3)));
+			b.val[k] = vcombine_u8(vmovn_u16(lo16), vmovn_u16(hi16));
+		}
+		vst3q_u8(d, b);
+		j += 16;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_s24_3le(d, s, samples - i, gains + j);
+}
+
+static inline float32x4_t neon_gain_factor(uint32x4_t g)
+{
+	float32x4_t f = vmulq_n_f32(vcvtq_f32_u32(g), 1.0f / 65536);
+
+	return vbslq_f32(vceqq_u32(g, vdupq_n_u32(0xffff)), vdupq_n_f32(1.0f), f);
+}
+
+static void neon_gain_float(void *dst, const void *src, unsigned int samples,
+			    const unsigned int *gains, unsigned int period)
+{
+	const float *s = src;
+	float *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		vst1q_f32(d + i, vmulq_f32(vld1q_f32(s + i),
+					   neon_gain_factor(vld1q_u32(gains + j))));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_float(d + i, s + i, samples - i, gains + j);
+}
+
+static inline float64x2_t neon_gain_factor64(uint32x2_t g)
+{
+	uint64x2_t g64 = vmovl_u32(g);
+	float64x2_t f = vmulq_n_f64(vcvtq_f64_u64(g64), 1.0 / 65536);
+
+	return vbslq_f64(vceqq_u64(g64, vdupq_n_u64(0xffff)), vdupq_n_f64(1.0), f);
+}
+
+static void neon_gain_float64(void *dst, const void *src, unsigned int samples,
+			      const unsigned int *gains, unsigned int period)
+{
+	const double *s = src;
+	double *d = dst;
+	unsigned int i, j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		uint32x4_t g = vld1q_u32(gains + j);
+
+		vst1q_f64(d + i, vmulq_f64(vld1q_f64(s + i),
+					   neon_gain_factor64(vget_low_u32(g))));
+		vst1q_f64(d + i + 2, vmulq_f64(vld1q_f64(s + i + 2),
+					       neon_gain_factor64(vget_high_u32(g))));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	generic_gain_float64(d + i, s + i, samples - i, gains + j);
+}
+
+#endif
+
+/* returns NULL when the format has no vector kernel on this machine */
+static softvol_gain_f softvol_select_gain(snd_pcm_format_t format)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+
+#if defined(SND_PCM_SIMD_X86)
+	if (format == SND_PCM_FORMAT_S16 && (caps & SND_PCM_SIMD_SSE2))
+		return sse2_gain_s16;
+	if (format == SND_PCM_FORMAT_S32 && (caps & SND_PCM_SIMD_AVX2))
+		return avx2_gain_s32;
+	if (format == SND_PCM_FORMAT_S24_3LE && (caps & SND_PCM_SIMD_AVX2))
+		return avx2_gain_s24_3le;
+	if (format == SND_PCM_FORMAT_FLOAT && (caps & SND_PCM_SIMD_SSE2))
+		return sse2_gain_float;
+	if (format == SND_PCM_FORMAT_FLOAT64 && (caps & SND_PCM_SIMD_SSE2))
+		return sse2_gain_float64;
+#elif defined(SND_PCM_SIMD_NEON_ARM64)
+	if (caps & SND_PCM_SIMD_NEON) {
+		if (format == SND_PCM_FORMAT_S16)
+			return neon_gain_s16;
+		if (format == SND_PCM_FORMAT_S32)
+			return neon_gain_s32;
+		if (format == SND_PCM_FORMAT_S24_3LE)
+			return neon_gain_s24_3le;
+		if (format == SND_PCM_FORMAT_FLOAT)
+			return neon_gain_float;
+		if (format == SND_PCM_FORMAT_FLOAT64)
+			return neon_gain_float64;
+	}
+#endif
+	(void)caps;
+	(void)format;
+	return NULL;
+}
@@ -39,6 +39,25 @@ static inline uint32_t sx24s(uint32_t x)
 		return x|0x000000FF;
 	return x&0xFFFFFF00;
 }
+
+/*
+ * float samples scaled to 32 bits, rounded to the nearest and clamped
+ * like the direct conversion of the lfloat plugin, NaN gives the minimum
+ */
+static inline uint32_t get32_round_float(float v)
+{
+	if (v >= 2147483648.0f)
+		return 0x7fffffff;
+	if (!(v > -2147483648.0f))
+		return 0x80000000;
+	return (int32_t)__builtin_lrintf(v);
+}
+static inline uint32_t get32_round_double(double v)
+{
+	v = v > -2147483648.0 ? v : -2147483648.0;
+	v = v < 2147483647.0 ? v : 2147483647.0;
+	return (int32_t)__builtin_lrint(v);
+}
 #endif
 
 #define as_u8(ptr) (*(uint8_t*)(ptr))
@@ -680,36 +699,16 @@ static void *const get32float_labels[2 * 2] = {
 
 #ifdef GET32F_END
 get32f_1234F_1234: tmp_float.f = as_floatc(src);
-		   if (tmp_float.f >= 1.0)
-		   	sample = 0x7fffffff;
-		   else if (tmp_float.f <= -1.0)
-		   	sample = 0x80000000;
-		   else
-		   	sample = (int32_t)(tmp_float.f * (float_t)0x80000000UL);
+		   sample = get32_round_float(tmp_float.f * (float_t)0x80000000UL);
 		   goto GET32F_END;
 get32f_4321F_1234: tmp_float.i = bswap_32(as_u32c(src));
-		   if (tmp_float.f >= 1.0)
-		   	sample = 0x7fffffff;
-		   else if (tmp_float.f <= -1.0)
-		   	sample = 0x80000000;
-		   else
-		   	sample = (int32_t)(tmp_float.f * (float_t)0x80000000UL);
+		   sample = get32_round_float(tmp_float.f * (float_t)0x80000000UL);
 		   goto GET32F_END;
 get32f_1234D_1234: tmp_double.d = as_doublec(src);
-		   if (tmp_double.d >= 1.0)
-		   	sample = 0x7fffffff;
-		   else if (tmp_double.d <= -1.0)
-		   	sample = 0x80000000;
-		   else
-		   	sample = (int32_t)(tmp_double.d * (double_t)0x80000000UL);
+		   sample = get32_round_double(tmp_double.d * (double_t)0x80000000UL);
 		   goto GET32F_END;
 get32f_4321D_1234: tmp_double.l = bswap_64(as_u64c(src));
-		   if (tmp_double.d >= 1.0)
-		   	sample = 0x7fffffff;
-		   else if (tmp_double.d <= -1.0)
-		   	sample = 0x80000000;
-		   else
-		   	sample = (int32_t)(tmp_double.d * (double_t)0x80000000UL);
+		   sample = get32_round_double(tmp_double.d * (double_t)0x80000000UL);
 		   goto GET32F_END;
 #endif
 
@@ -438,6 +438,60 @@ int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *
         return -EINVAL;
 }
 
+static int evloop_rawmidi_count(void *handle, short events ATTRIBUTE_UNUSED)
+{
+	return snd_rawmidi_poll_descriptors_count(handle);
+}
+
+static int evloop_rawmidi_descriptors(void *handle, struct pollfd *pfds,
+				      unsigned int space, short events ATTRIBUTE_UNUSED)
+{
+	return snd_rawmidi_poll_descriptors(handle, pfds, space);
+}
+
+static int evloop_rawmidi_revents(void *handle, struct pollfd *pfds,
+				  unsigned int nfds, unsigned short *revents)
+{
+	return snd_rawmidi_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const evloop_source_ops_t evloop_rawmidi_ops = {
+	.descriptors_count = evloop_rawmidi_count,
+	.descriptors = evloop_rawmidi_descriptors,
+	.revents = evloop_rawmidi_revents,
+};
+
+/**
+ * \brief Add a RawMidi to an event loop
+ * \param source Returned source handle
+ * \param loop Event loop
+ * \param rmidi RawMidi handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback gets the revents demangled by
+ * #snd_rawmidi_poll_descriptors_revents().
+ */
+int snd_evloop_add_rawmidi(snd_evloop_source_t **source, snd_evloop_t *loop,
+			   snd_rawmidi_t *rmidi, snd_evloop_callback_t callback,
+			   void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_RAWMIDI, rmidi,
+				     &evloop_rawmidi_ops, 0,
+				     callback, private_data);
+}
+
+/**
+ * \brief Return the RawMidi handle of an event loop source
+ * \param source Source handle
+ * \return RawMidi handle
+ */
+snd_rawmidi_t *snd_evloop_source_get_rawmidi(snd_evloop_source_t *source)
+{
+	return snd_evloop_source_handle(source, EVLOOP_SOURCE_RAWMIDI);
+}
+
 /**
  * \brief set nonblock mode
  * \param rawmidi RawMidi handle
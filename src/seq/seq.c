@@ -1134,6 +1134,61 @@ int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsign
         return -EINVAL;
 }
 
+static int evloop_seq_count(void *handle, short events)
+{
+	return snd_seq_poll_descriptors_count(handle, events);
+}
+
+static int evloop_seq_descriptors(void *handle, struct pollfd *pfds,
+				  unsigned int space, short events)
+{
+	return snd_seq_poll_descriptors(handle, pfds, space, events);
+}
+
+static int evloop_seq_revents(void *handle, struct pollfd *pfds,
+			      unsigned int nfds, unsigned short *revents)
+{
+	return snd_seq_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const evloop_source_ops_t evloop_seq_ops = {
+	.descriptors_count = evloop_seq_count,
+	.descriptors = evloop_seq_descriptors,
+	.revents = evloop_seq_revents,
+};
+
+/**
+ * \brief Add a sequencer to an event loop
+ * \param source Returned source handle
+ * \param loop Event loop
+ * \param seq sequencer handle
+ * \param events The poll events, POLLIN and/or POLLOUT
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback gets the revents demangled by
+ * #snd_seq_poll_descriptors_revents().
+ */
+int snd_evloop_add_seq(snd_evloop_source_t **source, snd_evloop_t *loop,
+		       snd_seq_t *seq, short events,
+		       snd_evloop_callback_t callback, void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_SEQ, seq,
+				     &evloop_seq_ops, events,
+				     callback, private_data);
+}
+
+/**
+ * \brief Return the sequencer handle of an event loop source
+ * \param source Source handle
+ * \return sequencer handle
+ */
+snd_seq_t *snd_evloop_source_get_seq(snd_evloop_source_t *source)
+{
+	return snd_evloop_source_handle(source, EVLOOP_SOURCE_SEQ);
+}
+
 /**
  * \brief Set nonblock mode
  * \param seq sequencer handle
@@ -331,6 +331,60 @@ snd_timer_t *snd_async_handler_get_timer(snd_async_handler_t *handler)
 	return handler->u.timer;
 }                                                            
 
+static int evloop_timer_count(void *handle, short events ATTRIBUTE_UNUSED)
+{
+	return snd_timer_poll_descriptors_count(handle);
+}
+
+static int evloop_timer_descriptors(void *handle, struct pollfd *pfds,
+				    unsigned int space, short events ATTRIBUTE_UNUSED)
+{
+	return snd_timer_poll_descriptors(handle, pfds, space);
+}
+
+static int evloop_timer_revents(void *handle, struct pollfd *pfds,
+				unsigned int nfds, unsigned short *revents)
+{
+	return snd_timer_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const evloop_source_ops_t evloop_timer_ops = {
+	.descriptors_count = evloop_timer_count,
+	.descriptors = evloop_timer_descriptors,
+	.revents = evloop_timer_revents,
+};
+
+/**
+ * \brief Add a timer to an event loop
+ * \param source Returned source handle
+ * \param loop Event loop
+ * \param timer timer handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback gets the revents demangled by
+ * #snd_timer_poll_descriptors_revents().
+ */
+int snd_evloop_add_timer(snd_evloop_source_t **source, snd_evloop_t *loop,
+			 snd_timer_t *timer, snd_evloop_callback_t callback,
+			 void *private_data)
+{
+	return snd_evloop_add_source(source, loop, EVLOOP_SOURCE_TIMER, timer,
+				     &evloop_timer_ops, 0,
+				     callback, private_data);
+}
+
+/**
+ * \brief Return the timer handle of an event loop source
+ * \param source Source handle
+ * \return timer handle
+ */
+snd_timer_t *snd_evloop_source_get_timer(snd_evloop_source_t *source)
+{
+	return snd_evloop_source_handle(source, EVLOOP_SOURCE_TIMER);
+}
+
 /**
  * \brief get count of poll descriptors for timer handle
  * \param timer timer handle
@@ -0,0 +1,162 @@
+/*
+ * direct plugins lock benchmark
+ *
+ * Measures the cost of one lock/unlock pair of the lock serializing
+ * the dmix clients (once per commit), for the SysV semaphore and for
+ * the robust mutex in the shared memory area.  The given number of
+ * processes hammers the lock concurrently, each one doing a little
+ * work while holding it.
+ *
+ *   direct-lock-bench -p 4 -n 1000000 -w 64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/wait.h>
+#include "pcm_direct.h"
+
+static int processes = 1;
+static long iterations = 1000000;
+static int work = 16;
+
+struct bench_shm {
+	snd_pcm_direct_share_t share;
+	long counter;
+	int buf[1024];
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: direct-lock-bench [-options]\n");
+	fprintf(stderr, "  -p val  Set number of processes\n");
+	fprintf(stderr, "  -n val  Set number of commits per process\n");
+	fprintf(stderr, "  -w val  Set samples touched while holding the lock\n");
+}
+
+static void worker(snd_pcm_direct_t *dmix, struct bench_shm *shm)
+{
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		snd_pcm_direct_lock(dmix);
+		for (j = 0; j < work; j++)
+			shm->buf[j]++;
+		shm->counter++;
+		snd_pcm_direct_unlock(dmix);
+	}
+}
+
+static int run(const char *name, unsigned int lock)
+{
+	struct timespec start, end;
+	snd_pcm_direct_t dmix;
+	struct bench_shm *shm;
+	int shmid, i, status, failed = 0;
+	double ns;
+	pid_t pid;
+
+	memset(&dmix, 0, sizeof(dmix));
+	dmix.semid = semget(IPC_PRIVATE, DIRECT_IPC_SEMS, IPC_CREAT | 0600);
+	if (dmix.semid < 0) {
+		perror("semget");
+		return 1;
+	}
+	shmid = shmget(IPC_PRIVATE, sizeof(*shm), IPC_CREAT | 0600);
+	if (shmid < 0) {
+		perror("shmget");
+		snd_pcm_direct_semaphore_discard(&dmix);
+		return 1;
+	}
+	shm = shmat(shmid, 0, 0);
+	shmctl(shmid, IPC_RMID, NULL);
+	if (shm == (void *) -1) {
+		perror("shmat");
+		snd_pcm_direct_semaphore_discard(&dmix);
+		return 1;
+	}
+	memset(shm, 0, sizeof(*shm));
+	shm->share.ipc_lock = lock;
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	if (lock == SND_PCM_DIRECT_IPC_LOCK_FUTEX &&
+	    snd_pcm_direct_robust_init(&shm->share.lock) < 0) {
+		fprintf(stderr, "cannot set up the robust mutex\n");
+		shmdt(shm);
+		snd_pcm_direct_semaphore_discard(&dmix);
+		return 1;
+	}
+#endif
+	dmix.shmptr = &shm->share;
+
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < processes; i++) {
+		pid = fork();
+		if (pid == 0) {
+			worker(&dmix, shm);
+			exit(0);
+		}
+		if (pid < 0) {
+			perror("fork");
+			failed++;
+			break;
+		}
+	}
+	while ((pid = wait(&status)) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%-6s processes %d, %.1f ns per commit (%.1f ns per process)%s\n",
+	       name, processes, ns / (iterations * processes),
+	       ns / iterations,
+	       shm->counter != iterations * processes ? ", COUNTER MISMATCH" : "");
+	if (shm->counter != iterations * processes)
+		failed++;
+	shmdt(shm);
+	snd_pcm_direct_semaphore_discard(&dmix);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	int c, err = 0;
+
+	while ((c = getopt(argc, argv, "p:n:w:")) >= 0) {
+		switch (c) {
+		case 'p':
+			processes = atoi(optarg);
+			break;
+		case 'n':
+			iterations = atol(optarg);
+			break;
+		case 'w':
+			work = atoi(optarg);
+			if (work < 0 || work > 1024) {
+				fprintf(stderr, "invalid work size\n");
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (processes < 1 || iterations < 1) {
+		usage();
+		return 1;
+	}
+	err |= run("sem", SND_PCM_DIRECT_IPC_LOCK_SEM);
+#ifdef DIRECT_HAVE_ROBUST_LOCK
+	err |= run("futex", SND_PCM_DIRECT_IPC_LOCK_FUTEX);
+#endif
+	return err;
+}
@@ -0,0 +1,201 @@
+/*
+ * dmix throughput benchmark
+ *
+ * Forks the given number of playback clients on a dmix PCM built on top
+ * of the given slave device, lets them write small chunks for a while and
+ * reports the CPU time consumed by all clients.  Each mixing mode
+ * (the shared sum buffer and the per-client staging) is measured in turn.
+ *
+ *   dmix-bench -D hw:0 -n 20 -c 8 -r 192000 -s 10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../include/asoundlib.h"
+
+#define MAX_CLIENTS	256
+
+static const char *slave = "hw:0";
+static int num_clients = 8;
+static int channels = 2;
+static int rate = 48000;
+static int chunk = 64;
+static int seconds = 5;
+static int batch;
+static snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
+
+static const char *modes[] = { "sum", "staging" };
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dmix-bench [-options]\n");
+	fprintf(stderr, "  -D str  Set slave device name\n");
+	fprintf(stderr, "  -n val  Set number of clients\n");
+	fprintf(stderr, "  -c val  Set number of channels\n");
+	fprintf(stderr, "  -r val  Set sample rate\n");
+	fprintf(stderr, "  -f str  Set PCM format\n");
+	fprintf(stderr, "  -p val  Set write chunk size (in frames)\n");
+	fprintf(stderr, "  -s val  Set seconds to run each mode\n");
+	fprintf(stderr, "  -b val  Set mix_batch (in frames)\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "D:n:c:r:f:p:s:b:")) >= 0) {
+		switch (c) {
+		case 'D':
+			slave = optarg;
+			break;
+		case 'n':
+			num_clients = atoi(optarg);
+			if (num_clients < 1 || num_clients > MAX_CLIENTS) {
+				fprintf(stderr, "invalid number of clients\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'f':
+			format = snd_pcm_format_value(optarg);
+			break;
+		case 'p':
+			chunk = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int open_dmix(snd_pcm_t **pcm, const char *mode, int ipc_key)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[512];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.bench { type dmix ipc_key %d mix_mode %s "
+		 "staging_clients %d mix_batch %d slave { pcm \"%s\" format %s "
+		 "channels %d rate %d } }\n",
+		 ipc_key, mode, num_clients, batch, slave,
+		 snd_pcm_format_name(format), channels, rate);
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(&top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "bench", SND_PCM_STREAM_PLAYBACK,
+					 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static int client(const char *mode, int ipc_key)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_sframes_t frames;
+	struct timespec start, now;
+	char *buf;
+	int err, i, bytes;
+
+	err = open_dmix(&pcm, mode, ipc_key);
+	if (err < 0) {
+		fprintf(stderr, "cannot open dmix (%s): %s\n", mode, snd_strerror(err));
+		return 1;
+	}
+	err = snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+				 channels, rate, 0, 100000);
+	if (err < 0) {
+		fprintf(stderr, "cannot set params: %s\n", snd_strerror(err));
+		return 1;
+	}
+	bytes = snd_pcm_frames_to_bytes(pcm, chunk);
+	buf = malloc(bytes);
+	if (!buf)
+		return 1;
+	for (i = 0; i < bytes; i++)
+		buf[i] = rand();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		frames = snd_pcm_writei(pcm, buf, chunk);
+		if (frames < 0 && snd_pcm_recover(pcm, frames, 1) < 0) {
+			fprintf(stderr, "write error: %s\n", snd_strerror(frames));
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec - start.tv_sec < seconds);
+	snd_pcm_drop(pcm);
+	snd_pcm_close(pcm);
+	free(buf);
+	return 0;
+}
+
+static void run(const char *mode, int ipc_key)
+{
+	struct rusage usage;
+	double cpu = 0;
+	int i, status, failed = 0;
+	pid_t pid;
+
+	for (i = 0; i < num_clients; i++) {
+		pid = fork();
+		if (pid == 0)
+			exit(client(mode, ipc_key));
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+	}
+	while ((pid = wait4(-1, &status, 0, &usage)) > 0) {
+		cpu += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+		cpu += usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed++;
+	}
+	printf("%-8s clients %d, failed %d, cpu %.3f s, %.2f %% of one core, "
+	       "%.1f ns per frame and client\n",
+	       mode, num_clients, failed, cpu, cpu * 100.0 / seconds,
+	       cpu * 1e9 / ((double)seconds * rate * num_clients));
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	if (parse_options(argc, argv))
+		return 1;
+	printf("slave %s, %s, %d channels, %d Hz, chunk %d frames, batch %d\n",
+	       slave, snd_pcm_format_name(format), channels, rate, chunk, batch);
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+		run(modes[i], 0x5a000 + (getpid() % 1000) * 8 + i * 4);
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * linear conversion benchmark
+ *
+ * Writes interleaved periods through a linear conversion PCM to a null
+ * slave for all pairs of S16_LE, S24_3LE and S32_LE and reports the time
+ * per frame, once with the per-sample code (run in a child process with
+ * LIBASOUND_NO_SIMD set) and once with the vectorized code.
+ *
+ *   linear-conv-bench -c 2 -p 1024 -s 1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../include/asoundlib.h"
+
+#define PAIRS	6
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32_LE,
+};
+
+static unsigned int channels = 2;
+static unsigned int period_size = 1024;
+static double seconds = 1;
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: linear-conv-bench [-options]\n");
+	fprintf(stderr, "  -c val  Set number of channels\n");
+	fprintf(stderr, "  -p val  Set period size (in frames)\n");
+	fprintf(stderr, "  -s val  Set seconds to run each pair\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "c:p:s:")) >= 0) {
+		switch (c) {
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'p':
+			period_size = atoi(optarg);
+			break;
+		case 's':
+			seconds = atof(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (channels < 1 || !period_size || seconds <= 0) {
+		usage();
+		return 1;
+	}
+	return 0;
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int open_linear(snd_pcm_t **pcm, snd_pcm_format_t sformat)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.l { type linear slave { format %s pcm { type null } } }",
+		 snd_pcm_format_name(sformat));
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "l", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+/* returns the ns per frame, or a negative value on error */
+static double run(snd_pcm_format_t format, snd_pcm_format_t sformat)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size = period_size;
+	unsigned long frames = 0;
+	struct timespec start;
+	double t, ns = -1;
+	char *buf = NULL;
+	unsigned int i;
+	long len;
+	int err;
+
+	err = open_linear(&pcm, sformat);
+	if (err < 0) {
+		fprintf(stderr, "cannot open the linear PCM: %s\n", snd_strerror(err));
+		return -1;
+	}
+	snd_pcm_hw_params_alloca(&hw);
+	if (snd_pcm_hw_params_any(pcm, hw) < 0 ||
+	    snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED) < 0 ||
+	    snd_pcm_hw_params_set_format(pcm, hw, format) < 0 ||
+	    snd_pcm_hw_params_set_channels(pcm, hw, channels) < 0 ||
+	    snd_pcm_hw_params_set_rate(pcm, hw, 48000, 0) < 0 ||
+	    snd_pcm_hw_params_set_period_size_near(pcm, hw, &size, 0) < 0 ||
+	    snd_pcm_hw_params(pcm, hw) < 0) {
+		fprintf(stderr, "cannot set up %s -> %s\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(sformat));
+		goto out;
+	}
+	len = snd_pcm_frames_to_bytes(pcm, size);
+	buf = malloc(len);
+	if (!buf)
+		goto out;
+	srandom(1);
+	for (i = 0; i < len; i++)
+		buf[i] = random();
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (i = 0; i < 64; i++) {
+			if (snd_pcm_writei(pcm, buf, size) != (snd_pcm_sframes_t)size) {
+				fprintf(stderr, "write error\n");
+				goto out;
+			}
+			frames += size;
+		}
+		t = elapsed(&start);
+	} while (t < seconds);
+	ns = t * 1e9 / frames;
+ out:
+	free(buf);
+	snd_pcm_close(pcm);
+	return ns;
+}
+
+static void run_all(double *res)
+{
+	unsigned int i, j, n = 0;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			if (i != j)
+				res[n++] = run(formats[i], formats[j]);
+}
+
+int main(int argc, char **argv)
+{
+	double scalar[PAIRS], simd[PAIRS];
+	unsigned int i, j, n = 0;
+	int fds[2], status, err = 0;
+	pid_t pid;
+
+	if (parse_options(argc, argv))
+		return 1;
+	printf("%u channels, period %u frames\n", channels, period_size);
+	fflush(stdout);
+
+	/* the SIMD capabilities are probed once per process */
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		setenv("LIBASOUND_NO_SIMD", "1", 1);
+		run_all(scalar);
+		if (write(fds[1], scalar, sizeof(scalar)) != sizeof(scalar))
+			exit(1);
+		exit(0);
+	}
+	close(fds[1]);
+	if (read(fds[0], scalar, sizeof(scalar)) != sizeof(scalar))
+		return 1;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+
+	run_all(simd);
+	printf("%-18s %12s %12s\n", "", "scalar", "simd");
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			char name[32];
+
+			if (i == j)
+				continue;
+			snprintf(name, sizeof(name), "%s -> %s",
+				 snd_pcm_format_name(formats[i]),
+				 snd_pcm_format_name(formats[j]));
+			if (scalar[n] < 0 || simd[n] < 0) {
+				printf("%-18s failed\n", name);
+				err = 1;
+			} else {
+				printf("%-18s %9.2f ns %9.2f ns, %.2fx\n", name,
+				       scalar[n], simd[n], scalar[n] / simd[n]);
+			}
+			n++;
+		}
+	}
+	return err;
+}
@@ -0,0 +1,246 @@
+/*
+ * checks the dmix mixing kernels: the vectorized ones must match the
+ * generic code, the float sum buffer must not clip intermediate sums
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include "pcm_direct.h"
+#include "test.h"
+#include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
+#include "pcm_dmix_float.c"
+
+#define MAX_SAMPLES	1031
+
+static int rnd(int range)
+{
+	return (int)(((unsigned int)random() << 1 ^ random()) % (2U * range + 1)) - range;
+}
+
+static void fill_16(signed short *dst, signed short *src, signed int *sum,
+		    unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		src[i] = rnd(0x8000);
+		dst[i] = random() % 3 ? rnd(0x7fff) : 0;
+		sum[i] = rnd(0x18000);
+	}
+	src[0] = -0x8000;
+	dst[0] = 0;
+}
+
+static void fill_32(signed int *dst, signed int *src, signed int *sum,
+		    unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		src[i] = (int)((unsigned int)random() << 1 ^ random());
+		dst[i] = random() % 3 ? rnd(0x7fffffff) : 0;
+		sum[i] = rnd(0x1800000);
+	}
+}
+
+static void check_16(const char *name, mix_areas_16_t *func, mix_areas_16_t *ref)
+{
+	signed short src[MAX_SAMPLES], dst1[MAX_SAMPLES], dst2[MAX_SAMPLES];
+	signed int sum1[MAX_SAMPLES], sum2[MAX_SAMPLES];
+	unsigned int size, ofs;
+
+	for (size = 1; size < MAX_SAMPLES - 2; size += 1 + size / 4) {
+		ofs = random() % 3;
+		fill_16(dst1, src, sum1, MAX_SAMPLES);
+		memcpy(dst2, dst1, sizeof(dst1));
+		memcpy(sum2, sum1, sizeof(sum1));
+		/* contiguous */
+		func(size, dst1 + ofs, src + ofs, sum1 + ofs,
+		     sizeof(*dst1), sizeof(*src), sizeof(*sum1));
+		ref(size, dst2 + ofs, src + ofs, sum2 + ofs,
+		    sizeof(*dst2), sizeof(*src), sizeof(*sum2));
+		/* strided, like the non-interleaved case */
+		if (size / 2) {
+			func(size / 2, dst1 + 1, src, sum1 + 1,
+			     2 * sizeof(*dst1), 2 * sizeof(*src), 2 * sizeof(*sum1));
+			ref(size / 2, dst2 + 1, src, sum2 + 1,
+			    2 * sizeof(*dst2), 2 * sizeof(*src), 2 * sizeof(*sum2));
+		}
+		if (memcmp(dst1, dst2, sizeof(dst1)) || memcmp(sum1, sum2, sizeof(sum1))) {
+			fprintf(stderr, "%s: mismatch for size %u\n", name, size);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+static void check_32(const char *name, mix_areas_32_t *func, mix_areas_32_t *ref)
+{
+	signed int src[MAX_SAMPLES], dst1[MAX_SAMPLES], dst2[MAX_SAMPLES];
+	signed int sum1[MAX_SAMPLES], sum2[MAX_SAMPLES];
+	unsigned int size, ofs;
+
+	for (size = 1; size < MAX_SAMPLES - 2; size += 1 + size / 4) {
+		ofs = random() % 3;
+		fill_32(dst1, src, sum1, MAX_SAMPLES);
+		memcpy(dst2, dst1, sizeof(dst1));
+		memcpy(sum2, sum1, sizeof(sum1));
+		func(size, dst1 + ofs, src + ofs, sum1 + ofs,
+		     sizeof(*dst1), sizeof(*src), sizeof(*sum1));
+		ref(size, dst2 + ofs, src + ofs, sum2 + ofs,
+		    sizeof(*dst2), sizeof(*src), sizeof(*sum2));
+		if (memcmp(dst1, dst2, sizeof(dst1)) || memcmp(sum1, sum2, sizeof(sum1))) {
+			fprintf(stderr, "%s: mismatch for size %u\n", name, size);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+static void check_callbacks(const char *name, snd_pcm_direct_t *dmix)
+{
+	char id[64];
+
+	snprintf(id, sizeof(id), "%s mix_areas_16", name);
+	check_16(id, dmix->u.dmix.mix_areas_16, generic_mix_areas_16_native);
+	snprintf(id, sizeof(id), "%s remix_areas_16", name);
+	check_16(id, dmix->u.dmix.remix_areas_16, generic_remix_areas_16_native);
+	snprintf(id, sizeof(id), "%s mix_areas_32", name);
+	check_32(id, dmix->u.dmix.mix_areas_32, generic_mix_areas_32_native);
+	snprintf(id, sizeof(id), "%s remix_areas_32", name);
+	check_32(id, dmix->u.dmix.remix_areas_32, generic_remix_areas_32_native);
+}
+
+/* two float clients on a float sum buffer with a S16 slave */
+static void check_float(void)
+{
+	float a[MAX_SAMPLES], b[MAX_SAMPLES], sum[MAX_SAMPLES];
+	signed short dst[MAX_SAMPLES];
+	unsigned int i;
+
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		a[i] = rnd(0x7fff) / 32768.0f;
+		b[i] = rnd(0x7fff) / 32768.0f;
+		if (a[i] > -0.001f && a[i] < 0.001f)
+			a[i] = 0.5f;
+	}
+	a[0] = b[0] = 0.9f;	/* clipped sum */
+	memset(dst, 0, sizeof(dst));
+	memset(sum, 0xff, sizeof(sum));
+	float_mix_areas_16_float(MAX_SAMPLES, dst, a, (signed int *)sum,
+				 sizeof(*dst), sizeof(*a), sizeof(*sum));
+	float_mix_areas_16_float(MAX_SAMPLES, dst, b, (signed int *)sum,
+				 sizeof(*dst), sizeof(*b), sizeof(*sum));
+	TEST_CHECK(dst[0] == 0x7fff);
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		if (dst[i] != float_mix_to_16(a[i] + b[i])) {
+			fprintf(stderr, "float mix: mismatch at %u\n", i);
+			any_test_failed = 1;
+			return;
+		}
+	}
+	/* the rewound client leaves the other one intact, even if clipped */
+	float_remix_areas_16_float(MAX_SAMPLES, dst, b, (signed int *)sum,
+				   sizeof(*dst), sizeof(*b), sizeof(*sum));
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		if (dst[i] != float_mix_to_16(a[i])) {
+			fprintf(stderr, "float remix: mismatch at %u\n", i);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+/* a client sending NaNs and infinities can be rewound without a NaN left */
+static void check_float_nonfinite(void)
+{
+	float a[MAX_SAMPLES], b[MAX_SAMPLES], sum[MAX_SAMPLES];
+	signed int dst[MAX_SAMPLES];
+	static const float big[2] = { 1.0e30f, -1.0e30f };
+	unsigned int i;
+
+	TEST_CHECK(float_mix_to_16(__builtin_nanf("")) == 0);
+	TEST_CHECK(float_mix_to_32(__builtin_nanf("")) == 0);
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		switch (i % 4) {
+		case 0:
+			a[i] = __builtin_inff();
+			break;
+		case 1:
+			a[i] = -__builtin_inff();
+			break;
+		case 2:
+			a[i] = __builtin_nanf("");
+			break;
+		default:
+			a[i] = big[i / 4 % 2];
+			break;
+		}
+		b[i] = rnd(0x7fff) / 32768.0f;
+	}
+	memset(dst, 0, sizeof(dst));
+	memset(sum, 0, sizeof(sum));
+	float_mix_areas_32_float(MAX_SAMPLES, dst, b, (signed int *)sum,
+				 sizeof(*dst), sizeof(*b), sizeof(*sum));
+	float_mix_areas_32_float(MAX_SAMPLES, dst, a, (signed int *)sum,
+				 sizeof(*dst), sizeof(*a), sizeof(*sum));
+	TEST_CHECK(dst[0] == 0x7fffffff || b[0] < 0);
+	TEST_CHECK(dst[2] == float_mix_to_32(b[2]));
+	float_remix_areas_32_float(MAX_SAMPLES, dst, a, (signed int *)sum,
+				   sizeof(*dst), sizeof(*a), sizeof(*sum));
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		if (sum[i] != sum[i] || dst[i] != float_mix_to_32(b[i])) {
+			fprintf(stderr, "float non-finite remix: mismatch at %u\n", i);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+/* the float callbacks chosen for the slave and client formats */
+static void check_float_select(snd_pcm_direct_t *dmix)
+{
+	dmix->shmptr->s.format = SND_PCM_FORMAT_S16;
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_FLOAT, 0) == float_mix_areas_16_float);
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_FLOAT, 1) == float_remix_areas_16_float);
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_S16, 0) == float_mix_areas_16);
+	dmix->shmptr->s.format = SND_PCM_FORMAT_S32;
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_FLOAT, 0) == float_mix_areas_32_float);
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_S32, 1) == float_remix_areas_32);
+	dmix->shmptr->s.format = SND_PCM_FORMAT_S24_3LE;
+	TEST_CHECK(float_mix_select(dmix, SND_PCM_FORMAT_FLOAT, 0) == NULL);
+}
+
+int main(void)
+{
+	snd_pcm_direct_share_t share;
+	snd_pcm_direct_t dmix;
+
+	memset(&share, 0, sizeof(share));
+	memset(&dmix, 0, sizeof(dmix));
+	share.s.format = SND_PCM_FORMAT_S16;
+	dmix.shmptr = &share;
+
+	generic_mix_select_callbacks(&dmix);
+	TEST_CHECK(dmix.u.dmix.use_sem);
+	check_callbacks("selected", &dmix);
+
+#if defined(SND_PCM_SIMD_X86)
+	if (snd_pcm_simd_caps() & SND_PCM_SIMD_SSE2) {
+		dmix.u.dmix.mix_areas_16 = sse2_mix_areas_16;
+		dmix.u.dmix.remix_areas_16 = sse2_remix_areas_16;
+		dmix.u.dmix.mix_areas_32 = sse2_mix_areas_32;
+		dmix.u.dmix.remix_areas_32 = sse2_remix_areas_32;
+		check_callbacks("sse2", &dmix);
+	}
+#endif
+
+	check_float();
+	check_float_nonfinite();
+	check_float_select(&dmix);
+
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,133 @@
+/*
+ * checks the event loop with pipes and null PCMs: the dispatching of the
+ * ready sources, shared file descriptors, the deletion of sources from a
+ * callback, and the always ready descriptors which epoll cannot watch
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+struct hit {
+	unsigned int count;
+	unsigned short revents;
+	snd_evloop_source_t *victim;	/* deleted by the callback */
+};
+
+static void callback(snd_evloop_source_t *source, unsigned short revents)
+{
+	struct hit *hit = snd_evloop_source_get_callback_private(source);
+
+	hit->count++;
+	hit->revents = revents;
+	if (hit->victim) {
+		snd_evloop_del_source(hit->victim);
+		hit->victim = NULL;
+	}
+}
+
+static void check_pipe(void)
+{
+	snd_evloop_t *loop;
+	snd_evloop_source_t *s1, *s2;
+	struct hit h1 = { 0 }, h2 = { 0 };
+	int fds[2];
+	char c;
+
+	if (ALSA_CHECK(snd_evloop_open(&loop)) < 0)
+		return;
+	TEST_CHECK(snd_evloop_get_fd(loop) >= 0);
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		any_test_failed = 1;
+		goto out;
+	}
+	ALSA_CHECK(snd_evloop_add_handler(&s1, loop, fds[0], POLLIN, callback, &h1));
+	/* the same fd twice */
+	ALSA_CHECK(snd_evloop_add_handler(&s2, loop, fds[0], POLLIN, callback, &h2));
+	TEST_CHECK(snd_evloop_wait(loop, 0) == 0);
+	TEST_CHECK(h1.count == 0 && h2.count == 0);
+
+	TEST_CHECK(write(fds[1], "x", 1) == 1);
+	TEST_CHECK(snd_evloop_wait(loop, 1000) == 2);
+	TEST_CHECK(h1.count == 1 && h1.revents == POLLIN);
+	TEST_CHECK(h2.count == 1 && h2.revents == POLLIN);
+
+	/* whichever runs first deletes the other one */
+	h1.victim = s2;
+	h2.victim = s1;
+	TEST_CHECK(snd_evloop_wait(loop, 1000) == 1);
+	TEST_CHECK(h1.count + h2.count == 3);
+	TEST_CHECK(read(fds[0], &c, 1) == 1);
+	TEST_CHECK(snd_evloop_wait(loop, 0) == 0);
+
+	close(fds[1]);
+	close(fds[0]);
+ out:
+	snd_evloop_close(loop);
+}
+
+static int open_null(snd_pcm_t **pcm, snd_pcm_stream_t stream)
+{
+	static const char conf[] = "pcm.n { type null }";
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, strlen(conf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "n", stream, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static void check_pcm(void)
+{
+	snd_evloop_t *loop;
+	snd_evloop_source_t *sp, *sc;
+	struct hit hp = { 0 }, hc = { 0 };
+	snd_pcm_t *play, *capt;
+
+	if (ALSA_CHECK(snd_evloop_open(&loop)) < 0)
+		return;
+	if (ALSA_CHECK(open_null(&play, SND_PCM_STREAM_PLAYBACK)) < 0)
+		goto out;
+	if (ALSA_CHECK(open_null(&capt, SND_PCM_STREAM_CAPTURE)) < 0)
+		goto out_play;
+	ALSA_CHECK(snd_evloop_add_pcm(&sp, loop, play, callback, &hp));
+	ALSA_CHECK(snd_evloop_add_pcm(&sc, loop, capt, callback, &hc));
+	TEST_CHECK(snd_evloop_source_get_pcm(sp) == play);
+	TEST_CHECK(snd_evloop_source_get_pcm(sc) == capt);
+
+	/* /dev/null and /dev/full cannot be watched, but are always ready */
+	TEST_CHECK(snd_evloop_wait(loop, -1) == 2);
+	TEST_CHECK(hp.count == 1 && hp.revents == POLLOUT);
+	TEST_CHECK(hc.count == 1 && hc.revents == POLLIN);
+
+	TEST_CHECK(snd_evloop_update_source(sp) == 0);
+	snd_evloop_del_source(sc);
+	TEST_CHECK(snd_evloop_wait(loop, -1) == 1);
+	TEST_CHECK(hp.count == 2 && hc.count == 1);
+
+	snd_pcm_close(capt);
+ out_play:
+	snd_pcm_close(play);
+ out:
+	/* deletes the remaining source */
+	snd_evloop_close(loop);
+}
+
+int main(void)
+{
+	check_pipe();
+	check_pcm();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,292 @@
+/*
+ * checks the direct integer <-> float conversion of the lfloat plugin:
+ * the rounding and clamping of the generic code, the vector kernels
+ * against the generic code with and without dither, the mean of the
+ * dithered samples, and the plugin output with the kernels and (in a
+ * child with LIBASOUND_NO_SIMD set) with the generic code
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/wait.h>
+#include "pcm_local.h"
+#include "test.h"
+#include "pcm_lfloat_simd.c"
+
+#define MAX_SAMPLES	67
+#define FRAMES		1000
+#define CHANNELS	2
+
+static char path[] = "/tmp/lfloat_convertXXXXXX";
+
+static void init_dither(unsigned int *state)
+{
+	unsigned int i;
+
+	for (i = 0; i < LFLOAT_DITHER_LANES; i++)
+		state[i] = 0x9e3779b9U * (i + 1);
+}
+
+static int32_t float_to(float v, int fmt)
+{
+	char buf[4];
+
+	generic_from_float(buf, 4, (const char *)&v, 4, 1, NULL, fmt);
+	return lfloat_get(buf, fmt);
+}
+
+static int32_t double_to(double v, int fmt)
+{
+	char buf[4];
+
+	generic_from_double(buf, 4, (const char *)&v, 8, 1, NULL, fmt);
+	return lfloat_get(buf, fmt);
+}
+
+static void check_rounding(void)
+{
+	/* to nearest, ties to even */
+	TEST_CHECK(float_to(0.5f / 32768, LFLOAT_S16) == 0);
+	TEST_CHECK(float_to(1.5f / 32768, LFLOAT_S16) == 2);
+	TEST_CHECK(float_to(-1.4f / 32768, LFLOAT_S16) == -1);
+	TEST_CHECK(float_to(-2.6f / 8388608, LFLOAT_S24_3LE) == -3);
+	TEST_CHECK(double_to(0.5, LFLOAT_S32) == 0x40000000);
+	TEST_CHECK(double_to(-2.5 / 2147483648.0, LFLOAT_S32) == -2);
+	/* clamped */
+	TEST_CHECK(float_to(1.0f, LFLOAT_S16) == 32767);
+	TEST_CHECK(float_to(-1.0f, LFLOAT_S16) == -32768);
+	TEST_CHECK(float_to(3.0f, LFLOAT_S24) == 8388607);
+	TEST_CHECK(float_to(-3.0f, LFLOAT_S24_3LE) == -8388608);
+	TEST_CHECK(float_to(1.0f, LFLOAT_S32) == 0x7fffffff);
+	TEST_CHECK(float_to(-1.0f, LFLOAT_S32) == INT32_MIN);
+	TEST_CHECK(float_to(INFINITY, LFLOAT_S32) == 0x7fffffff);
+	TEST_CHECK(double_to(1.0, LFLOAT_S32) == 0x7fffffff);
+	TEST_CHECK(double_to(-INFINITY, LFLOAT_S16) == -32768);
+	TEST_CHECK(float_to(NAN, LFLOAT_S16) == -32768);
+	TEST_CHECK(float_to(NAN, LFLOAT_S32) == INT32_MIN);
+	TEST_CHECK(double_to(NAN, LFLOAT_S24) == -8388608);
+}
+
+/* a quarter LSB stays in the mean of the dithered samples */
+static void check_dither_mean(void)
+{
+	static float src[8000];
+	static int16_t dst[8000];
+	unsigned int state[LFLOAT_DITHER_LANES], i, zeros = 0;
+	double sum = 0;
+
+	for (i = 0; i < 8000; i++)
+		src[i] = 0.25f / 32768;
+	init_dither(state);
+	generic_float_to_s16((char *)dst, 2, (const char *)src, 4, 8000, state);
+	for (i = 0; i < 8000; i++) {
+		TEST_CHECK(dst[i] >= -1 && dst[i] <= 1);
+		sum += dst[i];
+		zeros += dst[i] == 0;
+	}
+	TEST_CHECK(fabs(sum / 8000 - 0.25) < 0.02);
+	TEST_CHECK(zeros < 8000);
+	generic_float_to_s16((char *)dst, 2, (const char *)src, 4, 8000, NULL);
+	for (i = 0; i < 8000; i++)
+		TEST_CHECK(dst[i] == 0);
+}
+
+static void fill_float(char *buf, int f, unsigned int samples)
+{
+	unsigned int i;
+	double v;
+
+	for (i = 0; i < samples; i++) {
+		v = (random() - RAND_MAX / 2) / (RAND_MAX / 2.0) * 1.1;
+		if (i % 17 == 3)
+			v = (i & 1) ? 1.0 : -1.0;
+		if (f)
+			((double *)buf)[i] = v;
+		else
+			((float *)buf)[i] = v;
+	}
+}
+
+static void check_kernel(int to_float, int i, int f)
+{
+	static const char *const names[] = { "S16", "S24", "S24_3LE", "S32" };
+	static const snd_pcm_format_t ints[] = {
+		SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24,
+		SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32,
+	};
+	snd_pcm_format_t ifmt = ints[i];
+	snd_pcm_format_t ffmt = f ? SND_PCM_FORMAT_FLOAT64 : SND_PCM_FORMAT_FLOAT;
+	lfloat_generic_f generic;
+	lfloat_conv_f func;
+	unsigned int src_width, dst_width, samples, k, d;
+	unsigned int state1[LFLOAT_DITHER_LANES], state2[LFLOAT_DITHER_LANES];
+	char src[MAX_SAMPLES * 8], dst1[MAX_SAMPLES * 8 + 16], dst2[MAX_SAMPLES * 8 + 16];
+
+	generic = lfloat_select_conv(to_float ? ifmt : ffmt,
+				     to_float ? ffmt : ifmt, &func);
+	TEST_CHECK(generic == lfloat_generic_table[to_float][i][f]);
+	if (!generic || !func)
+		return;
+	src_width = to_float ? lfloat_width(i) : 4U << f;
+	dst_width = to_float ? 4U << f : lfloat_width(i);
+	for (d = 0; d < 2; d++) {
+		init_dither(state1);
+		init_dither(state2);
+		for (samples = 0; samples <= MAX_SAMPLES; samples++) {
+			if (to_float) {
+				for (k = 0; k < sizeof(src); k++)
+					src[k] = random();
+			} else {
+				fill_float(src, f, samples);
+			}
+			memset(dst1, 0x55, sizeof(dst1));
+			memset(dst2, 0x55, sizeof(dst2));
+			func(dst1, src, samples, d ? state1 : NULL);
+			generic(dst2, dst_width, src, src_width, samples, d ? state2 : NULL);
+			if (memcmp(dst1, dst2, sizeof(dst1)) ||
+			    memcmp(state1, state2, sizeof(state1))) {
+				fprintf(stderr, "%s -> %s%s: mismatch for %u samples\n",
+					to_float ? names[i] : (f ? "FLOAT64" : "FLOAT"),
+					to_float ? (f ? "FLOAT64" : "FLOAT") : names[i],
+					d ? " (dither)" : "", samples);
+				any_test_failed = 1;
+				return;
+			}
+		}
+	}
+}
+
+static int open_lfloat(snd_pcm_t **pcm, snd_pcm_format_t sformat, int dither)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.l { type lfloat dither %s slave { format %s pcm { "
+		 "type file format raw file \"%s\" slave.pcm { type null } } } }",
+		 dither ? "yes" : "no", snd_pcm_format_name(sformat), path);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "l", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static long run(snd_pcm_format_t format, snd_pcm_format_t sformat, int dither,
+		const void *buf, void *out, long size)
+{
+	snd_output_t *log;
+	snd_pcm_t *pcm;
+	long len = -1;
+	char *str;
+	FILE *f;
+
+	if (ALSA_CHECK(open_lfloat(&pcm, sformat, dither)) < 0)
+		return -1;
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, 48000, 0, 100000)) < 0)
+		goto out;
+	if (ALSA_CHECK(snd_output_buffer_open(&log)) >= 0) {
+		snd_pcm_dump(pcm, log);
+		snd_output_buffer_string(log, &str);
+		TEST_CHECK((strstr(str, "Dither") != NULL) == dither);
+		snd_output_close(log);
+	}
+	TEST_CHECK(snd_pcm_writei(pcm, buf, FRAMES) == FRAMES);
+	snd_pcm_drop(pcm);
+	f = fopen(path, "rb");
+	if (f) {
+		len = fread(out, 1, size, f);
+		fclose(f);
+	}
+ out:
+	snd_pcm_close(pcm);
+	return len;
+}
+
+static void check_plugin(void)
+{
+	static int16_t ibuf[FRAMES * CHANNELS], iout[FRAMES * CHANNELS];
+	static float fbuf[FRAMES * CHANNELS], fout[FRAMES * CHANNELS];
+	unsigned int i, bad = 0, diff = 0;
+	long v;
+
+	for (i = 0; i < FRAMES * CHANNELS; i++)
+		ibuf[i] = random();
+	ibuf[0] = -32768;
+	ibuf[1] = 32767;
+	TEST_CHECK(run(SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT, 0,
+		       ibuf, fout, sizeof(fout)) == sizeof(fout));
+	for (i = 0; i < FRAMES * CHANNELS; i++)
+		if (fout[i] != ibuf[i] / 32768.0f)
+			bad++;
+
+	fill_float((char *)fbuf, 0, FRAMES * CHANNELS);
+	TEST_CHECK(run(SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, 0,
+		       fbuf, iout, sizeof(iout)) == sizeof(iout));
+	for (i = 0; i < FRAMES * CHANNELS; i++) {
+		v = lrintf(fbuf[i] * 32768);
+		if (iout[i] != (v > 32767 ? 32767 : v < -32768 ? -32768 : v))
+			bad++;
+	}
+
+	TEST_CHECK(run(SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, 1,
+		       fbuf, iout, sizeof(iout)) == sizeof(iout));
+	for (i = 0; i < FRAMES * CHANNELS; i++) {
+		v = lrintf(fbuf[i] * 32768);
+		v = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+		if (labs(iout[i] - v) > 1)
+			bad++;
+		diff += iout[i] != v;
+	}
+	TEST_CHECK(diff > 0);
+	if (bad) {
+		fprintf(stderr, "plugin%s: %u samples differ\n",
+			getenv("LIBASOUND_NO_SIMD") ? " (no SIMD)" : "", bad);
+		any_test_failed = 1;
+	}
+}
+
+int main(void)
+{
+	int to_float, i, f, fd, status;
+	pid_t pid;
+
+	check_rounding();
+	check_dither_mean();
+	for (to_float = 0; to_float < 2; to_float++)
+		for (i = 0; i < LFLOAT_INTS; i++)
+			for (f = 0; f < 2; f++)
+				check_kernel(to_float, i, f);
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	/* the SIMD capabilities are probed once per process */
+	pid = fork();
+	if (pid == 0) {
+		setenv("LIBASOUND_NO_SIMD", "1", 1);
+		check_plugin();
+		exit(TEST_EXIT_CODE());
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		any_test_failed = 1;
+	check_plugin();
+	unlink(path);
+	return TEST_EXIT_CODE();
+}
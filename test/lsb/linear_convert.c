@@ -0,0 +1,163 @@
+/*
+ * checks the linear conversion between S16_LE, S24_3LE and S32_LE: the
+ * vector kernels must match the generic code for all lengths, and the
+ * linear plugin must give the same samples with the kernels and (in a
+ * child with LIBASOUND_NO_SIMD set) with the per-sample code
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "pcm_local.h"
+#include "test.h"
+#include "pcm_linear_simd.c"
+
+#define MAX_SAMPLES	131
+#define FRAMES		1000
+#define CHANNELS	3
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32_LE,
+};
+
+static char path[] = "/tmp/linear_convertXXXXXX";
+
+static void check_kernel(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
+{
+	unsigned int src_width = snd_pcm_format_physical_width(src_format) / 8;
+	unsigned int dst_width = snd_pcm_format_physical_width(dst_format) / 8;
+	uint8_t src[MAX_SAMPLES * 4], dst1[MAX_SAMPLES * 4 + 16], dst2[MAX_SAMPLES * 4 + 16];
+	linear_conv_f func = linear_select_conv(src_format, dst_format);
+	unsigned int samples, i;
+
+	if (!func)
+		return;
+	for (samples = 0; samples <= MAX_SAMPLES; samples++) {
+		for (i = 0; i < sizeof(src); i++)
+			src[i] = random();
+		/* the guard bytes after the samples must stay */
+		memset(dst1, 0x55, sizeof(dst1));
+		memset(dst2, 0x55, sizeof(dst2));
+		func(dst1, src, samples);
+		generic_conv(dst2, src, samples, src_width, dst_width);
+		if (memcmp(dst1, dst2, sizeof(dst1))) {
+			fprintf(stderr, "%s -> %s: mismatch for %u samples\n",
+				snd_pcm_format_name(src_format),
+				snd_pcm_format_name(dst_format), samples);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+static int open_linear(snd_pcm_t **pcm, snd_pcm_format_t sformat)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.l { type linear slave { format %s pcm { "
+		 "type file format raw file \"%s\" slave.pcm { type null } } } }",
+		 snd_pcm_format_name(sformat), path);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "l", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static void check_plugin(snd_pcm_format_t format, snd_pcm_format_t sformat)
+{
+	unsigned int width = snd_pcm_format_physical_width(format) / 8;
+	unsigned int swidth = snd_pcm_format_physical_width(sformat) / 8;
+	long size = (long)FRAMES * CHANNELS * swidth, len = -1;
+	uint8_t *buf, *out, *expected;
+	snd_pcm_t *pcm;
+	unsigned int i;
+	FILE *f;
+
+	if (ALSA_CHECK(open_linear(&pcm, sformat)) < 0)
+		return;
+	buf = malloc(FRAMES * CHANNELS * width);
+	out = malloc(size);
+	expected = malloc(size);
+	if (!buf || !out || !expected)
+		goto out;
+	for (i = 0; i < FRAMES * CHANNELS * width; i++)
+		buf[i] = random();
+	generic_conv(expected, buf, FRAMES * CHANNELS, width, swidth);
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, 48000, 0, 100000)) < 0)
+		goto out;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, FRAMES) == FRAMES);
+	snd_pcm_drop(pcm);
+	f = fopen(path, "rb");
+	if (f) {
+		len = fread(out, 1, size, f);
+		fclose(f);
+	}
+	TEST_CHECK(len == size);
+	if (len == size && memcmp(out, expected, size)) {
+		fprintf(stderr, "plugin %s -> %s%s: different samples\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(sformat),
+			getenv("LIBASOUND_NO_SIMD") ? " (no SIMD)" : "");
+		any_test_failed = 1;
+	}
+ out:
+	free(buf);
+	free(out);
+	free(expected);
+	snd_pcm_close(pcm);
+}
+
+static void check_all(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			if (i != j)
+				check_plugin(formats[i], formats[j]);
+}
+
+int main(void)
+{
+	unsigned int i, j;
+	int fd, status;
+	pid_t pid;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			if (i != j)
+				check_kernel(formats[i], formats[j]);
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	/* the SIMD capabilities are probed once per process */
+	pid = fork();
+	if (pid == 0) {
+		setenv("LIBASOUND_NO_SIMD", "1", 1);
+		check_all();
+		exit(TEST_EXIT_CODE());
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		any_test_failed = 1;
+	check_all();
+	unlink(path);
+	return TEST_EXIT_CODE();
+}
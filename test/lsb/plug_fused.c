@@ -0,0 +1,199 @@
+/*
+ * checks the fused conversion of the plug plugin: a change of the channels
+ * together with an integer <-> float change must be done by the route
+ * plugin alone, and give the same samples as the separate conversions
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+#define FRAMES		1000
+#define MAX_CHANNELS	4
+
+static char path[] = "/tmp/plug_fusedXXXXXX";
+
+static int open_plug(snd_pcm_t **pcm, snd_pcm_format_t sformat,
+		     unsigned int schannels)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.p { type plug slave { format %s channels %u pcm { "
+		 "type file format raw file \"%s\" slave.pcm { type null } } } }",
+		 snd_pcm_format_name(sformat), schannels, path);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "p", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+/* the chain must have one route stage and no other conversion */
+static void check_dump(snd_pcm_t *pcm)
+{
+	snd_output_t *out;
+	char *str;
+
+	if (ALSA_CHECK(snd_output_buffer_open(&out)) < 0)
+		return;
+	snd_pcm_dump(pcm, out);
+	snd_output_buffer_string(out, &str);
+	TEST_CHECK(strstr(str, "Fused conversion") != NULL);
+	TEST_CHECK(strstr(str, "Linear") == NULL);
+	snd_output_close(out);
+}
+
+static long run(snd_pcm_format_t format, unsigned int channels,
+		snd_pcm_format_t sformat, unsigned int schannels,
+		const void *buf, void *out, long size)
+{
+	snd_pcm_t *pcm;
+	long len = -1;
+	FILE *f;
+
+	if (ALSA_CHECK(open_plug(&pcm, sformat, schannels)) < 0)
+		return -1;
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+					  channels, 48000, 0, 100000)) < 0)
+		goto out;
+	check_dump(pcm);
+	TEST_CHECK(snd_pcm_writei(pcm, buf, FRAMES) == FRAMES);
+	snd_pcm_drop(pcm);
+	f = fopen(path, "rb");
+	if (f) {
+		len = fread(out, 1, size, f);
+		fclose(f);
+	}
+ out:
+	snd_pcm_close(pcm);
+	return len;
+}
+
+/* S16 stereo to a float slave with 4 channels, the copy policy */
+static void check_to_float(void)
+{
+	static int16_t buf[FRAMES * 2];
+	static float out[FRAMES * 4];
+	unsigned int i, bad = 0;
+	long len;
+
+	for (i = 0; i < FRAMES * 2; i++)
+		buf[i] = random();
+	buf[0] = -32768;
+	buf[1] = 32767;
+	len = run(SND_PCM_FORMAT_S16, 2, SND_PCM_FORMAT_FLOAT, 4,
+		  buf, out, sizeof(out));
+	TEST_CHECK(len == sizeof(out));
+	if (len != sizeof(out))
+		return;
+	for (i = 0; i < FRAMES; i++) {
+		if (out[i * 4] != buf[i * 2] / 32768.0f ||
+		    out[i * 4 + 1] != buf[i * 2 + 1] / 32768.0f ||
+		    out[i * 4 + 2] != 0 || out[i * 4 + 3] != 0)
+			bad++;
+	}
+	if (bad) {
+		fprintf(stderr, "S16 -> FLOAT: %u frames differ\n", bad);
+		any_test_failed = 1;
+	}
+}
+
+/* float stereo to a mono S16 slave, the average of both channels */
+static void check_from_float(void)
+{
+	static float buf[FRAMES * 2];
+	static int16_t out[FRAMES];
+	int a, b, expected;
+	unsigned int i, bad = 0;
+	long len;
+
+	for (i = 0; i < FRAMES * 2; i++)
+		buf[i] = (int16_t)random() / 32768.0f;
+	/* clipped */
+	buf[0] = 1.5f;
+	buf[1] = 1.0f;
+	buf[2] = -2.0f;
+	buf[3] = -1.0f;
+	len = run(SND_PCM_FORMAT_FLOAT, 2, SND_PCM_FORMAT_S16, 1,
+		  buf, out, sizeof(out));
+	TEST_CHECK(len == sizeof(out));
+	if (len != sizeof(out))
+		return;
+	for (i = 0; i < FRAMES; i++) {
+		a = buf[i * 2] >= 1.0f ? 32767 : buf[i * 2] <= -1.0f ? -32768 :
+			(int)(buf[i * 2] * 32768);
+		b = buf[i * 2 + 1] >= 1.0f ? 32767 : buf[i * 2 + 1] <= -1.0f ? -32768 :
+			(int)(buf[i * 2 + 1] * 32768);
+		if (i < 2)	/* 0x7fffffff does not fit the float sums */
+			expected = (a + b) / 2;
+		else
+			expected = ((a + b) * 32768) >> 16;
+		if (out[i] != expected)
+			bad++;
+	}
+	if (bad) {
+		fprintf(stderr, "FLOAT -> S16: %u frames differ\n", bad);
+		any_test_failed = 1;
+	}
+}
+
+/* float mono to both S32 channels, rounded to the nearest like lfloat */
+static void check_from_float_s32(void)
+{
+	static const float vals[] = { 2.75f, -2.75f, 2.25f, -2.25f, 1e9f, -1e9f };
+	static const int32_t rounded[] = { 3, -3, 2, -2, 1000000000, -1000000000 };
+	static float buf[FRAMES];
+	static int32_t out[FRAMES * 2];
+	unsigned int i, bad = 0;
+	long len;
+
+	for (i = 0; i < FRAMES; i++)
+		buf[i] = vals[i % 6] / 2147483648.0f;
+	buf[0] = 1.5f;
+	buf[1] = -1.5f;
+	len = run(SND_PCM_FORMAT_FLOAT, 1, SND_PCM_FORMAT_S32, 2,
+		  buf, out, sizeof(out));
+	TEST_CHECK(len == sizeof(out));
+	if (len != sizeof(out))
+		return;
+	TEST_CHECK(out[0] == 0x7fffffff && out[1] == 0x7fffffff);
+	TEST_CHECK(out[2] == -0x7fffffff - 1 && out[3] == -0x7fffffff - 1);
+	for (i = 2; i < FRAMES; i++) {
+		if (out[i * 2] != rounded[i % 6] ||
+		    out[i * 2 + 1] != rounded[i % 6])
+			bad++;
+	}
+	if (bad) {
+		fprintf(stderr, "FLOAT -> S32: %u frames differ\n", bad);
+		any_test_failed = 1;
+	}
+}
+
+int main(void)
+{
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	check_to_float();
+	check_from_float();
+	check_from_float_s32();
+	unlink(path);
+	return TEST_EXIT_CODE();
+}
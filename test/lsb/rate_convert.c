@@ -0,0 +1,412 @@
+/*
+ * checks the built-in rate converters: a sine must come out at the same
+ * frequency and level, with little distortion; the native S32, float and
+ * generic paths of the linear converter must agree with each other, the
+ * vectorized S16 code for interleaved buffers must match the scalar one;
+ * stretched slave periods (variable ratio) must not cause discontinuities
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "test.h"
+#include <alsa/pcm_rate.h>
+
+#define CHANNELS	2
+#define MAX_CHANNELS	19
+#define PERIODS		20
+#define SKIP		5
+#define FREQ		1000.0
+#define LEVEL		16000.0
+
+extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast)(unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase)(unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+extern int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best)(unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+extern int SND_PCM_RATE_PLUGIN_ENTRY(linear)(unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+
+struct converter {
+	const char *name;
+	snd_pcm_rate_open_func_t open;
+	double max_error;	/* residual relative to the level */
+};
+
+static const struct converter converters[] = {
+	{ "polyphase_fast", SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast), 1e-3 },
+	{ "polyphase", SND_PCM_RATE_PLUGIN_ENTRY(polyphase), 2e-4 },
+	{ "polyphase_best", SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best), 1e-4 },
+	{ "linear", SND_PCM_RATE_PLUGIN_ENTRY(linear), 0 },
+};
+
+static const unsigned int rates[][2] = {
+	{ 44100, 48000 },
+	{ 48000, 44100 },
+	{ 48000, 16000 },
+	{ 8000, 48000 },
+};
+
+/* least squares fit of the sine, returns the level and the residual */
+static void fit_sine(const int16_t *buf, unsigned int frames, unsigned int rate,
+		     double *level, double *error)
+{
+	double s = 0, c = 0, a, b, r, e = 0, w = 2 * M_PI * FREQ / rate;
+	unsigned int i;
+
+	for (i = 0; i < frames; i++) {
+		s += buf[i * CHANNELS] * sin(w * i);
+		c += buf[i * CHANNELS] * cos(w * i);
+	}
+	a = 2 * s / frames;
+	b = 2 * c / frames;
+	for (i = 0; i < frames; i++) {
+		r = buf[i * CHANNELS] - a * sin(w * i) - b * cos(w * i);
+		e += r * r;
+	}
+	*level = sqrt(a * a + b * b);
+	*error = sqrt(2 * e / frames) / *level;
+}
+
+static void check(const struct converter *conv, unsigned int in_rate,
+		  unsigned int out_rate)
+{
+	snd_pcm_rate_info_t info;
+	snd_pcm_rate_ops_t ops;
+	int16_t *src, *dst;
+	double level, error;
+	unsigned int i, p, n;
+	void *obj;
+
+	memset(&info, 0, sizeof(info));
+	info.channels = CHANNELS;
+	info.in.format = info.out.format = SND_PCM_FORMAT_S16;
+	info.in.rate = in_rate;
+	info.out.rate = out_rate;
+	info.in.period_size = in_rate / 100;
+	info.out.period_size = out_rate / 100;
+	info.in.buffer_size = info.in.period_size * 4;
+	info.out.buffer_size = info.out.period_size * 4;
+
+	memset(&ops, 0, sizeof(ops));
+	if (ALSA_CHECK(conv->open(SND_PCM_RATE_PLUGIN_VERSION, &obj, &ops)) < 0)
+		return;
+	if (ALSA_CHECK(ops.init(obj, &info)) < 0 ||
+	    ALSA_CHECK(ops.adjust_pitch(obj, &info)) < 0) {
+		ops.close(obj);
+		return;
+	}
+	ops.reset(obj);
+	TEST_CHECK(ops.input_frames(obj, info.out.period_size) == info.in.period_size);
+	TEST_CHECK(ops.output_frames(obj, info.in.period_size) == info.out.period_size);
+
+	src = malloc(info.in.period_size * CHANNELS * sizeof(*src));
+	dst = malloc(info.out.period_size * PERIODS * CHANNELS * sizeof(*dst));
+	if (!src || !dst)
+		goto out;
+	for (p = 0; p < PERIODS; p++) {
+		for (i = 0; i < info.in.period_size; i++) {
+			n = p * info.in.period_size + i;
+			src[i * CHANNELS] = lrint(LEVEL * sin(2 * M_PI * FREQ * n / in_rate));
+			src[i * CHANNELS + 1] = -src[i * CHANNELS];
+		}
+		ops.convert_s16(obj, dst + p * info.out.period_size * CHANNELS,
+				info.out.period_size, src, info.in.period_size);
+	}
+
+	n = out_rate / 10;	/* 100 cycles */
+	fit_sine(dst + SKIP * info.out.period_size * CHANNELS, n, out_rate,
+		 &level, &error);
+	if (fabs(level - LEVEL) > LEVEL * 0.01 || error > conv->max_error) {
+		fprintf(stderr, "%s %u -> %u: level %.1f, error %g\n",
+			conv->name, in_rate, out_rate, level, error);
+		any_test_failed = 1;
+	}
+	for (i = 0; i < info.out.period_size * PERIODS; i++) {
+		if (dst[i * CHANNELS + 1] != -dst[i * CHANNELS] &&
+		    dst[i * CHANNELS] != -32768) {
+			fprintf(stderr, "%s %u -> %u: channel mismatch at %u\n",
+				conv->name, in_rate, out_rate, i);
+			any_test_failed = 1;
+			break;
+		}
+	}
+ out:
+	free(src);
+	free(dst);
+	ops.free(obj);
+	ops.close(obj);
+}
+
+/*
+ * runs the linear converter on 32 bit (or S16 when channels are given)
+ * samples, interleaved or one buffer per channel
+ */
+static int run_linear(snd_pcm_format_t format, unsigned int in_rate,
+		      unsigned int out_rate, const void *src, void *dst,
+		      unsigned int channels, int planar)
+{
+	snd_pcm_rate_info_t info;
+	snd_pcm_rate_ops_t ops;
+	snd_pcm_channel_area_t src_areas[MAX_CHANNELS], dst_areas[MAX_CHANNELS];
+	uint64_t in_formats, out_formats;
+	unsigned int c, p, flags, width;
+	void *obj;
+
+	width = snd_pcm_format_physical_width(format);
+	memset(&info, 0, sizeof(info));
+	info.channels = channels;
+	info.in.format = info.out.format = format;
+	info.in.rate = in_rate;
+	info.out.rate = out_rate;
+	info.in.period_size = in_rate / 100;
+	info.out.period_size = out_rate / 100;
+	info.in.buffer_size = info.in.period_size * 4;
+	info.out.buffer_size = info.out.period_size * 4;
+
+	memset(&ops, 0, sizeof(ops));
+	if (ALSA_CHECK(SND_PCM_RATE_PLUGIN_ENTRY(linear)(SND_PCM_RATE_PLUGIN_VERSION, &obj, &ops)) < 0)
+		return -1;
+	TEST_CHECK(ops.get_supported_formats != NULL);
+	if (ops.get_supported_formats) {
+		ops.get_supported_formats(obj, &in_formats, &out_formats, &flags);
+		TEST_CHECK(in_formats & out_formats & (1ULL << format));
+	}
+	if (ALSA_CHECK(ops.init(obj, &info)) < 0 ||
+	    ALSA_CHECK(ops.adjust_pitch(obj, &info)) < 0) {
+		ops.close(obj);
+		return -1;
+	}
+	ops.reset(obj);
+	for (c = 0; c < channels; c++) {
+		src_areas[c].addr = (void *)src;
+		dst_areas[c].addr = dst;
+		if (planar) {
+			src_areas[c].first = c * width * info.in.period_size * PERIODS;
+			src_areas[c].step = width;
+			dst_areas[c].first = c * width * info.out.period_size * PERIODS;
+			dst_areas[c].step = width;
+		} else {
+			src_areas[c].first = c * width;
+			src_areas[c].step = channels * width;
+			dst_areas[c].first = c * width;
+			dst_areas[c].step = channels * width;
+		}
+	}
+	for (p = 0; p < PERIODS; p++)
+		ops.convert(obj, dst_areas, p * info.out.period_size,
+			    info.out.period_size, src_areas,
+			    p * info.in.period_size, info.in.period_size);
+	ops.free(obj);
+	ops.close(obj);
+	return 0;
+}
+
+static void check_linear(unsigned int in_rate, unsigned int out_rate)
+{
+	unsigned int in_size = in_rate / 100 * PERIODS * CHANNELS;
+	unsigned int out_size = out_rate / 100 * PERIODS * CHANNELS;
+	int32_t *s32, *s24, *d32, *d24;
+	float *f, *df;
+	double x;
+	unsigned int i;
+
+	s32 = malloc(in_size * sizeof(*s32));
+	s24 = malloc(in_size * sizeof(*s24));
+	f = malloc(in_size * sizeof(*f));
+	d32 = malloc(out_size * sizeof(*d32));
+	d24 = malloc(out_size * sizeof(*d24));
+	df = malloc(out_size * sizeof(*df));
+	if (!s32 || !s24 || !f || !d32 || !d24 || !df)
+		goto out;
+	for (i = 0; i < in_size; i++) {
+		x = 0.7 * sin(2 * M_PI * FREQ * (i / CHANNELS) / in_rate);
+		if (i % CHANNELS)
+			x = -x;
+		s32[i] = lrint(x * 2147483648.0);
+		s24[i] = s32[i] >> 8;
+		f[i] = s32[i] / 2147483648.0;
+	}
+	if (run_linear(SND_PCM_FORMAT_S32, in_rate, out_rate, s32, d32, CHANNELS, 0) < 0 ||
+	    run_linear(SND_PCM_FORMAT_S24, in_rate, out_rate, s24, d24, CHANNELS, 0) < 0 ||
+	    run_linear(SND_PCM_FORMAT_FLOAT, in_rate, out_rate, f, df, CHANNELS, 0) < 0)
+		goto out;
+	for (i = 0; i < out_size; i++) {
+		/* no rounding to 16 bit on the way */
+		if (abs(d24[i] - (d32[i] >> 8)) > 1 ||
+		    fabs(df[i] * 2147483648.0 - d32[i]) > 512) {
+			fprintf(stderr, "linear %u -> %u: mismatch at %u: "
+				"S32 %d, S24 %d, float %f\n", in_rate, out_rate,
+				i, d32[i], d24[i], df[i]);
+			any_test_failed = 1;
+			break;
+		}
+	}
+ out:
+	free(s32);
+	free(s24);
+	free(f);
+	free(d32);
+	free(d24);
+	free(df);
+}
+
+/* interleaved S16 (vectorized) against one buffer per channel (scalar) */
+static void check_linear_s16(unsigned int channels, unsigned int in_rate,
+			     unsigned int out_rate)
+{
+	unsigned int in_frames = in_rate / 100 * PERIODS;
+	unsigned int out_frames = out_rate / 100 * PERIODS;
+	int16_t *src, *src_planar, *dst, *dst_planar;
+	unsigned int i, c;
+
+	src = malloc(in_frames * channels * sizeof(*src));
+	src_planar = malloc(in_frames * channels * sizeof(*src));
+	dst = malloc(out_frames * channels * sizeof(*dst));
+	dst_planar = malloc(out_frames * channels * sizeof(*dst));
+	if (!src || !src_planar || !dst || !dst_planar)
+		goto out;
+	for (i = 0; i < in_frames; i++) {
+		for (c = 0; c < channels; c++) {
+			src[i * channels + c] = random() % 4 ? (int16_t)random() :
+						(random() % 2 ? 0x7fff : -0x8000);
+			src_planar[c * in_frames + i] = src[i * channels + c];
+		}
+	}
+	if (run_linear(SND_PCM_FORMAT_S16, in_rate, out_rate, src, dst,
+		       channels, 0) < 0 ||
+	    run_linear(SND_PCM_FORMAT_S16, in_rate, out_rate, src_planar,
+		       dst_planar, channels, 1) < 0)
+		goto out;
+	for (i = 0; i < out_frames; i++) {
+		for (c = 0; c < channels; c++) {
+			if (dst[i * channels + c] != dst_planar[c * out_frames + i]) {
+				fprintf(stderr, "linear S16 %u ch %u -> %u: "
+					"mismatch at %u/%u\n", channels,
+					in_rate, out_rate, i, c);
+				any_test_failed = 1;
+				goto out;
+			}
+		}
+	}
+ out:
+	free(src);
+	free(src_planar);
+	free(dst);
+	free(dst_planar);
+}
+
+/*
+ * converts a sine with the slave side periods (the output for playback,
+ * the input for capture) stretched by up to the allowed slip; the
+ * output must stay as smooth as the sine itself
+ */
+static void check_variable(const struct converter *conv, unsigned int in_rate,
+			   unsigned int out_rate, int capture)
+{
+	snd_pcm_rate_info_t info;
+	snd_pcm_rate_ops_t ops;
+	snd_pcm_channel_area_t src_areas[CHANNELS], dst_areas[CHANNELS];
+	snd_pcm_uframes_t slip, in_frames, out_frames;
+	uint64_t in_formats, out_formats;
+	unsigned int i, c, p, flags = 0;
+	unsigned int in_pos = 0, out_pos = 0;
+	int16_t *src, *dst;
+	double max_step;
+	int step;
+	void *obj;
+
+	memset(&info, 0, sizeof(info));
+	info.channels = CHANNELS;
+	info.in.format = info.out.format = SND_PCM_FORMAT_S16;
+	info.in.rate = in_rate;
+	info.out.rate = out_rate;
+	info.in.period_size = in_rate / 100;
+	info.out.period_size = out_rate / 100;
+	info.in.buffer_size = info.in.period_size * 4;
+	info.out.buffer_size = info.out.period_size * 4;
+	slip = SND_PCM_RATE_VARIABLE_SLIP(capture ? info.in.period_size :
+					  info.out.period_size);
+
+	memset(&ops, 0, sizeof(ops));
+	if (ALSA_CHECK(conv->open(SND_PCM_RATE_PLUGIN_VERSION, &obj, &ops)) < 0)
+		return;
+	if (ops.get_supported_formats)
+		ops.get_supported_formats(obj, &in_formats, &out_formats, &flags);
+	TEST_CHECK(flags & SND_PCM_RATE_FLAG_VARIABLE_FRAMES);
+	if (ALSA_CHECK(ops.init(obj, &info)) < 0 ||
+	    ALSA_CHECK(ops.adjust_pitch(obj, &info)) < 0) {
+		ops.close(obj);
+		return;
+	}
+	ops.reset(obj);
+
+	src = malloc((info.in.period_size + slip) * PERIODS * CHANNELS * sizeof(*src));
+	dst = malloc((info.out.period_size + slip) * PERIODS * CHANNELS * sizeof(*dst));
+	if (!src || !dst)
+		goto out;
+	for (i = 0; i < (info.in.period_size + slip) * PERIODS; i++) {
+		src[i * CHANNELS] = lrint(LEVEL * sin(2 * M_PI * FREQ * i / in_rate));
+		src[i * CHANNELS + 1] = -src[i * CHANNELS];
+	}
+	for (c = 0; c < CHANNELS; c++) {
+		src_areas[c].addr = src;
+		src_areas[c].first = c * 16;
+		src_areas[c].step = CHANNELS * 16;
+		dst_areas[c].addr = dst;
+		dst_areas[c].first = c * 16;
+		dst_areas[c].step = CHANNELS * 16;
+	}
+	for (p = 0; p < PERIODS; p++) {
+		/* +slip, 0, -slip, ... */
+		in_frames = info.in.period_size;
+		out_frames = info.out.period_size;
+		if (capture)
+			in_frames += slip * ((int)(p % 3) - 1);
+		else
+			out_frames += slip * ((int)(p % 3) - 1);
+		if (ops.convert_s16)
+			ops.convert_s16(obj, dst + out_pos * CHANNELS, out_frames,
+					src + in_pos * CHANNELS, in_frames);
+		else
+			ops.convert(obj, dst_areas, out_pos, out_frames,
+				    src_areas, in_pos, in_frames);
+		in_pos += in_frames;
+		out_pos += out_frames;
+	}
+
+	/* the stretch changes the frequency only by a few per mille */
+	max_step = LEVEL * 2 * M_PI * FREQ / out_rate * 1.3 + 2;
+	for (i = SKIP * info.out.period_size + 1; i < out_pos; i++) {
+		step = dst[i * CHANNELS] - dst[(i - 1) * CHANNELS];
+		if (abs(step) > max_step) {
+			fprintf(stderr, "%s %u -> %u (%s): step %d at %u\n",
+				conv->name, in_rate, out_rate,
+				capture ? "capture" : "playback", step, i);
+			any_test_failed = 1;
+			break;
+		}
+	}
+ out:
+	free(src);
+	free(dst);
+	ops.free(obj);
+	ops.close(obj);
+}
+
+int main(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < sizeof(converters) / sizeof(converters[0]); i++) {
+		for (j = 0; j < sizeof(rates) / sizeof(rates[0]); j++) {
+			if (converters[i].max_error)
+				check(&converters[i], rates[j][0], rates[j][1]);
+			check_variable(&converters[i], rates[j][0], rates[j][1], 0);
+			check_variable(&converters[i], rates[j][0], rates[j][1], 1);
+		}
+	}
+	for (j = 0; j < sizeof(rates) / sizeof(rates[0]); j++) {
+		check_linear(rates[j][0], rates[j][1]);
+		for (i = 4; i <= MAX_CHANNELS; i += 3)
+			check_linear_s16(i, rates[j][0], rates[j][1]);
+	}
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,175 @@
+/*
+ * checks the playback rewind of the rate plugin: rewinding into the
+ * committed periods and writing the same frames again must give the
+ * same slave stream as writing them once
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "test.h"
+#include <alsa/pcm_plugin.h>
+
+#define CHANNELS	2
+#define PERIODS		4
+#define WRITTEN		3	/* periods written before the rewind */
+
+struct setup {
+	const char *converter;
+	unsigned int rate, srate;
+	int ppm;
+};
+
+static const struct setup setups[] = {
+	{ "linear", 44100, 48000, 0 },
+	{ "linear", 48000, 44100, 0 },
+	{ "linear", 44100, 48000, 800 },
+	{ "polyphase_fast", 44100, 48000, 0 },
+	{ "polyphase_fast", 48000, 16000, -800 },
+};
+
+static char path[] = "/tmp/rate_rewindXXXXXX";
+
+static int open_rate(snd_pcm_t **pcm, const struct setup *s)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.r { type rate converter %s slave { rate %u pcm { "
+		 "type file format raw file \"%s\" slave.pcm { type null } } } }",
+		 s->converter, s->srate, path);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "r", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static void fill(int16_t *buf, unsigned int pos, unsigned int frames,
+		 unsigned int rate)
+{
+	unsigned int i;
+
+	for (i = 0; i < frames; i++) {
+		buf[i * CHANNELS] = lrint(16000 * sin(2 * M_PI * 1000.0 * (pos + i) / rate));
+		buf[i * CHANNELS + 1] = (pos + i) * 37;
+	}
+}
+
+/* writes WRITTEN periods plus tail frames, rewinds and writes again */
+static long run(const struct setup *s, unsigned int tail,
+		unsigned int rewind, void *out, long size)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t period = s->rate / 100, boundary;
+	unsigned int total = WRITTEN * period + tail;
+	int16_t *buf;
+	long len = -1;
+	FILE *f;
+
+	if (ALSA_CHECK(open_rate(&pcm, s)) < 0)
+		return -1;
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	buf = malloc(total * CHANNELS * sizeof(*buf));
+	if (!buf)
+		goto out;
+	if (ALSA_CHECK(snd_pcm_hw_params_any(pcm, hw)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, hw, s->rate, 0)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_period_size(pcm, hw, period, 0)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params_set_buffer_size(pcm, hw, period * PERIODS)) < 0 ||
+	    ALSA_CHECK(snd_pcm_hw_params(pcm, hw)) < 0)
+		goto out;
+	/* never started, the null slave keeps all frames rewindable */
+	snd_pcm_sw_params_current(pcm, sw);
+	snd_pcm_sw_params_get_boundary(sw, &boundary);
+	snd_pcm_sw_params_set_start_threshold(pcm, sw, boundary);
+	if (ALSA_CHECK(snd_pcm_sw_params(pcm, sw)) < 0)
+		goto out;
+	if (s->ppm && ALSA_CHECK(snd_pcm_rate_set_ratio_ppm(pcm, s->ppm)) < 0)
+		goto out;
+
+	fill(buf, 0, total, s->rate);
+	TEST_CHECK(snd_pcm_writei(pcm, buf, total) == (snd_pcm_sframes_t)total);
+	if (rewind) {
+		TEST_CHECK(snd_pcm_rewindable(pcm) >= (snd_pcm_sframes_t)rewind);
+		TEST_CHECK(snd_pcm_rewind(pcm, rewind) == (snd_pcm_sframes_t)rewind);
+		TEST_CHECK(snd_pcm_writei(pcm, buf + (total - rewind) * CHANNELS, rewind) ==
+			   (snd_pcm_sframes_t)rewind);
+	}
+	snd_pcm_drop(pcm);
+
+	f = fopen(path, "rb");
+	if (f) {
+		len = fread(out, 1, size, f);
+		fclose(f);
+	}
+ out:
+	free(buf);
+	snd_pcm_close(pcm);
+	return len;
+}
+
+static void check(const struct setup *s, unsigned int tail, unsigned int rewind)
+{
+	long size = s->srate / 100 * PERIODS * CHANNELS * 2 * 2;
+	char *ref, *res;
+	long ref_len, res_len;
+
+	ref = malloc(size);
+	res = malloc(size);
+	if (!ref || !res)
+		goto out;
+	ref_len = run(s, tail, 0, ref, size);
+	res_len = run(s, tail, rewind, res, size);
+	TEST_CHECK(ref_len > 0);
+	if (ref_len != res_len || memcmp(ref, res, ref_len)) {
+		fprintf(stderr, "%s %u -> %u, %d ppm: rewind %u (tail %u): "
+			"%ld bytes, expected %ld%s\n", s->converter, s->rate,
+			s->srate, s->ppm, rewind, tail, res_len, ref_len,
+			ref_len == res_len ? ", different data" : "");
+		any_test_failed = 1;
+	}
+ out:
+	free(ref);
+	free(res);
+}
+
+int main(void)
+{
+	unsigned int i, period;
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	for (i = 0; i < sizeof(setups) / sizeof(setups[0]); i++) {
+		period = setups[i].rate / 100;
+		/* pending frames only, into one and into two periods */
+		check(&setups[i], 100, 50);
+		check(&setups[i], 0, period / 2);
+		check(&setups[i], 100, period + 300);
+		check(&setups[i], 0, 2 * period + 7);
+	}
+	unlink(path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,278 @@
+/*
+ * checks the mixing of the route plugin: the interleaved S16 and S32
+ * streams must match the sums of the transformation table exactly, with
+ * the compiled matrix code and (in a child with LIBASOUND_NO_SIMD set)
+ * with the per-channel code; FLOAT streams must match the unclipped float
+ * sums; a ttable with a control must not boost
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/wait.h>
+#include "test.h"
+
+#define MAX_CHANNELS	8
+#define FRAMES		1000
+
+struct setup {
+	unsigned int channels, schannels;
+	float ttable[MAX_CHANNELS][MAX_CHANNELS];	/* [client][slave] */
+};
+
+static const struct setup setups[] = {
+	/* 5.1 downmix */
+	{ 6, 2, {
+		{ 1.0, 0.0 }, { 0.0, 1.0 },
+		{ 0.7071, 0.0 }, { 0.0, 0.7071 },
+		{ 0.5, 0.5 }, { 0.3, 0.3 },
+	} },
+	/* upmix with plain copies and a silent channel */
+	{ 2, 5, {
+		{ 1.0, 0.0, 0.5, 0.0, 0.0 },
+		{ 0.0, 1.0, 0.5, 0.0, 0.25 },
+	} },
+	/* unattenuated sums clip */
+	{ 3, 3, {
+		{ 1.0, 1.0, 0.0 },
+		{ 1.0, 0.0, 0.0 },
+		{ 0.0, 1.0, 0.6 },
+	} },
+	/* dense */
+	{ 8, 7, {
+		{ 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7 },
+		{ 0.7, 0.6, 0.5, 0.4, 0.3, 0.2, 0.1 },
+		{ 0.125, 0.25, 0.375, 0.5, 0.625, 0.75, 0.875 },
+		{ 0.9, 0.0, 0.9, 0.0, 0.9, 0.0, 0.9 },
+		{ 0.0, 0.9, 0.0, 0.9, 0.0, 0.9, 0.0 },
+		{ 0.33, 0.33, 0.33, 0.33, 0.33, 0.33, 0.33 },
+		{ 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+		{ 0.01, 0.02, 0.03, 0.04, 0.05, 0.06, 0.07 },
+	} },
+};
+
+static char path[] = "/tmp/route_mixXXXXXX";
+
+static int open_config(snd_pcm_t **pcm, const char *buf)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "r", SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static int open_route(snd_pcm_t **pcm, const struct setup *s,
+		      snd_pcm_format_t format)
+{
+	char buf[4096];
+	unsigned int c, d;
+	int len;
+
+	len = snprintf(buf, sizeof(buf),
+		       "pcm.r { type route slave { format %s channels %u pcm { "
+		       "type file format raw file \"%s\" slave.pcm { type null } } } "
+		       "ttable {", snd_pcm_format_name(format), s->schannels, path);
+	for (c = 0; c < s->channels; c++)
+		for (d = 0; d < s->schannels; d++)
+			if (s->ttable[c][d] != 0)
+				len += snprintf(buf + len, sizeof(buf) - len,
+						" %u.%u %.6g", c, d, s->ttable[c][d]);
+	snprintf(buf + len, sizeof(buf) - len, " } }");
+	return open_config(pcm, buf);
+}
+
+/* the sums of snd_pcm_route_convert1_many() */
+static int32_t mix(const struct setup *s, const int32_t *frame, unsigned int d)
+{
+	unsigned int c, n = 0, last = 0;
+	float sum = 0;
+
+	for (c = 0; c < s->channels; c++) {
+		if (s->ttable[c][d] != 0) {
+			sum += frame[c] * s->ttable[c][d];
+			last = c;
+			n++;
+		}
+	}
+	if (n == 1 && s->ttable[last][d] == 1.0)
+		return frame[last];
+	sum = rint(sum);
+	if (sum >= 2147483648.0f)
+		return 0x7fffffff;
+	if (sum < -2147483648.0f)
+		return 0x80000000;
+	return sum;
+}
+
+/* the float sums of the compiled matrix, summed in the source order */
+static float mix_float(const struct setup *s, const float *frame, unsigned int d)
+{
+	unsigned int c;
+	float sum = 0;
+
+	for (c = 0; c < s->channels; c++)
+		if (s->ttable[c][d] != 0)
+			sum += frame[c] * s->ttable[c][d];
+	return sum;
+}
+
+static int float_differs(float a, float b)
+{
+	float diff = a > b ? a - b : b - a;
+
+	/* leaves room for a fused multiply-add in the reference */
+	return !(diff <= 1e-6f * (1 + (b < 0 ? -b : b)));
+}
+
+static void check(const struct setup *s, snd_pcm_format_t format)
+{
+	static const int full[3] = { 32767, -32768, 16384 };
+	unsigned int width = snd_pcm_format_physical_width(format) / 8;
+	unsigned int i, c, d, bad = 0;
+	snd_pcm_t *pcm;
+	int32_t *src = NULL, frame[MAX_CHANNELS], expected;
+	float fframe[MAX_CHANNELS];
+	char *buf = NULL, *out = NULL;
+	long size = (long)FRAMES * s->schannels * width, len;
+	FILE *f;
+
+	if (ALSA_CHECK(open_route(&pcm, s, format)) < 0)
+		return;
+	src = malloc(FRAMES * s->channels * sizeof(*src));
+	buf = malloc(FRAMES * s->channels * width);
+	out = malloc(size);
+	if (!src || !buf || !out)
+		goto out;
+	srandom(s->channels * 100 + s->schannels);
+	for (i = 0; i < FRAMES * s->channels; i++) {
+		if (format == SND_PCM_FORMAT_FLOAT) {
+			/* full scale frames give sums above 1.0, kept as they are */
+			if ((i / s->channels) % 5 == 0)
+				((float *)buf)[i] = full[(i / s->channels / 5) % 3] / 32768.0f;
+			else
+				((float *)buf)[i] = (random() - 0x40000000) / 1073741824.0f;
+		} else if (format == SND_PCM_FORMAT_S16) {
+			/* some frames at full and half scale, to check the clipping */
+			if ((i / s->channels) % 5 == 0)
+				src[i] = full[(i / s->channels / 5) % 3] * 65536;
+			else
+				src[i] = (int16_t)random() * 65536;
+			((int16_t *)buf)[i] = src[i] >> 16;
+		} else {
+			src[i] = random() * 2 + (random() & 1);
+			((int32_t *)buf)[i] = src[i];
+		}
+	}
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+					  s->channels, 48000, 0, 100000)) < 0)
+		goto out;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, FRAMES) == FRAMES);
+	snd_pcm_drop(pcm);
+
+	len = -1;
+	f = fopen(path, "rb");
+	if (f) {
+		len = fread(out, 1, size, f);
+		fclose(f);
+	}
+	TEST_CHECK(len == size);
+	if (len != size)
+		goto out;
+	for (i = 0; i < FRAMES; i++) {
+		if (format == SND_PCM_FORMAT_FLOAT) {
+			for (c = 0; c < s->channels; c++)
+				fframe[c] = ((float *)buf)[i * s->channels + c];
+			for (d = 0; d < s->schannels; d++)
+				bad += float_differs(((float *)out)[i * s->schannels + d],
+						     mix_float(s, fframe, d));
+			continue;
+		}
+		for (c = 0; c < s->channels; c++)
+			frame[c] = src[i * s->channels + c];
+		for (d = 0; d < s->schannels; d++) {
+			expected = mix(s, frame, d);
+			if (format == SND_PCM_FORMAT_S16) {
+				if (((int16_t *)out)[i * s->schannels + d] != (int16_t)(expected >> 16))
+					bad++;
+			} else {
+				if (((int32_t *)out)[i * s->schannels + d] != expected)
+					bad++;
+			}
+		}
+	}
+	if (bad) {
+		fprintf(stderr, "%s %u -> %u%s: %u samples differ\n",
+			snd_pcm_format_name(format), s->channels, s->schannels,
+			getenv("LIBASOUND_NO_SIMD") ? " (no SIMD)" : "", bad);
+		any_test_failed = 1;
+	}
+ out:
+	free(src);
+	free(buf);
+	free(out);
+	snd_pcm_close(pcm);
+}
+
+/* the control elements end at 1.0, a boost in the ttable is refused */
+static void check_control_boost(void)
+{
+	snd_pcm_t *pcm;
+
+	TEST_CHECK(open_config(&pcm, "pcm.r { type route slave.pcm { type null } "
+			       "ttable.0.1 1.5 control { name \"Route Boost\" card 0 } }") == -EINVAL);
+	if (ALSA_CHECK(open_config(&pcm, "pcm.r { type route slave.pcm { type null } "
+				   "ttable.0.1 1.5 }")) >= 0)
+		snd_pcm_close(pcm);
+}
+
+static void check_all(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(setups) / sizeof(setups[0]); i++) {
+		check(&setups[i], SND_PCM_FORMAT_S16);
+		check(&setups[i], SND_PCM_FORMAT_S32);
+		check(&setups[i], SND_PCM_FORMAT_FLOAT);
+	}
+}
+
+int main(void)
+{
+	int fd, status;
+	pid_t pid;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	/* the SIMD capabilities are probed once per process */
+	pid = fork();
+	if (pid == 0) {
+		setenv("LIBASOUND_NO_SIMD", "1", 1);
+		check_all();
+		exit(TEST_EXIT_CODE());
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		any_test_failed = 1;
+	check_all();
+	check_control_boost();
+	unlink(path);
+	return TEST_EXIT_CODE();
+}
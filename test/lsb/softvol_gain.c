@@ -0,0 +1,160 @@
+/*
+ * checks the softvol gain kernels: the vectorized ones must match the
+ * generic code for all channel counts, lengths and gains
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pcm_local.h"
+#include "test.h"
+#include "pcm_softvol_simd.c"
+
+#define MAX_SAMPLES	1031
+#define MAX_CHANNELS	8
+
+static unsigned int table[MAX_CHANNELS * SOFTVOL_GAIN_ALIGN + SOFTVOL_GAIN_ALIGN];
+static unsigned int gains[MAX_SAMPLES];
+
+/* the gain table as built by softvol_set_gains() */
+static unsigned int fill_gains(unsigned int channels)
+{
+	static const unsigned int special[] = { 0, 1, 0x7fff, 0x8000, 0xfffe, 0xffff };
+	unsigned int ch, i, period, g[MAX_CHANNELS];
+
+	for (ch = 0; ch < channels; ch++) {
+		if (random() % 2)
+			g[ch] = special[random() % 6];
+		else
+			g[ch] = random() % 0x10000;
+	}
+	for (period = channels; period % SOFTVOL_GAIN_ALIGN; period += channels)
+		;
+	for (i = 0; i < period + SOFTVOL_GAIN_ALIGN; i++)
+		table[i] = g[i % channels];
+	for (i = 0; i < MAX_SAMPLES; i++)
+		gains[i] = g[i % channels];
+	return period;
+}
+
+static void check(const char *name, snd_pcm_format_t format, softvol_gain_f func)
+{
+	unsigned int width = snd_pcm_format_physical_width(format) / 8;
+	uint8_t src[MAX_SAMPLES * 4], dst1[MAX_SAMPLES * 4], dst2[MAX_SAMPLES * 4];
+	unsigned int channels, frames, samples, period, i;
+
+	for (channels = 1; channels <= MAX_CHANNELS; channels++) {
+		for (frames = 1; frames * channels < MAX_SAMPLES; frames += 1 + frames / 3) {
+			samples = frames * channels;
+			period = fill_gains(channels);
+			for (i = 0; i < sizeof(src); i++)
+				src[i] = random();
+			/* full scale samples */
+			memset(src, 0x80, width);
+			memset(src + width, 0x7f, width);
+			memset(dst1, 0, sizeof(dst1));
+			memset(dst2, 0, sizeof(dst2));
+			func(dst1, src, samples, table, period);
+			switch (format) {
+			case SND_PCM_FORMAT_S16:
+				generic_gain_s16((int16_t *)dst2, (int16_t *)src, samples, gains);
+				break;
+			case SND_PCM_FORMAT_S32:
+				generic_gain_s32((int32_t *)dst2, (int32_t *)src, samples, gains);
+				break;
+			default:
+				generic_gain_s24_3le(dst2, src, samples, gains);
+				break;
+			}
+			if (memcmp(dst1, dst2, sizeof(dst1))) {
+				fprintf(stderr, "%s %s: mismatch for %u channels, %u frames\n",
+					name, snd_pcm_format_name(format), channels, frames);
+				any_test_failed = 1;
+				return;
+			}
+		}
+	}
+}
+
+/* the float kernels also take boost gains, the sources are finite */
+static void check_float(const char *name, snd_pcm_format_t format,
+			softvol_gain_f func)
+{
+	static double src[MAX_SAMPLES], dst1[MAX_SAMPLES], dst2[MAX_SAMPLES];
+	unsigned int channels, frames, samples, period, i;
+
+	for (channels = 1; channels <= MAX_CHANNELS; channels++) {
+		for (frames = 1; frames * channels < MAX_SAMPLES; frames += 1 + frames / 3) {
+			samples = frames * channels;
+			period = fill_gains(channels);
+			if (channels > 1) {
+				table[0] = gains[0] = 2072430287;	/* +90dB */
+				for (i = channels; i < period + SOFTVOL_GAIN_ALIGN; i += channels)
+					table[i] = table[0];
+				for (i = channels; i < MAX_SAMPLES; i += channels)
+					gains[i] = gains[0];
+			}
+			for (i = 0; i < MAX_SAMPLES; i++) {
+				double v = (double)(random() - RAND_MAX / 2) / RAND_MAX * 4;
+				if (format == SND_PCM_FORMAT_FLOAT)
+					((float *)src)[i] = v;
+				else
+					src[i] = v;
+			}
+			memset(dst1, 0, sizeof(dst1));
+			memset(dst2, 0, sizeof(dst2));
+			func(dst1, src, samples, table, period);
+			if (format == SND_PCM_FORMAT_FLOAT)
+				generic_gain_float((float *)dst2, (float *)src, samples, gains);
+			else
+				generic_gain_float64(dst2, src, samples, gains);
+			if (memcmp(dst1, dst2, sizeof(dst1))) {
+				fprintf(stderr, "%s %s: mismatch for %u channels, %u frames\n",
+					name, snd_pcm_format_name(format), channels, frames);
+				any_test_failed = 1;
+				return;
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24_3LE,
+	};
+	unsigned int i;
+	softvol_gain_f func;
+
+	/* the plain gain formula */
+	TEST_CHECK(softvol_gain_sample(-0x8000, 0x8000) == -0x4000);
+	TEST_CHECK(softvol_gain_sample(0x7fff, 0xffff) == 0x7fff);
+	TEST_CHECK(softvol_gain_sample(-1, 1) == -1);
+	TEST_CHECK(softvol_gain_sample(0x7fffffff, 0xfffe) == 0x7ffeffff);
+	TEST_CHECK(softvol_gain_double(0xffff) == 1.0);
+	TEST_CHECK(softvol_gain_double(0x8000) == 0.5);
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		func = softvol_select_gain(formats[i]);
+		if (func)
+			check("selected", formats[i], func);
+	}
+	func = softvol_select_gain(SND_PCM_FORMAT_FLOAT);
+	if (func)
+		check_float("selected", SND_PCM_FORMAT_FLOAT, func);
+	func = softvol_select_gain(SND_PCM_FORMAT_FLOAT64);
+	if (func)
+		check_float("selected", SND_PCM_FORMAT_FLOAT64, func);
+#if defined(SND_PCM_SIMD_X86)
+	if (snd_pcm_simd_caps() & SND_PCM_SIMD_SSE2) {
+		check("sse2", SND_PCM_FORMAT_S16, sse2_gain_s16);
+		check_float("sse2", SND_PCM_FORMAT_FLOAT, sse2_gain_float);
+		check_float("sse2", SND_PCM_FORMAT_FLOAT64, sse2_gain_float64);
+	}
+	if (snd_pcm_simd_caps() & SND_PCM_SIMD_AVX2) {
+		check("avx2", SND_PCM_FORMAT_S32, avx2_gain_s32);
+		check("avx2", SND_PCM_FORMAT_S24_3LE, avx2_gain_s24_3le);
+	}
+#endif
+
+	return TEST_EXIT_CODE();
+}
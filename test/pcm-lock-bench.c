@@ -0,0 +1,203 @@
+/*
+ * PCM call overhead benchmark
+ *
+ * Runs batches of snd_pcm_avail_update(), snd_pcm_mmap_begin() and
+ * snd_pcm_mmap_commit(), and batches of snd_pcm_writei(), through a copy
+ * PCM to a null slave, once with the default locking and once opened with
+ * SND_PCM_SINGLE_THREAD, and reports the time per batch.
+ *
+ *   pcm-lock-bench -c 2 -b 64 -s 1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+static unsigned int channels = 2;
+static unsigned int batch = 64;
+static double seconds = 1;
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pcm-lock-bench [-options]\n");
+	fprintf(stderr, "  -c val  Set number of channels\n");
+	fprintf(stderr, "  -b val  Set frames per batch\n");
+	fprintf(stderr, "  -s val  Set seconds to run each test\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "c:b:s:")) >= 0) {
+		switch (c) {
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 's':
+			seconds = atof(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (channels < 1 || !batch || seconds <= 0) {
+		usage();
+		return 1;
+	}
+	return 0;
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int open_copy(snd_pcm_t **pcm, snd_pcm_access_t access, int mode)
+{
+	static const char conf[] = "pcm.c { type copy slave.pcm { type null } }";
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size = batch * 4;
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, strlen(conf));
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "c", SND_PCM_STREAM_PLAYBACK, mode, top);
+	snd_config_delete(top);
+	if (err < 0)
+		return err;
+	snd_pcm_hw_params_alloca(&hw);
+	if ((err = snd_pcm_hw_params_any(*pcm, hw)) < 0 ||
+	    (err = snd_pcm_hw_params_set_access(*pcm, hw, access)) < 0 ||
+	    (err = snd_pcm_hw_params_set_format(*pcm, hw, SND_PCM_FORMAT_S16)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(*pcm, hw, channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate(*pcm, hw, 48000, 0)) < 0 ||
+	    (err = snd_pcm_hw_params_set_buffer_size_near(*pcm, hw, &size)) < 0 ||
+	    (err = snd_pcm_hw_params(*pcm, hw)) < 0) {
+		snd_pcm_close(*pcm);
+		return err;
+	}
+	return 0;
+}
+
+/* returns the ns per batch, or a negative value on error */
+static double run_mmap(int mode)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	unsigned long batches = 0;
+	struct timespec start;
+	snd_pcm_t *pcm;
+	double t, ns = -1;
+	unsigned int i;
+	int err;
+
+	err = open_copy(&pcm, SND_PCM_ACCESS_MMAP_INTERLEAVED, mode);
+	if (err < 0) {
+		fprintf(stderr, "cannot open the copy PCM: %s\n", snd_strerror(err));
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (i = 0; i < 256; i++) {
+			if (snd_pcm_avail_update(pcm) < 0)
+				goto error;
+			frames = batch;
+			if (snd_pcm_mmap_begin(pcm, &areas, &offset, &frames) < 0 ||
+			    snd_pcm_mmap_commit(pcm, offset, frames) != (snd_pcm_sframes_t)frames)
+				goto error;
+			if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED &&
+			    snd_pcm_start(pcm) < 0)
+				goto error;
+			batches++;
+		}
+		t = elapsed(&start);
+	} while (t < seconds);
+	ns = t * 1e9 / batches;
+	snd_pcm_close(pcm);
+	return ns;
+
+ error:
+	fprintf(stderr, "mmap error\n");
+	snd_pcm_close(pcm);
+	return -1;
+}
+
+static double run_writei(int mode)
+{
+	unsigned long batches = 0;
+	struct timespec start;
+	snd_pcm_t *pcm;
+	double t, ns = -1;
+	unsigned int i;
+	short *buf;
+	int err;
+
+	err = open_copy(&pcm, SND_PCM_ACCESS_RW_INTERLEAVED, mode);
+	if (err < 0) {
+		fprintf(stderr, "cannot open the copy PCM: %s\n", snd_strerror(err));
+		return -1;
+	}
+	buf = calloc(batch, channels * sizeof(*buf));
+	if (!buf)
+		goto out;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (i = 0; i < 256; i++) {
+			if (snd_pcm_writei(pcm, buf, batch) != (snd_pcm_sframes_t)batch) {
+				fprintf(stderr, "write error\n");
+				goto out;
+			}
+			batches++;
+		}
+		t = elapsed(&start);
+	} while (t < seconds);
+	ns = t * 1e9 / batches;
+ out:
+	free(buf);
+	snd_pcm_close(pcm);
+	return ns;
+}
+
+static int report(const char *name, double locked, double single)
+{
+	if (locked < 0 || single < 0) {
+		printf("%-10s failed\n", name);
+		return 1;
+	}
+	printf("%-10s %9.1f ns %9.1f ns, %.2fx\n", name,
+	       locked, single, locked / single);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int err = 0;
+
+	if (parse_options(argc, argv))
+		return 1;
+	printf("%u channels, %u frames per batch\n", channels, batch);
+	printf("%-10s %12s %12s\n", "", "locked", "single");
+	err |= report("mmap", run_mmap(0), run_mmap(SND_PCM_SINGLE_THREAD));
+	err |= report("writei", run_writei(0), run_writei(SND_PCM_SINGLE_THREAD));
+	return err;
+}
@@ -0,0 +1,209 @@
+/*
+ * linear rate converter benchmark
+ *
+ * Converts interleaved S16 periods with the built-in linear converter
+ * and reports the time per output frame, once with the scalar code
+ * (run in a child process with LIBASOUND_NO_SIMD set) and once with the
+ * vectorized code.  The outputs of both runs are compared.
+ *
+ *   rate-linear-bench -c 8 -i 48000 -o 44100 -s 2
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../include/asoundlib.h"
+#include "../include/pcm_rate.h"
+
+extern int SND_PCM_RATE_PLUGIN_ENTRY(linear)(unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+
+static unsigned int channels = 8;
+static unsigned int in_rate = 48000;
+static unsigned int out_rate = 44100;
+static unsigned int period_time = 10;	/* ms */
+static int seconds = 2;
+
+struct result {
+	double ns;		/* per output frame */
+	unsigned int hash;	/* of the output */
+	int ok;
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: rate-linear-bench [-options]\n");
+	fprintf(stderr, "  -c val  Set number of channels\n");
+	fprintf(stderr, "  -i val  Set input rate\n");
+	fprintf(stderr, "  -o val  Set output rate\n");
+	fprintf(stderr, "  -p val  Set period time (in ms)\n");
+	fprintf(stderr, "  -s val  Set seconds to run each variant\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "c:i:o:p:s:")) >= 0) {
+		switch (c) {
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'i':
+			in_rate = atoi(optarg);
+			break;
+		case 'o':
+			out_rate = atoi(optarg);
+			break;
+		case 'p':
+			period_time = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (channels < 1 || !in_rate || !out_rate || !period_time) {
+		usage();
+		return 1;
+	}
+	return 0;
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run(struct result *res)
+{
+	snd_pcm_rate_info_t info;
+	snd_pcm_rate_ops_t ops;
+	snd_pcm_channel_area_t *src_areas, *dst_areas;
+	int16_t *src, *dst;
+	unsigned int c, i, hash = 0;
+	struct timespec start;
+	unsigned long periods = 0;
+	double t;
+	void *obj;
+
+	memset(res, 0, sizeof(*res));
+	memset(&info, 0, sizeof(info));
+	info.channels = channels;
+	info.in.format = info.out.format = SND_PCM_FORMAT_S16;
+	info.in.rate = in_rate;
+	info.out.rate = out_rate;
+	info.in.period_size = in_rate * period_time / 1000;
+	info.out.period_size = out_rate * period_time / 1000;
+	info.in.buffer_size = info.in.period_size * 4;
+	info.out.buffer_size = info.out.period_size * 4;
+
+	memset(&ops, 0, sizeof(ops));
+	if (SND_PCM_RATE_PLUGIN_ENTRY(linear)(SND_PCM_RATE_PLUGIN_VERSION, &obj, &ops) < 0)
+		return;
+	if (ops.init(obj, &info) < 0 || ops.adjust_pitch(obj, &info) < 0) {
+		fprintf(stderr, "cannot init the converter\n");
+		ops.close(obj);
+		return;
+	}
+	ops.reset(obj);
+
+	src = malloc(info.in.period_size * channels * sizeof(*src));
+	dst = malloc(info.out.period_size * channels * sizeof(*dst));
+	src_areas = calloc(channels, sizeof(*src_areas));
+	dst_areas = calloc(channels, sizeof(*dst_areas));
+	if (!src || !dst || !src_areas || !dst_areas)
+		goto out;
+	srandom(1);
+	for (i = 0; i < info.in.period_size * channels; i++)
+		src[i] = random();
+	for (c = 0; c < channels; c++) {
+		src_areas[c].addr = src;
+		src_areas[c].first = c * 16;
+		src_areas[c].step = channels * 16;
+		dst_areas[c].addr = dst;
+		dst_areas[c].first = c * 16;
+		dst_areas[c].step = channels * 16;
+	}
+
+	/* the output of the first periods is compared */
+	for (; periods < 16; periods++) {
+		ops.convert(obj, dst_areas, 0, info.out.period_size,
+			    src_areas, 0, info.in.period_size);
+		for (i = 0; i < info.out.period_size * channels; i++)
+			hash = hash * 31 + (uint16_t)dst[i];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (i = 0; i < 64; i++, periods++)
+			ops.convert(obj, dst_areas, 0, info.out.period_size,
+				    src_areas, 0, info.in.period_size);
+		t = elapsed(&start);
+	} while (t < seconds);
+	res->ns = t * 1e9 / ((periods - 16) * info.out.period_size);
+	res->hash = hash;
+	res->ok = 1;
+ out:
+	free(src);
+	free(dst);
+	free(src_areas);
+	free(dst_areas);
+	ops.free(obj);
+	ops.close(obj);
+}
+
+int main(int argc, char **argv)
+{
+	struct result scalar, simd;
+	int fds[2], status;
+	pid_t pid;
+
+	if (parse_options(argc, argv))
+		return 1;
+	printf("S16, %u channels, %u -> %u Hz, period %u ms\n",
+	       channels, in_rate, out_rate, period_time);
+
+	/* the SIMD capabilities are probed once per process */
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		setenv("LIBASOUND_NO_SIMD", "1", 1);
+		run(&scalar);
+		if (write(fds[1], &scalar, sizeof(scalar)) != sizeof(scalar))
+			exit(1);
+		exit(0);
+	}
+	close(fds[1]);
+	if (read(fds[0], &scalar, sizeof(scalar)) != sizeof(scalar))
+		scalar.ok = 0;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+
+	run(&simd);
+	if (!scalar.ok || !simd.ok)
+		return 1;
+	printf("scalar  %.2f ns per frame\n", scalar.ns);
+	printf("simd    %.2f ns per frame, %.2fx\n", simd.ns, scalar.ns / simd.ns);
+	if (scalar.hash != simd.hash) {
+		printf("output mismatch!\n");
+		return 1;
+	}
+	return 0;
+}